@@ -0,0 +1,380 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Bootstrap confidence intervals of the summary values of a run that are
+   averages over queries (measures averaged by te_calc_avg_meas_s,
+   te_calc_avg_meas_a_cut or te_calc_avg_meas_s_gm), from the per query
+   values of the run kept in epi->run_values.
+   Each of epi->bootstrap_resamples resamples draws as many queries as were
+   averaged, with replacement, and its mean of each value is the sum of
+   the rows (all values of one query) of the queries drawn, each times the
+   number of times it was drawn.  The resamples of a block are summed
+   together, going down the rows once, so that each row is read once per
+   block rather than once per draw.  With
+   average_complete_flag, queries not evaluated are resampled too, with
+   the value they are averaged with (0, or log (MIN_GEO_MEAN) for the
+   geometric means, whose per query values are logs).
+   Resamples are drawn in fixed size blocks, each with its own random
+   number stream (see utility_random.c), taken in turn by up to
+   epi->num_threads tasks, so that the intervals do not depend on the
+   number of threads.
+
+   Both the percentile interval and the bias-corrected and accelerated
+   (BCa) interval (Efron, 1987) are found, the acceleration from the
+   jackknife of the mean.  The bounds of value v are set in
+   epi->summary_ci[4*v] to [4*v+3] (percentile low and high, BCa low and
+   high), or NaN if value v has no interval.  They are valid until the
+   next call.
+
+   Return UNDEF if error, 1 otherwise.
+*/
+
+#define BOOTSTRAP_SEED 0xb0075eedc1a55e5ULL
+#define RESAMPLES_PER_BLOCK 64
+/* Two-sided level of the intervals */
+#define CI_ALPHA 0.05
+
+/* Rows are added four values at a time with AVX2, if the cpu running it
+   has AVX2 */
+#if defined (__GNUC__) && defined (__x86_64__)
+#include <immintrin.h>
+#define ADD_ROW_AVX2
+#endif
+
+typedef struct {
+    const double *rows;             /* num_queries rows of num_values */
+    long num_queries;
+    long num_values;
+    long num_resamples;
+    long *next_block;               /* Shared by all tasks */
+    double *stats;                  /* Mean of value k in resample b is
+				       stats[k * num_resamples + b] */
+    long *counts;                   /* Space for the number of times each
+				       query is drawn in each resample of a
+				       block */
+    double *sums;                   /* Space for num_values sums for each
+				       resample of a block */
+} BOOT_TASK;
+
+static void *resample_block (void *arg);
+static void add_row_scalar (double *sums, const double *row, long num,
+			    long times);
+#ifdef ADD_ROW_AVX2
+static void add_row_avx2 (double *sums, const double *row, long num,
+			  long times);
+#endif
+static double quantile (const double *sorted, long num, double p);
+static double normal_cdf (double x);
+static double normal_quantile (double p);
+static int comp_double ();
+
+/* Space reserved for returned values */
+static double *summary_ci;
+static long max_summary_ci = 0;
+
+int
+te_bootstrap_ci (EPI *epi, TREC_MEAS **measures, long num_measures,
+		 const TREC_EVAL *accum_eval)
+{
+    const RUN_VALUES *run_values = epi->run_values;
+    long num_resamples = epi->bootstrap_resamples;
+    long *value_index = NULL;       /* Value of each column */
+    char *geo_flag = NULL;          /* Column's values are logs */
+    double *rows = NULL, *stats = NULL, *sums = NULL;
+    long *counts = NULL;
+    BOOT_TASK *tasks = NULL;
+    long num_cols, num_rows, num_blocks, num_tasks, next_block;
+    long m, i, k, q, r, t;
+    double *col_stats, *ci;
+    double mean, d, sum2, sum3, accel, z0, z, num_less;
+    double bounds[4];
+    int ret = UNDEF;
+
+    if (NULL == (summary_ci =
+		 te_chk_and_malloc (summary_ci, &max_summary_ci,
+				    4 * accum_eval->num_values,
+				    sizeof (double))) ||
+	NULL == (value_index = Malloc (accum_eval->num_values + 1, long)) ||
+	NULL == (geo_flag = Malloc (accum_eval->num_values + 1, char)))
+	goto done;
+    for (i = 0; i < 4 * accum_eval->num_values; i++)
+	summary_ci[i] = NAN;
+
+    /* The values averaged over queries */
+    num_cols = 0;
+    for (m = 0; m < num_measures; m++) {
+	if (! MEASURE_REQUESTED (measures[m]))
+	    continue;
+	if (measures[m]->calc_avg_meas == te_calc_avg_meas_s ||
+	    measures[m]->calc_avg_meas == te_calc_avg_meas_s_gm) {
+	    value_index[num_cols] = measures[m]->eval_index;
+	    geo_flag[num_cols] =
+		measures[m]->calc_avg_meas == te_calc_avg_meas_s_gm;
+	    num_cols++;
+	}
+	else if (measures[m]->calc_avg_meas == te_calc_avg_meas_a_cut) {
+	    for (i = 0; i < measures[m]->meas_params->num_params; i++) {
+		value_index[num_cols] = measures[m]->eval_index + i;
+		geo_flag[num_cols] = 0;
+		num_cols++;
+	    }
+	}
+    }
+
+    /* One row of the values of the columns per query averaged */
+    if (NULL == (rows = Malloc (run_values->num_queries * num_cols + 1,
+				double)))
+	goto done;
+    num_rows = 0;
+    for (q = 0; q < run_values->num_queries; q++) {
+	if (run_values->evaluated[q]) {
+	    for (k = 0; k < num_cols; k++)
+		rows[num_rows * num_cols + k] =
+		    run_values->values[value_index[k] *
+				       run_values->num_queries + q];
+	}
+	else if (epi->average_complete_flag) {
+	    for (k = 0; k < num_cols; k++)
+		rows[num_rows * num_cols + k] =
+		    geo_flag[k] ? log (MIN_GEO_MEAN) : 0.0;
+	}
+	else
+	    continue;
+	num_rows++;
+    }
+    if (num_rows == 0 || num_cols == 0) {
+	epi->summary_ci = summary_ci;
+	ret = 1;
+	goto done;
+    }
+
+    num_blocks = (num_resamples + RESAMPLES_PER_BLOCK - 1) /
+	RESAMPLES_PER_BLOCK;
+    num_tasks = MIN (te_num_threads (epi->num_threads), num_blocks);
+    if (NULL == (stats = Malloc (num_cols * num_resamples, double)) ||
+	NULL == (counts = Malloc (num_tasks * RESAMPLES_PER_BLOCK * num_rows,
+				  long)) ||
+	NULL == (sums = Malloc (num_tasks * RESAMPLES_PER_BLOCK * num_cols,
+				double)) ||
+	NULL == (tasks = Malloc (num_tasks, BOOT_TASK)))
+	goto done;
+    next_block = 0;
+    for (t = 0; t < num_tasks; t++)
+	tasks[t] = (BOOT_TASK) {rows, num_rows, num_cols, num_resamples,
+				&next_block, stats,
+				&counts[t * RESAMPLES_PER_BLOCK * num_rows],
+				&sums[t * RESAMPLES_PER_BLOCK * num_cols]};
+    if (UNDEF == te_run_parallel (num_tasks, resample_block, tasks,
+				  sizeof (BOOT_TASK)))
+	goto done;
+
+    for (k = 0; k < num_cols; k++) {
+	/* Mean, and jackknife acceleration: for the mean, the jackknife
+	   means differ from the mean in proportion to the values */
+	mean = 0.0;
+	for (q = 0; q < num_rows; q++)
+	    mean += rows[q * num_cols + k];
+	mean /= (double) num_rows;
+	sum2 = sum3 = 0.0;
+	for (q = 0; q < num_rows; q++) {
+	    d = rows[q * num_cols + k] - mean;
+	    sum2 += d * d;
+	    sum3 += d * d * d;
+	}
+	accel = sum2 > 0.0 ? sum3 / (6.0 * pow (sum2, 1.5)) : 0.0;
+
+	col_stats = &stats[k * num_resamples];
+	qsort ((char *) col_stats, (int) num_resamples, sizeof (double),
+	       comp_double);
+	bounds[0] = quantile (col_stats, num_resamples, CI_ALPHA / 2.0);
+	bounds[1] = quantile (col_stats, num_resamples, 1.0 - CI_ALPHA / 2.0);
+
+	/* Bias correction from the fraction of resample means below the
+	   mean, kept away from 0 and 1 */
+	for (r = 0; r < num_resamples && col_stats[r] < mean; r++)
+	    ;
+	num_less = MIN (MAX ((double) r, 0.5), (double) num_resamples - 0.5);
+	z0 = normal_quantile (num_less / (double) num_resamples);
+	z = z0 + normal_quantile (CI_ALPHA / 2.0);
+	bounds[2] = quantile (col_stats, num_resamples,
+			      normal_cdf (z0 + z / (1.0 - accel * z)));
+	z = z0 + normal_quantile (1.0 - CI_ALPHA / 2.0);
+	bounds[3] = quantile (col_stats, num_resamples,
+			      normal_cdf (z0 + z / (1.0 - accel * z)));
+
+	ci = &summary_ci[4 * value_index[k]];
+	for (i = 0; i < 4; i++)
+	    ci[i] = geo_flag[k] ? exp (bounds[i]) : bounds[i];
+    }
+    epi->summary_ci = summary_ci;
+    ret = 1;
+
+ done:
+    if (value_index != NULL)
+	Free (value_index);
+    if (geo_flag != NULL)
+	Free (geo_flag);
+    if (rows != NULL)
+	Free (rows);
+    if (stats != NULL)
+	Free (stats);
+    if (counts != NULL)
+	Free (counts);
+    if (sums != NULL)
+	Free (sums);
+    if (tasks != NULL)
+	Free (tasks);
+    return (ret);
+}
+
+int
+te_bootstrap_cleanup ()
+{
+    if (max_summary_ci > 0) {
+	Free (summary_ci);
+	max_summary_ci = 0;
+    }
+    return (1);
+}
+
+/* Task of te_bootstrap_ci: take blocks of resamples in turn until none
+   are left, finding the means of each */
+static void *
+resample_block (void *arg)
+{
+    BOOT_TASK *task = (BOOT_TASK *) arg;
+    long num_queries = task->num_queries;
+    long num_values = task->num_values;
+    long *counts = task->counts;
+    double *sums;
+    TE_RNG rng;
+    long block, start, num_block, b, i, k, q;
+#ifdef ADD_ROW_AVX2
+    long avx2_flag = num_values >= 4 && __builtin_cpu_supports ("avx2");
+#endif
+
+    while ((start = (block = __sync_fetch_and_add (task->next_block, 1)) *
+	    RESAMPLES_PER_BLOCK) < task->num_resamples) {
+	num_block = MIN (RESAMPLES_PER_BLOCK, task->num_resamples - start);
+
+	/* Times query q is drawn in resample b is counts[q*num_block + b] */
+	te_rng_seed (&rng, BOOTSTRAP_SEED, (uint64_t) block);
+	for (i = 0; i < num_queries * num_block; i++)
+	    counts[i] = 0;
+	for (b = 0; b < num_block; b++) {
+	    for (i = 0; i < num_queries; i++)
+		counts[te_rng_below (&rng, num_queries) * num_block + b]++;
+	}
+
+	for (i = 0; i < num_block * num_values; i++)
+	    task->sums[i] = 0.0;
+	for (q = 0; q < num_queries; q++) {
+	    for (b = 0; b < num_block; b++) {
+		if (counts[q * num_block + b] == 0)
+		    continue;
+		sums = &task->sums[b * num_values];
+#ifdef ADD_ROW_AVX2
+		if (avx2_flag) {
+		    add_row_avx2 (sums, &task->rows[q * num_values], num_values,
+				  counts[q * num_block + b]);
+		    continue;
+		}
+#endif
+		add_row_scalar (sums, &task->rows[q * num_values], num_values,
+				counts[q * num_block + b]);
+	    }
+	}
+	for (b = 0; b < num_block; b++) {
+	    for (k = 0; k < num_values; k++)
+		task->stats[k * task->num_resamples + start + b] =
+		    task->sums[b * num_values + k] / (double) num_queries;
+	}
+    }
+    return (NULL);
+}
+
+/* sums += times * row, for num values */
+static void
+add_row_scalar (double *sums, const double *row, long num, long times)
+{
+    double t = (double) times;
+    long k;
+
+    for (k = 0; k < num; k++)
+	sums[k] += t * row[k];
+}
+
+#ifdef ADD_ROW_AVX2
+__attribute__ ((target ("avx2")))
+static void
+add_row_avx2 (double *sums, const double *row, long num, long times)
+{
+    const __m256d t = _mm256_set1_pd ((double) times);
+    long k;
+
+    for (k = 0; k + 4 <= num; k += 4)
+	_mm256_storeu_pd (&sums[k],
+			  _mm256_add_pd (_mm256_loadu_pd (&sums[k]),
+					 _mm256_mul_pd (t,
+							_mm256_loadu_pd (&row[k]))));
+    add_row_scalar (&sums[k], &row[k], num - k, times);
+}
+#endif
+
+/* Quantile p of the num sorted values, interpolating between the two
+   nearest */
+static double
+quantile (const double *sorted, long num, double p)
+{
+    double h = p * (double) (num - 1);
+    long i;
+
+    if (h <= 0.0)
+	return (sorted[0]);
+    if (h >= (double) (num - 1))
+	return (sorted[num - 1]);
+    i = (long) h;
+    return (sorted[i] + (h - (double) i) * (sorted[i+1] - sorted[i]));
+}
+
+static double
+normal_cdf (double x)
+{
+    return (0.5 * erfc (-x / sqrt (2.0)));
+}
+
+/* Inverse of normal_cdf, by bisection */
+static double
+normal_quantile (double p)
+{
+    double low = -40.0, high = 40.0, mid;
+    long i;
+
+    for (i = 0; i < 100; i++) {
+	mid = (low + high) / 2.0;
+	if (normal_cdf (mid) < p)
+	    low = mid;
+	else
+	    high = mid;
+    }
+    return ((low + high) / 2.0);
+}
+
+static int
+comp_double (double *ptr1, double *ptr2)
+{
+    if (*ptr1 < *ptr2)
+	return (-1);
+    if (*ptr1 > *ptr2)
+	return (1);
+    return (0);
+}
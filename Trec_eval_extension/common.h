@@ -34,4 +34,9 @@
                                               (unsigned) ((n)*sizeof(type)))
 #define Free(loc) (void) free( (char *)(loc) )
 
+/* Storage class of static pools that hold per query state (eg, the
+   cached query of the form_* procedures).  Each thread evaluating
+   queries (see -j) gets its own copy */
+#define THREAD_LOCAL __thread
+
 #endif /* COMMONH */
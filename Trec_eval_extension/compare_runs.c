@@ -0,0 +1,431 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Paired significance tests of each candidate run (run_values[1] on)
+   against the baseline run (run_values[0]), on the queries evaluated in
+   both.  For each measure value, the differences candidate - baseline of
+   the per query values are tested with
+     - the paired t-test (two-sided),
+     - the Wilcoxon signed-rank test (two-sided; exact if fewer than 50
+       non-zero differences with no ties, else the normal approximation
+       with tie and continuity corrections, as R's wilcox.test),
+     - the randomization test (two-sided): the fraction of num_permutations
+       random sign assignments to the differences whose sum is at least as
+       far from 0 as that of the differences themselves.
+   A line
+       measure_name  candidate_runid  num_queries  mean_diff  t_p  w_p  r_p
+   is printed for each candidate and measure value.
+
+   Permutations are done in fixed size blocks, each with its own random
+   number stream (see utility_random.c).  Up to epi->num_threads tasks
+   take blocks in turn and count the permutations of each value at least
+   as extreme, so that the p-values do not depend on the number of threads.
+   The sign of each query in a permutation is one random bit, so the sum
+   of a permutation is looked up 8 queries at a time in a table of the 256
+   possible partial sums of each 8 queries.
+
+   Return UNDEF if error, 1 otherwise.
+*/
+
+/* Differences closer than this are ties, and closer to 0 are 0 */
+#define DIFF_EPSILON 1e-10
+/* Relative tolerance of a permuted sum being as extreme as the observed */
+#define SUM_EPSILON 1e-9
+/* Fewer non-zero differences than this, with no ties, use the exact
+   distribution of the Wilcoxon statistic */
+#define WILCOXON_EXACT_MAX 50
+#define PERMS_PER_BLOCK 1024
+#define PERM_SEED 0x5eed0f7e5c0ffee5ULL
+
+typedef struct {
+    double abs_diff;
+    long positive;
+} SIGNED_DIFF;
+
+typedef struct {
+    const double *tables;           /* 256 partial sums per value and chunk
+				       of 8 queries */
+    const double *observed;         /* Least |sum| counted as extreme */
+    long num_chunks;
+    long num_values;
+    long num_permutations;
+    long *next_block;               /* Shared by all tasks */
+    long *counts;                   /* num_values counts of this task */
+    uint64_t *bits;                 /* Space for the signs of a permutation,
+				       one bit per query */
+} PERM_TASK;
+
+static double t_test (const double *diffs, long n);
+static double wilcoxon_test (const double *diffs, long n,
+			     SIGNED_DIFF *signed_diffs, double *num_sums);
+static int randomization_test (const EPI *epi, const double *diffs,
+			       long num_queries, long n, long num_values,
+			       long num_permutations, double *p_values);
+static void *count_block_perms (void *arg);
+static double incomplete_beta (double a, double b, double x);
+static int comp_signed_diff ();
+
+int
+te_compare_runs (const EPI *epi, const TREC_EVAL *init_eval,
+		 const RUN_VALUES *run_values, long num_runs,
+		 long num_permutations)
+{
+    const RUN_VALUES *base = &run_values[0];
+    const RUN_VALUES *cand;
+    long num_queries = base->num_queries;
+    long num_values = base->num_values;
+    double *diffs = NULL, *perm_p = NULL, *num_sums = NULL;
+    SIGNED_DIFF *signed_diffs = NULL;
+    static char *fields[] = {"num_q", "mean_diff", "t_p", "wilcoxon_p",
+			     "random_p"};
+    OUT_LINE line;
+    double sum;
+    long r, v, q, n;
+    int ret = UNDEF;
+
+    if (NULL == (diffs = Malloc (num_values * num_queries + 1, double)) ||
+	NULL == (signed_diffs = Malloc (num_queries + 1, SIGNED_DIFF)) ||
+	NULL == (perm_p = Malloc (num_values + 1, double)) ||
+	NULL == (num_sums = Malloc (WILCOXON_EXACT_MAX * WILCOXON_EXACT_MAX,
+				    double)))
+	goto done;
+
+    /* Line printed for each value of each candidate */
+    line.prefix = "";
+    line.key_field = "runid";
+    line.num_values = 5;
+    for (v = 0; v < 5; v++) {
+	line.values[v].field = fields[v];
+	line.values[v].type = v == 0 ? OUT_LONG : OUT_FLOAT;
+    }
+
+    for (r = 1; r < num_runs; r++) {
+	cand = &run_values[r];
+	/* Differences of the paired queries, num_values columns of n */
+	n = 0;
+	for (q = 0; q < num_queries; q++) {
+	    if (!base->evaluated[q] || !cand->evaluated[q])
+		continue;
+	    for (v = 0; v < num_values; v++)
+		diffs[v * num_queries + n] =
+		    cand->values[v * num_queries + q] -
+		    base->values[v * num_queries + q];
+	    n++;
+	}
+	if (UNDEF == randomization_test (epi, diffs, num_queries, n,
+					 num_values, num_permutations, perm_p))
+	    goto done;
+	for (v = 0; v < num_values; v++) {
+	    sum = 0.0;
+	    for (q = 0; q < n; q++)
+		sum += diffs[v * num_queries + q];
+	    line.name = init_eval->values[v].name;
+	    line.key = cand->run_id;
+	    line.values[0].value = (double) n;
+	    line.values[1].value = n > 0 ? sum / (double) n : 0.0;
+	    line.values[2].value = t_test (&diffs[v * num_queries], n);
+	    line.values[3].value = wilcoxon_test (&diffs[v * num_queries], n,
+						  signed_diffs, num_sums);
+	    line.values[4].value = perm_p[v];
+	    if (UNDEF == te_output_line (epi, &line))
+		goto done;
+	}
+	if (UNDEF == te_output_flush ())
+	    goto done;
+    }
+    ret = 1;
+
+ done:
+    if (diffs != NULL)
+	Free (diffs);
+    if (signed_diffs != NULL)
+	Free (signed_diffs);
+    if (perm_p != NULL)
+	Free (perm_p);
+    if (num_sums != NULL)
+	Free (num_sums);
+    return (ret);
+}
+
+/* Two-sided p-value of the paired t-test on the n differences */
+static double
+t_test (const double *diffs, long n)
+{
+    double mean, var, t, df;
+    long q;
+
+    if (n < 2)
+	return (1.0);
+    mean = 0.0;
+    for (q = 0; q < n; q++)
+	mean += diffs[q];
+    mean /= (double) n;
+    var = 0.0;
+    for (q = 0; q < n; q++)
+	var += (diffs[q] - mean) * (diffs[q] - mean);
+    var /= (double) (n - 1);
+    if (var <= DIFF_EPSILON * DIFF_EPSILON)
+	/* All differences the same */
+	return (fabs (mean) <= DIFF_EPSILON ? 1.0 : 0.0);
+    t = mean / sqrt (var / (double) n);
+    df = (double) (n - 1);
+    return (incomplete_beta (df / 2.0, 0.5, df / (df + t * t)));
+}
+
+/* Two-sided p-value of the Wilcoxon signed-rank test on the n differences.
+   signed_diffs is space for n values, num_sums for the number of subsets
+   of each rank sum of the exact distribution */
+static double
+wilcoxon_test (const double *diffs, long n, SIGNED_DIFF *signed_diffs,
+	       double *num_sums)
+{
+    double v_plus, ties, mean, sigma, z, p_lower, p_upper;
+    long m, i, j, k, max_sum, v;
+
+    /* Drop zero differences, and rank the rest by |d|, tied |d| getting
+       their average rank */
+    m = 0;
+    for (i = 0; i < n; i++) {
+	if (fabs (diffs[i]) > DIFF_EPSILON) {
+	    signed_diffs[m].abs_diff = fabs (diffs[i]);
+	    signed_diffs[m].positive = diffs[i] > 0.0;
+	    m++;
+	}
+    }
+    if (m == 0)
+	return (1.0);
+    qsort ((char *) signed_diffs, (int) m, sizeof (SIGNED_DIFF),
+	   comp_signed_diff);
+    v_plus = 0.0;
+    ties = 0.0;
+    for (i = 0; i < m; i = j) {
+	for (j = i + 1;
+	     j < m && (signed_diffs[j].abs_diff - signed_diffs[i].abs_diff <=
+		       DIFF_EPSILON);
+	     j++)
+	    ;
+	ties += (double) (j - i) * (j - i) * (j - i) - (double) (j - i);
+	for (k = i; k < j; k++) {
+	    if (signed_diffs[k].positive)
+		v_plus += (double) (i + 1 + j) / 2.0;
+	}
+    }
+
+    if (m < WILCOXON_EXACT_MAX && m == n && ties == 0.0) {
+	/* Exact.  num_sums[s] is the number of the 2^m subsets of ranks
+	   1..m summing to s, each subset being equally likely to be the
+	   ranks of the positive differences */
+	max_sum = m * (m + 1) / 2;
+	num_sums[0] = 1.0;
+	for (k = 1; k <= max_sum; k++)
+	    num_sums[k] = 0.0;
+	for (i = 1; i <= m; i++) {
+	    for (k = i * (i + 1) / 2; k >= i; k--)
+		num_sums[k] += num_sums[k - i];
+	}
+	v = (long) (v_plus + 0.5);
+	p_lower = p_upper = 0.0;
+	for (k = 0; k <= max_sum; k++) {
+	    if (k <= v)
+		p_lower += num_sums[k];
+	    if (k >= v)
+		p_upper += num_sums[k];
+	}
+	p_lower = ldexp (MIN (p_lower, p_upper), 1 - (int) m);
+	return (MIN (p_lower, 1.0));
+    }
+
+    /* Normal approximation */
+    mean = (double) m * (m + 1) / 4.0;
+    sigma = sqrt ((double) m * (m + 1) * (2 * m + 1) / 24.0 - ties / 48.0);
+    if (sigma <= 0.0)
+	return (1.0);
+    z = v_plus - mean;
+    z = (z - (z > 0.0 ? 0.5 : (z < 0.0 ? -0.5 : 0.0))) / sigma;
+    return (erfc (fabs (z) / sqrt (2.0)));
+}
+
+/* Two-sided p-value of the randomization test of each of the num_values
+   columns (num_queries apart) of n differences, in p_values */
+static int
+randomization_test (const EPI *epi, const double *diffs, long num_queries,
+		    long n, long num_values, long num_permutations,
+		    double *p_values)
+{
+    double *tables = NULL, *observed = NULL, *table;
+    long *counts = NULL;
+    uint64_t *bits = NULL;
+    PERM_TASK *tasks = NULL;
+    long num_words, num_chunks, num_blocks, num_tasks, next_block;
+    long v, c, b, q, t, max_q;
+    double sum, abs_sum;
+    int ret = UNDEF;
+
+    /* Table of the sums of each chunk of 8 differences under each of the
+       256 assignments of signs (bit j set if query 8*c+j is negated) */
+    num_chunks = (n + 7) / 8;
+    num_words = (num_chunks + 7) / 8;
+    if (NULL == (tables = Malloc (num_values * num_chunks * 256 + 1,
+				  double)) ||
+	NULL == (observed = Malloc (num_values + 1, double)))
+	goto done;
+    for (v = 0; v < num_values; v++) {
+	abs_sum = 0.0;
+	for (c = 0; c < num_chunks; c++) {
+	    table = &tables[(v * num_chunks + c) * 256];
+	    max_q = MIN (8, n - 8 * c);
+	    for (b = 0; b < 256; b++) {
+		sum = 0.0;
+		for (q = 0; q < max_q; q++) {
+		    if (b & (1 << q))
+			sum -= diffs[v * num_queries + 8 * c + q];
+		    else
+			sum += diffs[v * num_queries + 8 * c + q];
+		}
+		table[b] = sum;
+	    }
+	    for (q = 0; q < max_q; q++)
+		abs_sum += fabs (diffs[v * num_queries + 8 * c + q]);
+	}
+	/* The observed sum, as a permutation with no signs changed */
+	sum = 0.0;
+	for (c = 0; c < num_chunks; c++)
+	    sum += tables[(v * num_chunks + c) * 256];
+	observed[v] = fabs (sum) - SUM_EPSILON * abs_sum;
+    }
+
+    num_blocks = (num_permutations + PERMS_PER_BLOCK - 1) / PERMS_PER_BLOCK;
+    num_tasks = MIN (te_num_threads (epi->num_threads), num_blocks);
+    if (NULL == (tasks = Malloc (num_tasks, PERM_TASK)) ||
+	NULL == (counts = Malloc (num_tasks * num_values + 1, long)) ||
+	NULL == (bits = Malloc (num_tasks * num_words + 1, uint64_t)))
+	goto done;
+    (void) memset (counts, 0, (num_tasks * num_values + 1) * sizeof (long));
+    next_block = 0;
+    for (t = 0; t < num_tasks; t++)
+	tasks[t] = (PERM_TASK) {tables, observed, num_chunks, num_values,
+				num_permutations, &next_block,
+				&counts[t * num_values], &bits[t * num_words]};
+    if (UNDEF == te_run_parallel (num_tasks, count_block_perms, tasks,
+				  sizeof (PERM_TASK)))
+	goto done;
+
+    for (v = 0; v < num_values; v++) {
+	for (t = 1; t < num_tasks; t++)
+	    counts[v] += counts[t * num_values + v];
+	p_values[v] = (double) counts[v] / (double) num_permutations;
+    }
+    ret = 1;
+
+ done:
+    if (tables != NULL)
+	Free (tables);
+    if (observed != NULL)
+	Free (observed);
+    if (tasks != NULL)
+	Free (tasks);
+    if (counts != NULL)
+	Free (counts);
+    if (bits != NULL)
+	Free (bits);
+    return (ret);
+}
+
+/* Task of randomization_test: take blocks of permutations in turn until
+   none are left, counting the extreme permutations of each value */
+static void *
+count_block_perms (void *arg)
+{
+    PERM_TASK *task = (PERM_TASK *) arg;
+    const double *table;
+    uint64_t *bits = task->bits;
+    TE_RNG rng;
+    long block, p, end, v, c;
+    double sum;
+
+    while ((block = __sync_fetch_and_add (task->next_block, 1)) *
+	   PERMS_PER_BLOCK < task->num_permutations) {
+	te_rng_seed (&rng, PERM_SEED, (uint64_t) block);
+	end = MIN (PERMS_PER_BLOCK,
+		   task->num_permutations - block * PERMS_PER_BLOCK);
+	for (p = 0; p < end; p++) {
+	    /* 8 chunks of 8 queries per random number */
+	    for (c = 0; c < task->num_chunks; c += 8)
+		bits[c / 8] = te_rng_next (&rng);
+	    table = task->tables;
+	    for (v = 0; v < task->num_values; v++) {
+		sum = 0.0;
+		for (c = 0; c < task->num_chunks; c++) {
+		    sum += table[(bits[c / 8] >> (8 * (c % 8))) & 0xff];
+		    table += 256;
+		}
+		if (fabs (sum) >= task->observed[v])
+		    task->counts[v]++;
+	    }
+	}
+    }
+    return (NULL);
+}
+
+/* Regularized incomplete beta function I_x(a,b), by its continued
+   fraction (modified Lentz's method) */
+static double
+incomplete_beta (double a, double b, double x)
+{
+    double front, f, c, d, num;
+    long i, m;
+
+    if (x <= 0.0)
+	return (0.0);
+    if (x >= 1.0)
+	return (1.0);
+    /* The continued fraction converges quickly only below the mean */
+    if (x > (a + 1.0) / (a + b + 2.0))
+	return (1.0 - incomplete_beta (b, a, 1.0 - x));
+
+    front = exp (lgamma (a + b) - lgamma (a) - lgamma (b) +
+		 a * log (x) + b * log (1.0 - x)) / a;
+    f = 1.0;
+    c = 1.0;
+    d = 0.0;
+    for (i = 0; i < 400; i++) {
+	m = i / 2;
+	if (i == 0)
+	    num = 1.0;
+	else if (i % 2 == 0)
+	    num = (m * (b - m) * x) / ((a + 2.0 * m - 1.0) * (a + 2.0 * m));
+	else
+	    num = -((a + m) * (a + b + m) * x) /
+		((a + 2.0 * m) * (a + 2.0 * m + 1.0));
+	d = 1.0 + num * d;
+	if (fabs (d) < 1e-300)
+	    d = 1e-300;
+	d = 1.0 / d;
+	c = 1.0 + num / c;
+	if (fabs (c) < 1e-300)
+	    c = 1e-300;
+	f *= c * d;
+	if (fabs (1.0 - c * d) < 1e-15)
+	    break;
+    }
+    return (front * (f - 1.0));
+}
+
+static int
+comp_signed_diff (SIGNED_DIFF *ptr1, SIGNED_DIFF *ptr2)
+{
+    if (ptr1->abs_diff < ptr2->abs_diff)
+	return (-1);
+    if (ptr1->abs_diff > ptr2->abs_diff)
+	return (1);
+    return (0);
+}
@@ -0,0 +1,477 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Procedures for evaluating one run (all_results) against all_rel_info,
+   given a list of measures.  Used by trec_eval itself with the list of
+   all measures te_trec_measures, and by libtrec_eval (trec_eval_lib.c)
+   with each context's private copies of them.  Which of the measures are
+   calculated is determined by their eval_index (see MARK_MEASURE) */
+
+extern long te_num_trec_measure_nicknames;
+extern TREC_MEASURE_NICKNAMES te_trec_measure_nicknames[];
+extern long te_num_form_inter_procs;
+extern FORM_INTER_PROCS te_form_inter_procs[];
+
+/* Queries are evaluated in blocks.  Within a block, up to epi.num_threads
+   tasks take queries in turn and calculate each into its own slice of
+   the block's values.  The main thread then finishes, accumulates and
+   prints the queries of the block in order, so output does not depend on
+   the number of threads */
+#define EVAL_QUERIES_PER_THREAD 64
+
+typedef struct {
+    long results_index;             /* Index into all_results.results */
+    long rel_index;                 /* Index into all_rel_info arrays */
+} EVAL_QUERY;
+
+typedef struct {
+    const EPI *epi;
+    TREC_MEAS **measures;
+    long num_measures;
+    const ALL_RESULTS *all_results;
+    const ALL_REL_INFO *all_rel_info;
+    const EVAL_QUERY *queries;      /* Queries of block */
+    long num_queries;
+    long *next_query;               /* Next query of block to calculate.
+				       Shared by all tasks of block */
+    TREC_EVAL_VALUE *block_values;  /* num_values values per query */
+    long num_values;
+    long task_num;                  /* Task 0 runs on the main thread */
+} EVAL_TASK;
+
+static void *calc_block (void *arg);
+static int calc_query (const EPI *epi, TREC_MEAS **measures,
+		       long num_measures, const ALL_REL_INFO *all_rel_info,
+		       long rel_index, const RESULTS *results,
+		       long serial_calc_flag, TREC_EVAL *q_eval);
+static int finish_query (EPI *epi, TREC_MEAS **measures, long num_measures,
+			 const ALL_REL_INFO *all_rel_info, long rel_index,
+			 const ALL_ZSCORES *all_zscores,
+			 const RESULTS *results, TREC_EVAL *q_eval,
+			 TREC_EVAL *accum_eval);
+static int keep_query_values (RUN_VALUES *run_values, long rel_index,
+			      const TREC_EVAL *q_eval, const char *run_id);
+static int add_meas_arg_info (EPI *epi, char *meas, char *param);
+static int mark_single_measure (TREC_MEAS **measures, long num_measures,
+				char *name);
+
+/* Evaluate all_results against all_rel_info with the requested measures
+   among measures, and print the values of each query (if query_flag) and
+   the summary values (if summary_flag).  accum_eval holds the initial
+   values of all measures.  If q_evals is non-NULL, the values of the
+   n'th query evaluated are also copied to q_evals[n].values (which must
+   have room for accum_eval->num_values values each).
+   Return the number of queries evaluated, UNDEF if error */
+long
+te_eval_run (EPI *epi, TREC_MEAS **measures, long num_measures,
+	     const ALL_REL_INFO *all_rel_info, const QID_INDEX *qid_index,
+	     const ALL_ZSCORES *all_zscores,
+	     const ALL_RESULTS *all_results, TREC_EVAL *accum_eval,
+	     TREC_EVAL *q_evals)
+{
+    TREC_EVAL q_eval;
+    EVAL_QUERY *queries;
+    long num_eval_queries;
+    TREC_EVAL_VALUE *block_values;
+    long block_size, num_block_queries;
+    EVAL_TASK *tasks;
+    long num_tasks;
+    long next_query;
+    long i,j,b,q;
+
+    /* Find each topic which has both qrels and top results information */
+    if (NULL == (queries = Malloc (all_results->num_q_results, EVAL_QUERY)))
+	return (UNDEF);
+    num_eval_queries = 0;
+    for (i = 0; i < all_results->num_q_results; i++) {
+	/* If debugging a particular query, then skip all others */
+	if (epi->debug_query &&
+	    strcmp (epi->debug_query, all_results->results[i].qid))
+	    continue;
+	/* Find rel info for this query (skip if no rel info) */
+	if (0 > (j = te_qid_index_find (qid_index,
+					all_results->results[i].qid)))
+	    continue;
+	queries[num_eval_queries].results_index = i;
+	queries[num_eval_queries].rel_index = j;
+	num_eval_queries++;
+    }
+    if (num_eval_queries == 0) {
+	Free (queries);
+	return (0);
+    }
+
+    /* Serial evaluation goes one query at a time, so that any debug
+       output is in query order */
+    num_tasks = te_num_threads (epi->num_threads);
+    if (epi->debug_level > 0)
+	num_tasks = 1;
+    block_size = num_tasks == 1 ? 1 : num_tasks * EVAL_QUERIES_PER_THREAD;
+
+    /* Reserve space for the values of each query of a block, each
+       initialized to be copy of accum_eval */
+    if (NULL == (block_values = Malloc (block_size * accum_eval->num_values,
+					TREC_EVAL_VALUE)) ||
+	NULL == (tasks = Malloc (num_tasks, EVAL_TASK)))
+	return (UNDEF);
+    for (q = 0; q < block_size; q++)
+	(void) memcpy (&block_values[q * accum_eval->num_values],
+		       accum_eval->values,
+		       accum_eval->num_values * sizeof (TREC_EVAL_VALUE));
+    q_eval.num_values = q_eval.max_num_values = accum_eval->num_values;
+    q_eval.num_queries = q_eval.num_orig_queries = 0;
+
+    /* For each topic which has both qrels and top results information,
+       calculate, possibly print (if query_flag), and accumulate
+       evaluation measures. */
+    for (b = 0; b < num_eval_queries; b += block_size) {
+	num_block_queries = MIN (block_size, num_eval_queries - b);
+	next_query = 0;
+	for (i = 0; i < num_tasks; i++)
+	    tasks[i] = (EVAL_TASK) {epi, measures, num_measures, all_results,
+				    all_rel_info, &queries[b], num_block_queries,
+				    &next_query, block_values,
+				    accum_eval->num_values, i};
+	if (UNDEF == te_run_parallel (MIN (num_tasks, num_block_queries),
+				      calc_block, tasks, sizeof (EVAL_TASK)))
+	    return (UNDEF);
+
+	for (q = 0; q < num_block_queries; q++) {
+	    i = queries[b+q].results_index;
+	    q_eval.qid = all_results->results[i].qid;
+	    q_eval.values = &block_values[q * accum_eval->num_values];
+
+	    if (UNDEF == finish_query (epi, measures, num_measures,
+				       all_rel_info, queries[b+q].rel_index,
+				       all_zscores, &all_results->results[i],
+				       &q_eval, accum_eval))
+		return (UNDEF);
+
+	    if (q_evals != NULL) {
+		j = accum_eval->num_queries - 1;
+		q_evals[j].qid = q_eval.qid;
+		q_evals[j].num_queries = 1;
+		q_evals[j].num_orig_queries = 1;
+		q_evals[j].num_values = q_eval.num_values;
+		(void) memcpy (q_evals[j].values, q_eval.values,
+			       q_eval.num_values * sizeof (TREC_EVAL_VALUE));
+	    }
+	}
+    }
+    Free (queries);
+    Free (tasks);
+    Free (block_values);
+
+    if (UNDEF == te_eval_summary (epi, measures, num_measures, all_rel_info,
+				  accum_eval))
+	return (UNDEF);
+    return (num_eval_queries);
+}
+
+/* Evaluate the single query results against rel_info rel_index of
+   all_rel_info, exactly as te_eval_run evaluates each of its queries,
+   accumulating into accum_eval and printing (if query_flag).  The values
+   of q_eval must be a copy of the initial values of all measures.  Used
+   to evaluate a run a query at a time as it is read (trec_eval -G), after
+   which te_eval_summary finishes the run.  Return UNDEF if error */
+int
+te_eval_query (EPI *epi, TREC_MEAS **measures, long num_measures,
+	       const ALL_REL_INFO *all_rel_info, long rel_index,
+	       const ALL_ZSCORES *all_zscores, const RESULTS *results,
+	       TREC_EVAL *q_eval, TREC_EVAL *accum_eval)
+{
+    long m;
+
+    q_eval->qid = results->qid;
+    q_eval->num_queries = q_eval->num_orig_queries = 0;
+    for (m = 0; m < q_eval->num_values; m++)
+	q_eval->values[m].value = 0;
+    if (UNDEF == calc_query (epi, measures, num_measures, all_rel_info,
+			     rel_index, results, 0, q_eval))
+	return (UNDEF);
+    return (finish_query (epi, measures, num_measures, all_rel_info,
+			  rel_index, all_zscores, results, q_eval,
+			  accum_eval));
+}
+
+/* Calculate the final averages of accum_eval over the queries
+   accumulated, and print them (if summary_flag), with their bootstrap
+   confidence intervals if requested */
+int
+te_eval_summary (EPI *epi, TREC_MEAS **measures, long num_measures,
+		 const ALL_REL_INFO *all_rel_info, TREC_EVAL *accum_eval)
+{
+    long m;
+
+    if (epi->average_complete_flag) {
+	/* Want to average over possibly missing queries.  Pass in actual
+	 *  number of queries in num_orig_queries */
+	accum_eval->num_orig_queries = accum_eval->num_queries;
+	accum_eval->num_queries = all_rel_info->num_q_rels;
+    }
+
+    if (epi->bootstrap_resamples > 0 && epi->run_values != NULL &&
+	epi->summary_flag &&
+	UNDEF == te_bootstrap_ci (epi, measures, num_measures, accum_eval))
+	return (UNDEF);
+
+    /* Calculate final averages, and print (if desired) */
+    for (m = 0; m < num_measures; m++) {
+	if (MEASURE_REQUESTED(measures[m])) {
+	    if (UNDEF == measures[m]->calc_avg_meas
+		    (epi, measures[m], accum_eval) ||
+		UNDEF == measures[m]->print_final_and_cleanup_meas
+		(epi, measures[m],  accum_eval)) {
+		    fprintf (stderr,"trec_eval: Can't print measure '%s'\n",
+			     measures[m]->name);
+		    return (UNDEF);
+		}
+	}
+    }
+    epi->summary_ci = NULL;
+    return (te_output_flush ());
+}
+
+/* Free the per query pools of the form_* procedures of this thread */
+int
+te_cleanup_form_procs ()
+{
+    long i;
+
+    for (i = 0; i < te_num_form_inter_procs; i++) {
+	if (UNDEF == te_form_inter_procs[i].cleanup ())
+	    return (UNDEF);
+    }
+    return (1);
+}
+
+/* Calculate queries of a block in turn until none are left */
+static void *
+calc_block (void *arg)
+{
+    EVAL_TASK *task = (EVAL_TASK *) arg;
+    TREC_EVAL q_eval;
+    const EVAL_QUERY *query;
+    long q, m;
+    long ret = 1;
+
+    q_eval.num_values = q_eval.max_num_values = task->num_values;
+    q_eval.num_queries = q_eval.num_orig_queries = 0;
+    while ((q = __sync_fetch_and_add (task->next_query, 1)) <
+	   task->num_queries) {
+	query = &task->queries[q];
+	q_eval.qid = task->all_results->results[query->results_index].qid;
+	q_eval.values = &task->block_values[q * task->num_values];
+
+	/* zero out all measures for new query */
+	for (m = 0; m < q_eval.num_values; m++)
+	    q_eval.values[m].value = 0;
+	if (UNDEF == calc_query (task->epi, task->measures,
+				 task->num_measures, task->all_rel_info,
+				 query->rel_index,
+				 &task->all_results->results[query->results_index],
+				 0, &q_eval)) {
+	    ret = UNDEF;
+	    /* Stop all other tasks of block */
+	    (void) __sync_fetch_and_add (task->next_query, task->num_queries);
+	    break;
+	}
+    }
+
+    /* Free the per query pools of the form_* procedures of this thread.
+       The main thread keeps its own until the end of the run */
+    if (task->task_num > 0 && UNDEF == te_cleanup_form_procs ())
+	ret = UNDEF;
+    return ((void *) ret);
+}
+
+/* Calculate all requested measures with the given serial_calc_flag for
+   a single query */
+static int
+calc_query (const EPI *epi, TREC_MEAS **measures, long num_measures,
+	    const ALL_REL_INFO *all_rel_info, long rel_index,
+	    const RESULTS *results, long serial_calc_flag, TREC_EVAL *q_eval)
+{
+    const REL_INFO *rel_info;
+    long m;
+
+    rel_info = &all_rel_info->rel_info[rel_index];
+
+    for (m = 0; m < num_measures; m++) {
+	if (MEASURE_REQUESTED(measures[m]) &&
+	    measures[m]->serial_calc_flag == serial_calc_flag) {
+	    if (UNDEF == measures[m]->calc_meas (epi, rel_info, results,
+						 measures[m], q_eval)) {
+		fprintf (stderr,"trec_eval: Can't calculate measure '%s'\n",
+			 measures[m]->name);
+		return (UNDEF);
+	    }
+	}
+    }
+    return (1);
+}
+
+/* Given q_eval with the measures calculated in parallel, calculate the
+   rest, convert to zscores (if requested), and add to accum_eval and
+   print (if query_flag), and keep in epi->run_values (if non-NULL) */
+static int
+finish_query (EPI *epi, TREC_MEAS **measures, long num_measures,
+	      const ALL_REL_INFO *all_rel_info, long rel_index,
+	      const ALL_ZSCORES *all_zscores, const RESULTS *results,
+	      TREC_EVAL *q_eval, TREC_EVAL *accum_eval)
+{
+    long m;
+
+    /* Calculate measures that could not be calculated in parallel */
+    if (UNDEF == calc_query (epi, measures, num_measures, all_rel_info,
+			     rel_index, results, 1, q_eval))
+	return (UNDEF);
+
+    /* Convert values to zscores if requested */
+    if (epi->zscore_flag) {
+	if (UNDEF == te_convert_to_zscore (all_zscores, q_eval))
+	    return (UNDEF);
+    }
+
+    /* Add this topics value to accumulated values, and possibly print */
+    epi->run_id = results->run_id;
+    for (m = 0; m < num_measures; m++) {
+	if (MEASURE_REQUESTED(measures[m])) {
+	    if (UNDEF == measures[m]->acc_meas (epi, measures[m],
+						q_eval, accum_eval)) {
+		fprintf(stderr,"trec_eval: Can't accumulate measure '%s'\n",
+			measures[m]->name);
+		return (UNDEF);
+	    }
+	    if (epi->query_flag &&
+		UNDEF == measures[m]->print_single_meas (epi, measures[m],
+							 q_eval)) {
+		fprintf(stderr,
+			"trec_eval: Can't print query measure '%s'\n",
+			measures[m]->name);
+		return (UNDEF);
+	    }
+	}
+    }
+    accum_eval->num_queries++;
+    if (epi->query_flag && UNDEF == te_output_flush ())
+	return (UNDEF);
+
+    if (epi->run_values != NULL)
+	return (keep_query_values (epi->run_values, rel_index, q_eval,
+				   results->run_id));
+    return (1);
+}
+
+/* Keep the values of q_eval as those of query rel_index in run_values,
+   and run_id as the runid of the run (the runid of its last query, as
+   printed by the runid measure) */
+static int
+keep_query_values (RUN_VALUES *run_values, long rel_index,
+		   const TREC_EVAL *q_eval, const char *run_id)
+{
+    long v;
+
+    for (v = 0; v < run_values->num_values; v++)
+	run_values->values[v * run_values->num_queries + rel_index] =
+	    q_eval->values[v].value;
+    run_values->evaluated[rel_index] = 1;
+    if (run_values->run_id == NULL || strcmp (run_values->run_id, run_id)) {
+	if (run_values->run_id != NULL)
+	    Free (run_values->run_id);
+	if (NULL == (run_values->run_id = Malloc (strlen (run_id) + 1, char)))
+	    return (UNDEF);
+	(void) strcpy (run_values->run_id, run_id);
+    }
+    return (1);
+}
+
+/* Mark the measures among measures named by optarg (a measure name or
+   nickname, possibly followed by '.' and parameters) to be calculated.
+   Parameters are added to epi->meas_arg, which must have room.
+   optarg is modified */
+int
+te_mark_measure (EPI *epi, TREC_MEAS **measures, long num_measures,
+		 char *optarg)
+{
+    long i;
+    char *ptr;
+
+    ptr = optarg;
+    while (*ptr && *ptr != '.') ptr++;
+    if (*ptr == '.') {
+	*ptr++ = '\0';
+	if (UNDEF == add_meas_arg_info (epi, optarg, ptr))
+	    return (UNDEF);
+    }
+
+    for (i = 0; i < te_num_trec_measure_nicknames; i++) {
+	if (0 == strcmp (optarg, te_trec_measure_nicknames[i].name)) {
+	    /* Have found nickname.  Mark all real names it refers to */
+	    char **name = te_trec_measure_nicknames[i].name_list;
+
+	    while (*name) {
+		if (UNDEF == mark_single_measure (measures, num_measures,
+						  *name))
+		    return (UNDEF);
+		name++;
+	    }
+	    return (1);
+	}
+    }
+
+    /* optarg did not match any nickname, mark measure directly */
+    return (mark_single_measure (measures, num_measures, optarg));
+}
+
+static int
+add_meas_arg_info (EPI *epi, char *meas, char *param)
+{
+    long i;
+
+    /* Guaranteed space since malloc'd argc+1 entries and can't be more
+       than one entry per command line argument */
+
+    /* Find non-NULL entry */
+    i = 0;
+    while (epi->meas_arg[i].measure_name) i++;
+
+    epi->meas_arg[i].measure_name = meas;
+    epi->meas_arg[i].parameters = param;
+
+    /* Ensure measure_name exists, has non_NULL parameter and mark it
+       to be calculated */
+    if (*param == '\0') {
+	fprintf (stderr, "trec_eval: improper measure in parameter '%s'\n",
+		 epi->meas_arg[i].measure_name);
+	return (UNDEF);
+    }
+
+    epi->meas_arg[i+1].measure_name = NULL;
+    return (1);
+}
+
+static int
+mark_single_measure (TREC_MEAS **measures, long num_measures, char *name)
+{
+    long i;
+
+    for (i = 0; i < num_measures; i++) {
+	if (0 == strcmp (name, measures[i]->name)) {
+	    measures[i]->eval_index = -2;
+	    break;
+	}
+    }
+    if (i >= num_measures)
+	return (UNDEF);
+    return (1);
+}
@@ -0,0 +1,649 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+
+double log2(double x);
+
+/* Takes the top docs and judged docs for a query, and returns the
+   evaluation frame of the query (see trec_format.h).  The docs are
+   sorted by sim and merged with the judgements of all aspects of
+   rel_info once, here, instead of separately by the form procedure of
+   every measure, and for every aspect.  The RES_RELS of each aspect are
+   formed from the merge; the ideal orderings of all aspects are formed
+   on the first call to te_form_frame_ideal.  If there are more docs than
+   max_num_docs_per_topic (-M), only the top docs are sorted (after
+   selecting them), unless a measure asks for all of them to be ranked.
+   Results already in rank order in their input are not sorted at all.
+
+   This procedure may be called repeatedly for a given topic - returned
+   values are cached until the query changes.
+
+   results format must be "trec_results" and rel_info format "qrels" (one
+   aspect, TEXT_QRELS_INFO) or "qrels_multiaspect" (TEXT_QRELS_MULTI_INFO).
+   The measure needs the first num_aspects aspects (all if 0); rel_info
+   must have at least that many.  frame->num_aspects is the number of
+   aspects of rel_info, so measures of a single aspect evaluate the first
+   aspect of a qrels_multiaspect file.
+
+   UNDEF returned if error, 0 if used cache values, 1 if new values.
+*/
+
+static int get_qrels (const REL_INFO *rel_info, long num_aspects);
+static int form_res_rels (const EPI *epi, long aspect, long num_ret);
+static int comp_sim_docno (), comp_docno ();
+
+/* Definitions used for temporary values */
+typedef struct {
+    float sim;
+    int docid;
+    long index;
+} RANK_INFO;
+
+/* Current cached query */
+static THREAD_LOCAL char *current_query = "no query";
+static THREAD_LOCAL long max_current_query = 0;
+static THREAD_LOCAL long current_num_aspects = 0;
+
+/* Space reserved for cached returned values */
+static THREAD_LOCAL EVAL_FRAME saved_frame;
+static THREAD_LOCAL long max_docs = 0;
+static THREAD_LOCAL long max_ranked = 0;
+static THREAD_LOCAL long max_rels[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long max_qrels_rels[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long *rel_levels[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long max_rel_levels[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long *ranked_rel_list[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long max_ranked_rel_list[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long *ideal_pos[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long max_ideal_pos[MAX_QRELS_ASPECTS];
+
+/* Space reserved for intermediate values */
+static THREAD_LOCAL int *qrels_docid;
+static THREAD_LOCAL long max_qrels_docid = 0;
+/* Counts of judged docs at each rel_level given by rel_info, if any */
+static THREAD_LOCAL const int *qrels_rel_levels;
+static THREAD_LOCAL long qrels_num_rel_levels;
+static THREAD_LOCAL RANK_INFO *rank_info;
+static THREAD_LOCAL long max_rank_info = 0;
+static THREAD_LOCAL long *level_start;
+static THREAD_LOCAL long max_level_start = 0;
+/* Log discounts of ranks, shared by all queries and measures (including
+   the gains of form_gains.c) */
+static THREAD_LOCAL double *discount;
+static THREAD_LOCAL long max_discount = 0;
+static THREAD_LOCAL long num_discount = 0;
+
+int
+te_form_frame (const EPI *epi, const REL_INFO *rel_info,
+	       const RESULTS *results, long num_aspects, EVAL_FRAME **frame)
+{
+    long i, j, a;
+    long num_docs, num_ret;
+    long rel_aspects;
+    int sorted, presorted;
+    TEXT_RESULTS_INFO *text_results_info;
+    FRAME_DOC *docs;
+
+    /* Check that format type of result info and rel info are correct */
+    if (0 == strcmp ("qrels_multiaspect", rel_info->rel_format))
+	rel_aspects =
+	    ((TEXT_QRELS_MULTI_INFO *) rel_info->q_rel_info)->num_aspects;
+    else if (0 == strcmp ("qrels", rel_info->rel_format))
+	rel_aspects = 1;
+    else
+	rel_aspects = 0;
+    if (rel_aspects == 0 || strcmp ("trec_results", results->ret_format)) {
+	fprintf (stderr, "trec_eval.form_frame: rel_info format not qrels or results format not trec_results\n");
+	return (UNDEF);
+    }
+    if (num_aspects > rel_aspects) {
+	fprintf (stderr, "trec_eval.form_frame: %ld aspects needed, rel_info has %ld\n",
+		 num_aspects, rel_aspects);
+	return (UNDEF);
+    }
+
+    if (rel_aspects == current_num_aspects &&
+	0 == strcmp (current_query, results->qid)) {
+	/* Have done this query already. Return cached values */
+	*frame = &saved_frame;
+	return (0);
+    }
+
+    /* Make sure enough space for query and save copy */
+    i = strlen(results->qid)+1;
+    if (NULL == (current_query =
+		 te_chk_and_malloc (current_query, &max_current_query,
+				    i, sizeof (char))))
+	return (UNDEF);
+    (void) strncpy (current_query, results->qid, i);
+    /* Not cached until complete */
+    current_num_aspects = 0;
+
+    text_results_info = (TEXT_RESULTS_INFO *) results->q_results;
+    num_docs = text_results_info->num_text_results;
+
+    /* Reserve space for output structure and temp ranking */
+    if (NULL == (saved_frame.docs =
+		 te_chk_and_malloc (saved_frame.docs, &max_docs,
+				    num_docs, sizeof (FRAME_DOC))) ||
+	NULL == (saved_frame.ranked =
+		 te_chk_and_malloc (saved_frame.ranked, &max_ranked,
+				    num_docs, sizeof (long))) ||
+	NULL == (rank_info =
+		 te_chk_and_malloc (rank_info, &max_rank_info,
+				    num_docs, sizeof (RANK_INFO))))
+	return (UNDEF);
+    for (a = 0; a < rel_aspects; a++) {
+	if (NULL == (saved_frame.rels[a] =
+		     te_chk_and_malloc (saved_frame.rels[a], &max_rels[a],
+					num_docs, sizeof (long))))
+	    return (UNDEF);
+    }
+    docs = saved_frame.docs;
+
+    /* Results are normally already in docno order */
+    sorted = 1;
+    for (i = 0; i < num_docs; i++) {
+	docs[i].docno = text_results_info->text_results[i].docno;
+	docs[i].docid = text_results_info->text_results[i].docid;
+	docs[i].sim = text_results_info->text_results[i].sim;
+	if (i > 0 && docs[i].docid < docs[i-1].docid)
+	    sorted = 0;
+    }
+    if (! sorted)
+	qsort ((char *) docs,
+	       (int) num_docs,
+	       sizeof (FRAME_DOC),
+	       comp_docno);
+
+    /* Only look at epi->max_num_docs_per_topic (not normally an issue) */
+    num_ret = num_docs;
+    if (num_ret > epi->max_num_docs_per_topic)
+	num_ret = epi->max_num_docs_per_topic;
+
+    /* Rank docs by sim, breaking ties lexicographically using docno.
+       If the results were given in that order, take the order of the
+       input (checking each doc ranks below the one before).  Otherwise
+       only the top num_ret docs are put in order (see
+       te_form_frame_rank_all) */
+    presorted = 0;
+    if (sorted && num_docs > 0 &&
+	text_results_info->text_results[0].file_pos > 0) {
+	for (i = 0; i < num_docs; i++) {
+	    j = text_results_info->text_results[i].file_pos - 1;
+	    rank_info[j].sim = docs[i].sim;
+	    rank_info[j].docid = docs[i].docid;
+	    rank_info[j].index = i;
+	}
+	for (i = 1; i < num_docs; i++) {
+	    if (comp_sim_docno (&rank_info[i-1], &rank_info[i]) >= 0)
+		break;
+	}
+	presorted = (i >= num_docs);
+    }
+    else {
+	for (i = 0; i < num_docs; i++) {
+	    rank_info[i].sim = docs[i].sim;
+	    rank_info[i].docid = docs[i].docid;
+	    rank_info[i].index = i;
+	}
+    }
+    if (presorted)
+	saved_frame.num_ranked = num_docs;
+    else {
+	te_sort_top (rank_info, num_docs, sizeof (RANK_INFO), num_ret,
+		     comp_sim_docno);
+	saved_frame.num_ranked = num_ret;
+    }
+    for (i = 0; i < num_docs; i++) {
+	saved_frame.ranked[i] = rank_info[i].index;
+	docs[rank_info[i].index].rank = i+1;
+    }
+
+    /* Error checking for duplicates among the docs evaluated */
+    for (i = 1; i < num_docs; i++) {
+	if (docs[i].docid == docs[i-1].docid &&
+	    docs[i].rank <= num_ret && docs[i-1].rank <= num_ret) {
+	    fprintf (stderr, "trec_eval.form_frame: duplicate docs %.*s\n",
+		     (int) te_field_len (docs[i].docno),
+		     docs[i].docno);
+	    return (UNDEF);
+	}
+    }
+
+    if (UNDEF == get_qrels (rel_info, rel_aspects))
+	return (UNDEF);
+
+    /* Go through docs, qrels in parallel to determine the judgements of
+       each doc.  Note that qrels already sorted by docno with no
+       duplicates */
+    j = 0;
+    for (i = 0; i < num_docs; i++) {
+	while (j < saved_frame.num_qrels && qrels_docid[j] < docs[i].docid)
+	    j++;
+	if (j >= saved_frame.num_qrels || qrels_docid[j] > docs[i].docid) {
+	    /* Doc is non-judged */
+	    for (a = 0; a < rel_aspects; a++)
+		saved_frame.rels[a][i] = RELVALUE_NONPOOL;
+	}
+	else {
+	    /* Doc is in pool, assign judgements.  Negative judgement is
+	       in pool, but unjudged (eg, infAP uses a sample of pool) */
+	    for (a = 0; a < rel_aspects; a++) {
+		if (saved_frame.qrels_rels[a][j] < 0)
+		    saved_frame.rels[a][i] = RELVALUE_UNJUDGED;
+		else
+		    saved_frame.rels[a][i] = saved_frame.qrels_rels[a][j];
+	    }
+	    j++;
+	}
+    }
+
+    saved_frame.num_aspects = rel_aspects;
+    saved_frame.num_docs = num_docs;
+    for (a = 0; a < rel_aspects; a++) {
+	if (UNDEF == form_res_rels (epi, a, num_ret))
+	    return (UNDEF);
+	saved_frame.ideal_pos[a] = NULL;
+    }
+    saved_frame.num_ideal = num_ret;
+    saved_frame.rank_stats = NULL;
+
+    current_num_aspects = rel_aspects;
+    *frame = &saved_frame;
+    return (1);
+}
+
+/* Copy the docids and judgements of the num_aspects aspects of rel_info
+   into qrels_docid and saved_frame.qrels_rels, and check for duplicate
+   docnos */
+static int
+get_qrels (const REL_INFO *rel_info, long num_aspects)
+{
+    TEXT_QRELS_INFO *text_qrels_info;
+    TEXT_QRELS_MULTI_INFO *text_qrels_multi_info;
+    long num_qrels;
+    short *column;
+    char *docno;
+    long i, a;
+
+    if (0 == strcmp ("qrels", rel_info->rel_format)) {
+	text_qrels_info = (TEXT_QRELS_INFO *) rel_info->q_rel_info;
+	text_qrels_multi_info = NULL;
+	num_qrels = text_qrels_info->num_text_qrels;
+	qrels_rel_levels = text_qrels_info->rel_levels;
+	qrels_num_rel_levels = text_qrels_info->num_rel_levels;
+    }
+    else {
+	text_qrels_info = NULL;
+	text_qrels_multi_info = (TEXT_QRELS_MULTI_INFO *) rel_info->q_rel_info;
+	num_qrels = text_qrels_multi_info->num_text_qrels;
+	qrels_rel_levels = text_qrels_multi_info->rel_levels;
+	qrels_num_rel_levels = text_qrels_multi_info->num_rel_levels;
+    }
+
+    if (NULL == (qrels_docid =
+		 te_chk_and_malloc (qrels_docid, &max_qrels_docid,
+				    num_qrels, sizeof (int))))
+	return (UNDEF);
+    for (a = 0; a < num_aspects; a++) {
+	if (NULL == (saved_frame.qrels_rels[a] =
+		     te_chk_and_malloc (saved_frame.qrels_rels[a],
+					&max_qrels_rels[a],
+					num_qrels, sizeof (long))))
+	    return (UNDEF);
+    }
+
+    if (text_qrels_info) {
+	for (i = 0; i < num_qrels; i++) {
+	    qrels_docid[i] = text_qrels_info->text_qrels[i].docid;
+	    saved_frame.qrels_rels[0][i] = text_qrels_info->text_qrels[i].rel;
+	}
+    }
+    else {
+	for (i = 0; i < num_qrels; i++)
+	    qrels_docid[i] = text_qrels_multi_info->text_qrels[i].docid;
+	/* Judgements are stored a column per aspect */
+	for (a = 0; a < num_aspects; a++) {
+	    column = text_qrels_multi_info->rels + a * num_qrels;
+	    for (i = 0; i < num_qrels; i++)
+		saved_frame.qrels_rels[a][i] = column[i];
+	}
+    }
+
+    for (i = 1; i < num_qrels; i++) {
+	if (qrels_docid[i-1] == qrels_docid[i]) {
+	    docno = text_qrels_info ? text_qrels_info->text_qrels[i].docno :
+		text_qrels_multi_info->text_qrels[i].docno;
+	    fprintf (stderr, "trec_eval.form_frame: duplicate docs %.*s\n",
+		     (int) te_field_len (docno), docno);
+	    return (UNDEF);
+	}
+    }
+    saved_frame.num_qrels = num_qrels;
+    return (1);
+}
+
+/* Construct the RES_RELS of aspect from the merged judgements */
+static int
+form_res_rels (const EPI *epi, long aspect, long num_ret)
+{
+    RES_RELS *res_rels = &saved_frame.res_rels[aspect];
+    long *rels = saved_frame.rels[aspect];
+    long *qrels_rels = saved_frame.qrels_rels[aspect];
+    long max_rel, rel;
+    long i, rrl;
+
+    /* Count judged docs at each rel_level, whether ranked or not (unless
+       rel_info has counted them) */
+    if (qrels_num_rel_levels > 0)
+	max_rel = qrels_num_rel_levels - 1;
+    else {
+	max_rel = 0;
+	for (i = 0; i < saved_frame.num_qrels; i++) {
+	    if (max_rel < qrels_rels[i])
+		max_rel = qrels_rels[i];
+	}
+    }
+    if (NULL == (rel_levels[aspect] =
+		 te_chk_and_malloc (rel_levels[aspect],
+				    &max_rel_levels[aspect],
+				    max_rel + 1, sizeof (long))) ||
+	NULL == (ranked_rel_list[aspect] =
+		 te_chk_and_malloc (ranked_rel_list[aspect],
+				    &max_ranked_rel_list[aspect],
+				    num_ret, sizeof (long))))
+	return (UNDEF);
+    if (qrels_num_rel_levels > 0) {
+	for (i = 0; i <= max_rel; i++)
+	    rel_levels[aspect][i] =
+		qrels_rel_levels[aspect * qrels_num_rel_levels + i];
+    }
+    else {
+	(void) memset (rel_levels[aspect], 0, (max_rel+1) * sizeof (long));
+	for (i = 0; i < saved_frame.num_qrels; i++) {
+	    if (qrels_rels[i] >= 0)
+		rel_levels[aspect][qrels_rels[i]]++;
+	}
+    }
+
+    res_rels->rel_levels = rel_levels[aspect];
+    res_rels->num_rel_levels = 0;
+    res_rels->num_rel = 0;
+    for (i = 0; i <= max_rel; i++) {
+	if (res_rels->rel_levels[i]) {
+	    res_rels->num_rel_levels = i + 1;
+	    if (i >= epi->relevance_level)
+		res_rels->num_rel += res_rels->rel_levels[i];
+	}
+    }
+
+    /* Construct ranked_rel_list and associated counts */
+    res_rels->num_rel_ret = 0;
+    res_rels->num_nonpool = 0;
+    res_rels->num_unjudged_in_pool = 0;
+    res_rels->results_rel_list = ranked_rel_list[aspect];
+    if (epi->judged_docs_only_flag) {
+	/* If judged_docs_only_flag, then unjudged docs are thrown out,
+	   judged docs keeping their order */
+	rrl = 0;
+	for (i = 0; i < num_ret; i++) {
+	    rel = rels[saved_frame.ranked[i]];
+	    if (rel >= 0) {
+		if (rel >= epi->relevance_level)
+		    res_rels->num_rel_ret++;
+		res_rels->results_rel_list[rrl++] = rel;
+	    }
+	}
+	res_rels->num_ret = rrl;
+    }
+    else {
+	/* Normal path.  Assign rel value to appropriate rank */
+	for (i = 0; i < num_ret; i++) {
+	    rel = rels[saved_frame.ranked[i]];
+	    res_rels->results_rel_list[i] = rel;
+	    if (RELVALUE_NONPOOL == rel)
+		res_rels->num_nonpool++;
+	    else if (RELVALUE_UNJUDGED == rel)
+		res_rels->num_unjudged_in_pool++;
+	    else if (rel >= epi->relevance_level)
+		res_rels->num_rel_ret++;
+	}
+	res_rels->num_ret = num_ret;
+    }
+    return (1);
+}
+
+/* Put all the docs of frame in rank order: only the top
+   max_num_docs_per_topic docs (those evaluated by most measures) are
+   ranked by te_form_frame; the multi-aspect measures go through all
+   docs in rank order.
+   UNDEF returned if error, 0 if already ranked, 1 if newly ranked. */
+int
+te_form_frame_rank_all (EVAL_FRAME *frame)
+{
+    long i;
+
+    if (frame->num_ranked == frame->num_docs)
+	return (0);
+
+    /* The docs not yet ranked all rank below the top ones */
+    qsort ((char *) &rank_info[frame->num_ranked],
+	   (int) (frame->num_docs - frame->num_ranked),
+	   sizeof (RANK_INFO),
+	   comp_sim_docno);
+    for (i = frame->num_ranked; i < frame->num_docs; i++) {
+	frame->ranked[i] = rank_info[i].index;
+	frame->docs[rank_info[i].index].rank = i+1;
+    }
+    frame->num_ranked = frame->num_docs;
+    return (1);
+}
+
+/* Set frame->ideal_pos, the ideal orderings of every aspect of the first
+   frame->num_ideal docs (in docno order).  Docs are counting sorted by
+   decreasing judgement, all aspects together; going through them once
+   in rank order breaks ties by rank.
+   UNDEF returned if error, 0 if already set, 1 if new values. */
+int
+te_form_frame_ideal (EVAL_FRAME *frame)
+{
+    long max_rel[MAX_QRELS_ASPECTS];
+    long *start[MAX_QRELS_ASPECTS];
+    long num_levels, rel, pos, num_at_rel;
+    long i, d, a;
+
+    if (frame->ideal_pos[0])
+	return (0);
+
+    if (UNDEF == te_form_frame_rank_all (frame))
+	return (UNDEF);
+
+    num_levels = 0;
+    for (a = 0; a < frame->num_aspects; a++) {
+	max_rel[a] = 0;
+	for (i = 0; i < frame->num_ideal; i++) {
+	    if (max_rel[a] < frame->rels[a][i])
+		max_rel[a] = frame->rels[a][i];
+	}
+	num_levels += max_rel[a] + 1;
+	if (NULL == (ideal_pos[a] =
+		     te_chk_and_malloc (ideal_pos[a], &max_ideal_pos[a],
+					frame->num_ideal, sizeof (long))))
+	    return (UNDEF);
+    }
+    if (NULL == (level_start =
+		 te_chk_and_malloc (level_start, &max_level_start,
+				    num_levels, sizeof (long))))
+	return (UNDEF);
+    (void) memset (level_start, 0, num_levels * sizeof (long));
+
+    /* Count docs at each judgement of each aspect, then find the position
+       of the first doc with each judgement */
+    start[0] = level_start;
+    for (a = 1; a < frame->num_aspects; a++)
+	start[a] = start[a-1] + max_rel[a-1] + 1;
+    for (i = 0; i < frame->num_ideal; i++) {
+	for (a = 0; a < frame->num_aspects; a++)
+	    start[a][MAX (frame->rels[a][i], 0)]++;
+    }
+    for (a = 0; a < frame->num_aspects; a++) {
+	pos = 0;
+	for (rel = max_rel[a]; rel >= 0; rel--) {
+	    num_at_rel = start[a][rel];
+	    start[a][rel] = pos;
+	    pos += num_at_rel;
+	}
+    }
+
+    for (i = 0; i < frame->num_docs; i++) {
+	d = frame->ranked[i];
+	if (d >= frame->num_ideal)
+	    continue;
+	for (a = 0; a < frame->num_aspects; a++)
+	    ideal_pos[a][d] = start[a][MAX (frame->rels[a][d], 0)]++;
+    }
+    for (a = 0; a < frame->num_aspects; a++)
+	frame->ideal_pos[a] = ideal_pos[a];
+    return (1);
+}
+
+/* Set weights[a] to the weight of aspect a of frame in the multi-aspect
+   measure tm: the float parameters of tm, one per aspect, or equal
+   weights summing to 1 if it has none (eg, 'trec_eval -m cam_multi.0.6,0.4'
+   weights relevance 0.6 and credibility 0.4).
+   UNDEF returned if tm has parameters, but not frame->num_aspects */
+int
+te_form_frame_weights (const TREC_MEAS *tm, const EVAL_FRAME *frame,
+		       double *weights)
+{
+    long a;
+
+    if (tm->meas_params == NULL || tm->meas_params->num_params == 0) {
+	for (a = 0; a < frame->num_aspects; a++)
+	    weights[a] = 1.0 / (double) frame->num_aspects;
+	return (1);
+    }
+    if (tm->meas_params->num_params != frame->num_aspects) {
+	fprintf (stderr, "trec_eval.form_frame: %s given %ld weights for %ld aspects\n",
+		 tm->name, tm->meas_params->num_params, frame->num_aspects);
+	return (UNDEF);
+    }
+    for (a = 0; a < frame->num_aspects; a++)
+	weights[a] = ((double *) tm->meas_params->param_values)[a];
+    return (1);
+}
+
+/* Set *discount_ptr to the log discounts of the first num ranks:
+   (*discount_ptr)[i] = log2 (i+2), the discount of the doc of rank i+1.
+   The table is kept for the thread, and only extended (never
+   recomputed) when a longer ranking comes along.
+   UNDEF returned if error, 1 otherwise. */
+int
+te_form_frame_discount (long num, const double **discount_ptr)
+{
+    long i;
+
+    if (num > num_discount) {
+	if (NULL == (discount =
+		     te_chk_and_realloc (discount, &max_discount,
+					 num, sizeof (double))))
+	    return (UNDEF);
+	for (i = num_discount; i < num; i++)
+	    discount[i] = log2 ((double) (i+2));
+	num_discount = num;
+    }
+    *discount_ptr = discount;
+    return (1);
+}
+
+static int
+comp_sim_docno (ptr1, ptr2)
+RANK_INFO *ptr1;
+RANK_INFO *ptr2;
+{
+    if (ptr1->sim > ptr2->sim)
+        return (-1);
+    if (ptr1->sim < ptr2->sim)
+        return (1);
+    return (ptr2->docid - ptr1->docid);
+}
+
+static int
+comp_docno (ptr1, ptr2)
+FRAME_DOC *ptr1;
+FRAME_DOC *ptr2;
+{
+    return (ptr1->docid - ptr2->docid);
+}
+
+int
+te_form_frame_cleanup ()
+{
+    long a;
+
+    if (max_current_query > 0) {
+	Free (current_query);
+	max_current_query = 0;
+	current_query = "no_query";
+    }
+    current_num_aspects = 0;
+    if (max_docs > 0) {
+	Free (saved_frame.docs);
+	max_docs = 0;
+    }
+    if (max_ranked > 0) {
+	Free (saved_frame.ranked);
+	max_ranked = 0;
+    }
+    for (a = 0; a < MAX_QRELS_ASPECTS; a++) {
+	if (max_rels[a] > 0) {
+	    Free (saved_frame.rels[a]);
+	    max_rels[a] = 0;
+	}
+	if (max_qrels_rels[a] > 0) {
+	    Free (saved_frame.qrels_rels[a]);
+	    max_qrels_rels[a] = 0;
+	}
+	if (max_rel_levels[a] > 0) {
+	    Free (rel_levels[a]);
+	    max_rel_levels[a] = 0;
+	}
+	if (max_ranked_rel_list[a] > 0) {
+	    Free (ranked_rel_list[a]);
+	    max_ranked_rel_list[a] = 0;
+	}
+	if (max_ideal_pos[a] > 0) {
+	    Free (ideal_pos[a]);
+	    max_ideal_pos[a] = 0;
+	}
+	saved_frame.ideal_pos[a] = NULL;
+    }
+    saved_frame.rank_stats = NULL;
+    if (max_qrels_docid > 0) {
+	Free (qrels_docid);
+	max_qrels_docid = 0;
+    }
+    if (max_rank_info > 0) {
+	Free (rank_info);
+	max_rank_info = 0;
+    }
+    if (max_level_start > 0) {
+	Free (level_start);
+	max_level_start = 0;
+    }
+    if (max_discount > 0) {
+	Free (discount);
+	max_discount = 0;
+	num_discount = 0;
+    }
+    return (1);
+}
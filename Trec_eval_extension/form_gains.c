@@ -0,0 +1,256 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+
+/* The DCG kernel has an AVX2 version (gathering the gains of four docs at
+   a time), used if the cpu running it has AVX2 */
+#if defined (__GNUC__) && defined (__x86_64__) && __SIZEOF_LONG__ == 8
+#include <immintrin.h>
+#define DCG_AVX2
+#endif
+
+/* Takes the RES_RELS of a query (of any aspect) and the 'rel_level=gain'
+   parameters (possibly NULL) of a measure of the nDCG family, and returns
+   the gains of the query (see GAINS in trec_format.h).  Gain values are
+   the rel_level by default.  Gains are looked up in a table indexed by
+   rel_level, and divided by the log discounts of ranks of the table
+   shared with the other measures (see te_form_frame_discount).
+
+   Returned values are valid until the next call on this thread.
+   UNDEF returned if error, 1 otherwise.
+*/
+
+static int comp_rel_gain ();
+static double dcg_scalar (const GAINS *gains, const long *rel_list,
+			  long start, long end);
+#ifdef DCG_AVX2
+static double dcg_avx2 (const GAINS *gains, const long *rel_list,
+			long start, long end);
+#endif
+
+/* Space reserved for returned values */
+static THREAD_LOCAL REL_GAIN *rel_gains;
+static THREAD_LOCAL long max_rel_gains = 0;
+static THREAD_LOCAL double *level_gains;
+static THREAD_LOCAL long max_level_gains = 0;
+
+int
+te_form_gains (const RES_RELS *res_rels, const PARAMS *params, GAINS *gains)
+{
+    FLOAT_PARAM_PAIR *pairs = NULL;
+    long num_pairs = 0;
+    long i,j;
+    long num_gains;
+    long max_level, num_ranks;
+
+    if (params) {
+	pairs = (FLOAT_PARAM_PAIR *) params->param_values;
+	num_pairs = params->num_params;
+    }
+
+    if (NULL == (rel_gains =
+		 te_chk_and_malloc (rel_gains, &max_rel_gains,
+				    res_rels->num_rel_levels + num_pairs + 1,
+				    sizeof (REL_GAIN))))
+	return (UNDEF);
+    num_gains = 0;
+    for (i = 0; i < num_pairs; i++) {
+	rel_gains[num_gains].rel_level = atol (pairs[i].name);
+	rel_gains[num_gains].gain = (double) pairs[i].value;
+	rel_gains[num_gains].num_at_level = 0;
+	num_gains++;
+    }
+
+    for (i = 0; i < res_rels->num_rel_levels; i++) {
+	for (j = 0; j < num_gains && rel_gains[j].rel_level != i; j++)
+	    ;
+	if (j < num_gains)
+	    /* Was included in list of parameters. Update occurrence info */
+	    rel_gains[j].num_at_level = res_rels->rel_levels[i];
+	else {
+	    /* Not included in list of parameters. New gain level */
+	    rel_gains[num_gains].rel_level = i;
+	    rel_gains[num_gains].gain = (double) i;
+	    rel_gains[num_gains].num_at_level = res_rels->rel_levels[i];
+	    num_gains++;
+	}
+    }
+
+    /* Sort gains by increasing gain value */
+    qsort ((char *) rel_gains,
+           (int) num_gains,
+           sizeof (REL_GAIN),
+           comp_rel_gain);
+
+    gains->total_num_at_levels = 0;
+    for (i = 0; i < num_gains; i++)
+	gains->total_num_at_levels += rel_gains[i].num_at_level;
+    gains->rel_gains = rel_gains;
+    gains->num_gains = num_gains;
+
+    /* Table of the gains of the rel_levels that can be retrieved: the
+       judged rel_levels, RELVALUE_NONPOOL and RELVALUE_UNJUDGED, and any
+       negative rel_level given a gain.  The first of several gains
+       given a rel_level is used */
+    gains->min_level = RELVALUE_UNJUDGED;
+    for (i = 0; i < num_gains; i++) {
+	if (rel_gains[i].rel_level < gains->min_level)
+	    gains->min_level = rel_gains[i].rel_level;
+    }
+    max_level = res_rels->num_rel_levels - 1;
+    gains->num_level_gains = max_level - gains->min_level + 1;
+    if (NULL == (level_gains =
+		 te_chk_and_malloc (level_gains, &max_level_gains,
+				    gains->num_level_gains, sizeof (double))))
+	return (UNDEF);
+    for (i = 0; i < gains->num_level_gains; i++)
+	level_gains[i] = 0.0;
+    for (i = num_gains - 1; i >= 0; i--) {
+	if (rel_gains[i].rel_level <= max_level)
+	    level_gains[rel_gains[i].rel_level - gains->min_level] =
+		rel_gains[i].gain;
+    }
+    gains->level_gains = level_gains;
+
+    /* Discounts of all retrieved and ideal ranks */
+    num_ranks = MAX (res_rels->num_ret, gains->total_num_at_levels);
+    if (UNDEF == te_form_frame_discount (num_ranks, &gains->discount))
+	return (UNDEF);
+
+    return (1);
+}
+
+static int comp_rel_gain (REL_GAIN *ptr1, REL_GAIN *ptr2)
+{
+    return (ptr1->gain - ptr2->gain);
+}
+
+/* Return the gain of rel_level */
+double
+te_gains_gain (const GAINS *gains, long rel_level)
+{
+    long index = rel_level - gains->min_level;
+
+    if (index < 0 || index >= gains->num_level_gains)
+	return (0.0);
+    return (gains->level_gains[index]);
+}
+
+/* Return the DCG of ranks start+1 to end of rel_list (the rel_levels of
+   the retrieved docs, eg results_rel_list of RES_RELS): the sum of the
+   gain divided by the discount of each */
+double
+te_gains_dcg (const GAINS *gains, const long *rel_list, long start, long end)
+{
+#ifdef DCG_AVX2
+    if (end - start >= 8 && __builtin_cpu_supports ("avx2"))
+	return (dcg_avx2 (gains, rel_list, start, end));
+#endif
+    return (dcg_scalar (gains, rel_list, start, end));
+}
+
+static double
+dcg_scalar (const GAINS *gains, const long *rel_list, long start, long end)
+{
+    double dcg = 0.0;
+    long i, index;
+
+    for (i = start; i < end; i++) {
+	index = rel_list[i] - gains->min_level;
+	if (index >= 0 && index < gains->num_level_gains)
+	    dcg += gains->level_gains[index] / gains->discount[i];
+    }
+    return (dcg);
+}
+
+#ifdef DCG_AVX2
+/* Four docs at a time: gather the gains of their rel_levels (rel_levels
+   out of the table masked to gain 0.0), divide by their discounts and
+   add into four partial sums */
+__attribute__ ((target ("avx2")))
+static double
+dcg_avx2 (const GAINS *gains, const long *rel_list, long start, long end)
+{
+    const __m256i min_level = _mm256_set1_epi64x (gains->min_level);
+    const __m256i num_level_gains =
+	_mm256_set1_epi64x (gains->num_level_gains);
+    const __m256i minus_one = _mm256_set1_epi64x (-1);
+    __m256d sum = _mm256_setzero_pd ();
+    __m256i index, in_table;
+    __m256d gain;
+    double part[4];
+    double dcg;
+    long i;
+
+    for (i = start; i + 4 <= end; i += 4) {
+	index = _mm256_sub_epi64 (_mm256_loadu_si256 ((const __m256i *)
+						      &rel_list[i]),
+				  min_level);
+	in_table = _mm256_and_si256 (_mm256_cmpgt_epi64 (index, minus_one),
+				     _mm256_cmpgt_epi64 (num_level_gains,
+							 index));
+	gain = _mm256_mask_i64gather_pd (_mm256_setzero_pd (),
+					 gains->level_gains, index,
+					 _mm256_castsi256_pd (in_table), 8);
+	sum = _mm256_add_pd (sum,
+			     _mm256_div_pd (gain,
+					    _mm256_loadu_pd (&gains->discount[i])));
+    }
+    _mm256_storeu_pd (part, sum);
+    dcg = (part[0] + part[1]) + (part[2] + part[3]);
+    return (dcg + dcg_scalar (gains, rel_list, i, end));
+}
+#endif
+
+/* Return the DCG of ranks start+1 to end of the ideal ranking: the
+   judged docs by decreasing gain, up to the first gain that is not
+   positive */
+double
+te_gains_ideal_dcg (const GAINS *gains, long start, long end)
+{
+    const REL_GAIN *rel_gain;
+    double dcg = 0.0;
+    long pos, from, to, i;
+
+    if (gains->num_gains == 0 ||
+	gains->rel_gains[gains->num_gains - 1].gain <= 0.0)
+	return (0.0);
+
+    pos = 0;
+    for (rel_gain = &gains->rel_gains[gains->num_gains - 1];
+	 rel_gain >= gains->rel_gains && pos < end;
+	 rel_gain--) {
+	if (rel_gain->num_at_level == 0)
+	    continue;
+	if (rel_gain->gain <= 0.0)
+	    break;
+	from = MAX (pos, start);
+	to = MIN (pos + rel_gain->num_at_level, end);
+	for (i = from; i < to; i++)
+	    dcg += rel_gain->gain / gains->discount[i];
+	pos += rel_gain->num_at_level;
+    }
+    return (dcg);
+}
+
+int
+te_form_gains_cleanup ()
+{
+    if (max_rel_gains > 0) {
+	Free (rel_gains);
+	max_rel_gains = 0;
+    }
+    if (max_level_gains > 0) {
+	Free (level_gains);
+	max_level_gains = 0;
+    }
+    return (1);
+}
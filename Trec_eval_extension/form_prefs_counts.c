@@ -104,6 +104,7 @@ Three part process here:
 
 typedef struct {
     char *docno;
+    int docid;
     float sim;
     long rank;
 } DOCNO_RESULTS;
@@ -113,6 +114,7 @@ typedef struct {
     char *jsg;
     float rel_level;
     char *docno;
+    int docid;
     long rank;
 } PREFS_AND_RANKS;
 
@@ -155,40 +157,40 @@ static void debug_print_prefs_and_ranks (PREFS_AND_RANKS *par, long num_prefs,
  /* Temp Structure for mapping results docno to results rank */
 
 /* Current cached query */
-static char *current_query = "no query";
-static long max_current_query = 0;
+static THREAD_LOCAL char *current_query = "no query";
+static THREAD_LOCAL long max_current_query = 0;
 
 /* Space reserved for cached returned values */
-static long num_judged_ret;
-static long num_judged;
-static long num_jgs;
-static JG *jgs;
-static long max_num_jgs = 0;
-static long *rank_pool;
-static long max_rank_pool = 0;
-static EC *ec_pool;
-static long max_ec_pool = 0;
-static unsigned short *ca_pool;      
-static long max_ca_pool = 0;
-static unsigned short **ca_ptr_pool; 
-static long max_ca_ptr_pool = 0;
-static unsigned char *pa_pool;
-static long max_pa_pool = 0;
-static unsigned char **pa_ptr_pool;
-static long max_pa_ptr_pool = 0;
-static float *rel_pool;
-static long max_rel_pool = 0;
+static THREAD_LOCAL long num_judged_ret;
+static THREAD_LOCAL long num_judged;
+static THREAD_LOCAL long num_jgs;
+static THREAD_LOCAL JG *jgs;
+static THREAD_LOCAL long max_num_jgs = 0;
+static THREAD_LOCAL long *rank_pool;
+static THREAD_LOCAL long max_rank_pool = 0;
+static THREAD_LOCAL EC *ec_pool;
+static THREAD_LOCAL long max_ec_pool = 0;
+static THREAD_LOCAL unsigned short *ca_pool;      
+static THREAD_LOCAL long max_ca_pool = 0;
+static THREAD_LOCAL unsigned short **ca_ptr_pool; 
+static THREAD_LOCAL long max_ca_ptr_pool = 0;
+static THREAD_LOCAL unsigned char *pa_pool;
+static THREAD_LOCAL long max_pa_pool = 0;
+static THREAD_LOCAL unsigned char **pa_ptr_pool;
+static THREAD_LOCAL long max_pa_ptr_pool = 0;
+static THREAD_LOCAL float *rel_pool;
+static THREAD_LOCAL long max_rel_pool = 0;
 /* Space reserved for intermediate values */
-static PREFS_AND_RANKS *prefs_and_ranks;
-static long max_prefs_and_ranks = 0;
-static DOCNO_RESULTS *docno_results;
-static long max_docno_results = 0;
-static unsigned char *temp_pa_pool;
-static long max_temp_pa_pool;
-static unsigned char **temp_pa_ptr_pool;
-static long max_temp_pa_ptr_pool;
+static THREAD_LOCAL PREFS_AND_RANKS *prefs_and_ranks;
+static THREAD_LOCAL long max_prefs_and_ranks = 0;
+static THREAD_LOCAL DOCNO_RESULTS *docno_results;
+static THREAD_LOCAL long max_docno_results = 0;
+static THREAD_LOCAL unsigned char *temp_pa_pool;
+static THREAD_LOCAL long max_temp_pa_pool;
+static THREAD_LOCAL unsigned char **temp_pa_ptr_pool;
+static THREAD_LOCAL long max_temp_pa_ptr_pool;
 
-static long saved_num_judged = 0;
+static THREAD_LOCAL long saved_num_judged = 0;
 
 
 
@@ -809,13 +811,15 @@ static int form_prefs_and_ranks (const EPI*epi,
 
     for (i = 0; i < num_results; i++) {
 	docno_results[i].docno = text_results_info->text_results[i].docno;
+	docno_results[i].docid = text_results_info->text_results[i].docid;
 	docno_results[i].sim = text_results_info->text_results[i].sim;
     }
-    /* Sort results by sim, breaking ties lexicographically using docno */
-    qsort ((char *) docno_results,
-	   (int) num_results,
-	   sizeof (DOCNO_RESULTS),
-	   comp_sim_docno);
+    /* Sort results by sim, breaking ties lexicographically using docno.
+       Only the top epi->max_num_docs_per_topic are looked at below, so
+       only they need be sorted */
+    te_sort_top (docno_results, num_results, sizeof (DOCNO_RESULTS),
+		 MIN (num_results, epi->max_num_docs_per_topic),
+		 comp_sim_docno);
 
     if (epi->debug_level >= 5)
 	debug_print_docno_results (docno_results, num_results,
@@ -835,9 +839,9 @@ static int form_prefs_and_ranks (const EPI*epi,
            comp_docno);
     /* Error checking for duplicates */
     for (i = 1; i < num_results; i++) {
-	if (0 == strcmp (docno_results[i].docno,
-			 docno_results[i-1].docno)) {
-	    fprintf (stderr, "trec_eval.form_prefs_counts: duplicate docs %s",
+	if (docno_results[i].docid == docno_results[i-1].docid) {
+	    fprintf (stderr, "trec_eval.form_prefs_counts: duplicate docs %.*s",
+		     (int) te_field_len (docno_results[i].docno),
 		     docno_results[i].docno);
 	    return (UNDEF);
 	}
@@ -853,6 +857,7 @@ static int form_prefs_and_ranks (const EPI*epi,
 	prefs_and_ranks[i].jsg = trec_prefs->text_prefs[i].jsg;
 	prefs_and_ranks[i].rel_level = trec_prefs->text_prefs[i].rel_level;
 	prefs_and_ranks[i].docno = trec_prefs->text_prefs[i].docno;
+	prefs_and_ranks[i].docid = trec_prefs->text_prefs[i].docid;
     }
     qsort ((char *) prefs_and_ranks,
 	   (int) num_prefs,
@@ -870,14 +875,14 @@ static int form_prefs_and_ranks (const EPI*epi,
     end_ranks = &prefs_and_ranks[num_prefs];
     for (i = 0; i < num_results && ranks_ptr < end_ranks; i++) {
         while (ranks_ptr < end_ranks &&
-               strcmp (ranks_ptr->docno, docno_results[i].docno) < 0)
+               ranks_ptr->docid < docno_results[i].docid)
             ranks_ptr++;
         if (ranks_ptr < end_ranks &&
-	    strcmp (ranks_ptr->docno, docno_results[i].docno) == 0) {
+	    ranks_ptr->docid == docno_results[i].docid) {
 	    do {
 		ranks_ptr++;
 	    } while (ranks_ptr < end_ranks &&
-		     strcmp (ranks_ptr->docno, docno_results[i].docno) == 0);
+		     ranks_ptr->docid == docno_results[i].docid);
 	}
 	else
 	    /* dpcno_results[i] not judged */
@@ -899,6 +904,7 @@ static int form_prefs_and_ranks (const EPI*epi,
     for (i = 0; i < num_results; i ++) {
 	if (docno_results[i].rank > -1) {
 	    docno_results[lnum_judged_ret].docno = docno_results[i].docno;
+	    docno_results[lnum_judged_ret].docid = docno_results[i].docid;
 	    docno_results[lnum_judged_ret].rank = lnum_judged_ret;
 	    lnum_judged_ret++;
 	}
@@ -920,10 +926,10 @@ static int form_prefs_and_ranks (const EPI*epi,
     end_ranks = &prefs_and_ranks[num_prefs];
     next_unretrieved_rank = num_results;
     for (i = 0; i < num_results; i++) {
-	while (strcmp (ranks_ptr->docno, docno_results[i].docno) < 0) {
+	while (ranks_ptr->docid < docno_results[i].docid) {
 	    ranks_ptr->rank = next_unretrieved_rank++;
 	    start_ptr = ranks_ptr++;
-	    while (strcmp (ranks_ptr->docno, start_ptr->docno) == 0) {
+	    while (ranks_ptr->docid == start_ptr->docid) {
 		ranks_ptr->rank = start_ptr->rank;
 		ranks_ptr++;
 	    }
@@ -931,7 +937,7 @@ static int form_prefs_and_ranks (const EPI*epi,
 	ranks_ptr->rank = docno_results[i].rank;
 	start_ptr = ranks_ptr++;
 	while (ranks_ptr < end_ranks &&
-	       strcmp (ranks_ptr->docno, start_ptr->docno) == 0) {
+	       ranks_ptr->docid == start_ptr->docid) {
 	    ranks_ptr->rank = start_ptr->rank;
 	    ranks_ptr++;
 	}
@@ -940,7 +946,7 @@ static int form_prefs_and_ranks (const EPI*epi,
 	ranks_ptr->rank = next_unretrieved_rank++;
 	start_ptr = ranks_ptr++;
 	while (ranks_ptr < end_ranks &&
-	       strcmp (ranks_ptr->docno, start_ptr->docno) == 0) {
+	       ranks_ptr->docid == start_ptr->docid) {
 	    ranks_ptr->rank = start_ptr->rank;
 	    ranks_ptr++;
 	}
@@ -998,7 +1004,7 @@ init_counts_array (COUNTS_ARRAY *ca)
 static int 
 comp_prefs_and_ranks_docno (PREFS_AND_RANKS *ptr1, PREFS_AND_RANKS *ptr2)
 {
-    return (strcmp (ptr1->docno, ptr2->docno));
+    return (ptr1->docid - ptr2->docid);
 }
 
 static int 
@@ -1022,13 +1028,13 @@ DOCNO_RESULTS *ptr2;
         return (-1);
     if (ptr1->sim < ptr2->sim)
         return (1);
-    return (strcmp (ptr1->docno, ptr2->docno));
+    return (ptr1->docid - ptr2->docid);
 }
 
 static int 
 comp_docno (DOCNO_RESULTS *ptr1, DOCNO_RESULTS *ptr2)
 {
-    return (strcmp (ptr1->docno, ptr2->docno));
+    return (ptr1->docid - ptr2->docid);
 }
 
 static int 
@@ -1061,8 +1067,9 @@ debug_print_docno_results (DOCNO_RESULTS *dr, long num_results,
     printf ("Docno_results Dump.  num_results %ld, %s\n",
 	    num_results, location);
     for (i = 0; i < num_results; i++) {
-	printf ("  %s\t%4.2f\t%3ld\n",
-		dr[i].docno, dr[i].sim, dr[i].rank);
+	printf ("  %.*s\t%4.2f\t%3ld\n",
+		(int) te_field_len (dr[i].docno), dr[i].docno,
+		dr[i].sim, dr[i].rank);
     }
     fflush (stdout);
 }
@@ -0,0 +1,172 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+
+double log2(double x);
+
+/* Takes the top docs and judged docs for a query, and returns its
+   RES_RELS along with the statistics of its ranking (see RANK_STATS in
+   trec_format.h).  The standard measures used to each go down
+   results_rel_list themselves (map, P, recall, bpref, infAP, ...);
+   instead all their counters and sums are updated here, in one pass
+   down the list, and each measure copies out its values at its cutoffs.
+
+   This procedure may be called repeatedly for a given topic - returned
+   values are cached with the query's evaluation frame (see form_frame.c)
+   until the query changes.
+
+   UNDEF returned if error, 0 if used cache values, 1 if new values.
+*/
+
+/* Space reserved for cached returned values */
+static THREAD_LOCAL RANK_STATS saved_stats;
+static THREAD_LOCAL long max_rel_ret = 0;
+static THREAD_LOCAL long max_prec_sum = 0;
+static THREAD_LOCAL long max_int_prec = 0;
+
+int
+te_form_rank_stats (const EPI *epi, const REL_INFO *rel_info,
+		    const RESULTS *results, RES_RELS *res_rels,
+		    RANK_STATS *rank_stats)
+{
+    EVAL_FRAME *frame;
+    const long *rel_list;
+    long num_ret, rel;
+    long i, r;
+    long rel_so_far;
+    long judged_rel_so_far, nonrel_so_far, pool_unjudged_so_far;
+    long num_nonrel;
+    double sum, precis;
+
+    if (UNDEF == te_form_frame (epi, rel_info, results, 1, &frame))
+	return (UNDEF);
+    *res_rels = frame->res_rels[0];
+    if (frame->rank_stats) {
+	*rank_stats = *frame->rank_stats;
+	return (0);
+    }
+
+    num_ret = res_rels->num_ret;
+    rel_list = res_rels->results_rel_list;
+    if (NULL == (saved_stats.rel_ret =
+		 te_chk_and_malloc (saved_stats.rel_ret, &max_rel_ret,
+				    num_ret + 1, sizeof (long))) ||
+	NULL == (saved_stats.prec_sum =
+		 te_chk_and_malloc (saved_stats.prec_sum, &max_prec_sum,
+				    num_ret + 1, sizeof (double))) ||
+	NULL == (saved_stats.int_prec =
+		 te_chk_and_malloc (saved_stats.int_prec, &max_int_prec,
+				    num_ret + 1, sizeof (double))))
+	return (UNDEF);
+
+    /* Judged nonrelevant docs, whether retrieved or not (for bpref) */
+    num_nonrel = 0;
+    for (i = 0; i < MIN (epi->relevance_level, res_rels->num_rel_levels); i++)
+	num_nonrel += res_rels->rel_levels[i];
+
+    saved_stats.first_rel = 0;
+    saved_stats.bpref_sum = 0.0;
+    saved_stats.infap_sum = 0.0;
+    saved_stats.bin_g_sum = 0.0;
+    saved_stats.rel_ret[0] = 0;
+    saved_stats.prec_sum[0] = 0.0;
+    rel_so_far = 0;
+    sum = 0.0;
+    judged_rel_so_far = 0;
+    nonrel_so_far = 0;
+    pool_unjudged_so_far = 0;
+    for (i = 0; i < num_ret; i++) {
+	rel = rel_list[i];
+	if (rel >= epi->relevance_level) {
+	    rel_so_far++;
+	    precis = (double) rel_so_far / (double) (i + 1);
+	    sum += precis;
+	    saved_stats.int_prec[rel_so_far] = precis;
+	    if (rel_so_far == 1)
+		saved_stats.first_rel = i + 1;
+	    saved_stats.bin_g_sum +=
+		(double) 1.0 / (double) log2 ((double) (3 + i - rel_so_far));
+	}
+	saved_stats.rel_ret[i+1] = rel_so_far;
+	saved_stats.prec_sum[i+1] = sum;
+
+	/* Judgement based measures (dependent on only judged docs; no
+	   assumption of non-relevance if not judged) */
+	if (rel == RELVALUE_NONPOOL)
+	    /* document not in pool. Skip */
+	    continue;
+	if (rel == RELVALUE_UNJUDGED) {
+	    /* document in pool but unjudged. */
+	    pool_unjudged_so_far++;
+	    continue;
+	}
+	if (rel >= 0 && rel < epi->relevance_level)
+	    nonrel_so_far++;
+	else {
+	    /* Judged Rel doc */
+	    judged_rel_so_far++;
+	    /* bpref: fraction of correct preferences.  Special case
+	       nonrel_so_far == 0 to avoid division by 0 */
+	    if (nonrel_so_far > 0) {
+		saved_stats.bpref_sum += 1.0 -
+		    (((double) MIN (nonrel_so_far, res_rels->num_rel)) /
+		     (double) MIN (num_nonrel, res_rels->num_rel));
+	    }
+	    else
+		saved_stats.bpref_sum += 1.0;
+	    /* inf_ap */
+	    if (0 == i)
+		saved_stats.infap_sum += 1.0;
+	    else {
+		double fi = (double) i;
+		saved_stats.infap_sum += 1.0 / (fi+1.0) +
+		    (fi / (fi+1.0)) *
+		    ((judged_rel_so_far-1+nonrel_so_far+pool_unjudged_so_far) /
+		     fi) *
+		    ((judged_rel_so_far-1 + INFAP_EPSILON) /
+		     (judged_rel_so_far-1 + nonrel_so_far + 2 * INFAP_EPSILON));
+	    }
+	}
+    }
+
+    /* Interpolated precision, Int_Prec (X) == MAX (Prec (Y)) for all
+       Y >= X.  Precision is highest at the relevant docs, so only they
+       (and the last rank) need be looked at, in reverse order */
+    precis = (double) res_rels->num_rel_ret / (double) num_ret;
+    for (r = rel_so_far; r > 0; r--) {
+	if (precis < saved_stats.int_prec[r])
+	    precis = saved_stats.int_prec[r];
+	saved_stats.int_prec[r] = precis;
+    }
+    saved_stats.int_prec[0] = precis;
+
+    frame->rank_stats = &saved_stats;
+    *rank_stats = saved_stats;
+    return (1);
+}
+
+int
+te_form_rank_stats_cleanup ()
+{
+    if (max_rel_ret > 0) {
+	Free (saved_stats.rel_ret);
+	max_rel_ret = 0;
+    }
+    if (max_prec_sum > 0) {
+	Free (saved_stats.prec_sum);
+	max_prec_sum = 0;
+    }
+    if (max_int_prec > 0) {
+	Free (saved_stats.int_prec);
+	max_int_prec = 0;
+    }
+    return (1);
+}
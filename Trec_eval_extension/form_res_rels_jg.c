@@ -33,25 +33,26 @@ static int comp_rank_judged (), comp_sim_docno (), comp_docno ();
 /* Definitions used for temporary and cached values */
 typedef struct {
     char *docno;
+    int docid;
     float sim;
     long rank;
     long rel;
 } DOCNO_INFO;
 
 /* Current cached query */
-static char *current_query = "no query";
-static long max_current_query = 0;
+static THREAD_LOCAL char *current_query = "no query";
+static THREAD_LOCAL long max_current_query = 0;
 
 /* Space reserved for cached returned values */
-static long *rel_levels;
-static long max_rel_levels = 0;
-static RES_RELS *jgs;
-static long num_jgs;
-static long max_num_jgs = 0;
-static long *ranked_rel_list;
-static long max_ranked_rel_list = 0;
-static DOCNO_INFO *docno_info;
-static long max_docno_info = 0;
+static THREAD_LOCAL long *rel_levels;
+static THREAD_LOCAL long max_rel_levels = 0;
+static THREAD_LOCAL RES_RELS *jgs;
+static THREAD_LOCAL long num_jgs;
+static THREAD_LOCAL long max_num_jgs = 0;
+static THREAD_LOCAL long *ranked_rel_list;
+static THREAD_LOCAL long max_ranked_rel_list = 0;
+static THREAD_LOCAL DOCNO_INFO *docno_info;
+static THREAD_LOCAL long max_docno_info = 0;
 
 int
 te_form_res_rels_jg (const EPI *epi, const REL_INFO *rel_info,
@@ -113,16 +114,16 @@ te_form_res_rels_jg (const EPI *epi, const REL_INFO *rel_info,
 
     for (i = 0; i < num_results; i++) {
 	docno_info[i].docno = text_results_info->text_results[i].docno;
+	docno_info[i].docid = text_results_info->text_results[i].docid;
 	docno_info[i].sim = text_results_info->text_results[i].sim;
     }
 
-    /* Sort results by sim, breaking ties lexicographically using docno */
-    qsort ((char *) docno_info,
-	   (int) num_results,
-	   sizeof (DOCNO_INFO),
-	   comp_sim_docno);
-
-    /* Only look at epi->max_num_docs_per_topic (not normally an issue) */
+    /* Sort results by sim, breaking ties lexicographically using docno.
+       Only look at epi->max_num_docs_per_topic (not normally an issue),
+       so only the top ones need be sorted */
+    te_sort_top (docno_info, num_results, sizeof (DOCNO_INFO),
+		 MIN (num_results, epi->max_num_docs_per_topic),
+		 comp_sim_docno);
     if (num_results > epi->max_num_docs_per_topic)
 	num_results = epi->max_num_docs_per_topic;
 
@@ -139,9 +140,9 @@ te_form_res_rels_jg (const EPI *epi, const REL_INFO *rel_info,
 
     /* Error checking for duplicates */
     for (i = 1; i < num_results; i++) {
-	if (0 == strcmp (docno_info[i].docno,
-			 docno_info[i-1].docno)) {
-	    fprintf (stderr, "trec_eval.form_res_qrels: duplicate docs %s",
+	if (docno_info[i].docid == docno_info[i-1].docid) {
+	    fprintf (stderr, "trec_eval.form_res_qrels: duplicate docs %.*s",
+		     (int) te_field_len (docno_info[i].docno),
 		     docno_info[i].docno);
 	    return (UNDEF);
 	}
@@ -177,13 +178,13 @@ te_form_res_rels_jg (const EPI *epi, const REL_INFO *rel_info,
 	    [trec_qrels->text_qrels_jg[jg].num_text_qrels];
 	for (i = 0; i < num_results; i++) {
 	    while (qrels_ptr < end_qrels &&
-		   strcmp (qrels_ptr->docno, docno_info[i].docno) < 0) {
+		   qrels_ptr->docid < docno_info[i].docid) {
 		if (qrels_ptr->rel >= 0)
 		    rel_level_ptr[qrels_ptr->rel]++;
 		qrels_ptr++;
 	    }
 	    if (qrels_ptr >= end_qrels ||
-		strcmp (qrels_ptr->docno, docno_info[i].docno) > 0) {
+		qrels_ptr->docid > docno_info[i].docid) {
 		/* Doc is non-judged */
 		docno_info[i].rel = RELVALUE_NONPOOL;
 	    }
@@ -298,7 +299,7 @@ DOCNO_INFO *ptr2;
         return (-1);
     if (ptr1->sim < ptr2->sim)
         return (1);
-    return (strcmp (ptr2->docno, ptr1->docno));
+    return (ptr2->docid - ptr1->docid);
 }
 
 static int 
@@ -306,7 +307,7 @@ comp_docno (ptr1, ptr2)
 DOCNO_INFO *ptr1;
 DOCNO_INFO *ptr2;
 {
-    return (strcmp (ptr1->docno, ptr2->docno));
+    return (ptr1->docid - ptr2->docid);
 }
 
 int 
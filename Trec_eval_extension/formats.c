@@ -24,13 +24,20 @@ int te_get_qrels_jg_cleanup ();
 int te_get_prefs_cleanup ();
 int te_get_qrels_prefs_cleanup ();
 int te_get_trec_results_cleanup ();
+int te_get_trec_results_bin (EPI *epi, char *bin_results_file,
+			     ALL_RESULTS *all_results);
+int te_get_trec_results_bin_cleanup ();
 
 
 // Added by Lucas Chaves Lima
-int te_get_qrels_cred (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info);
-int te_get_qrels_cred_cleanup ();
+int te_get_qrels_twoaspects (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info);
 int te_get_qrels_threeaspects (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info);
-int te_get_qrels_threeaspects_cleanup ();
+int te_get_qrels_multiaspect (EPI *epi, char *text_qrels_file,
+			      ALL_REL_INFO *all_rel_info);
+int te_get_qrels_multiaspect_cleanup ();
+int te_get_qrels_bin (EPI *epi, char *bin_qrels_file,
+		      ALL_REL_INFO *all_rel_info);
+int te_get_qrels_bin_cleanup ();
 
 
 REL_INFO_FILE_FORMAT te_rel_info_format[] = {
@@ -48,30 +55,44 @@ File may contain no NULL characters. \n\
      te_get_qrels, te_get_qrels_cleanup},
 
   {"qrels_twoaspects",
-      "This was added by Lucas 'qrels'\n\
-      Relevance for each docno to qid is determined from rel_info_file, which \n\
-      consists of text tuples of the form \n\
-         qid  iter  docno  rel \n\
-      giving TREC document numbers (docno, a string) and their relevance (rel,  \n\
-      a non-negative integer less than 128, or -1 (unjudged)) \n\
-      to query qid (a string).  iter string field is ignored.   \n\
-      Fields are separated by whitespace, string fields can contain no whitespace. \n\
-      File may contain no NULL characters. \n\
-      ",
-     te_get_qrels_cred, te_get_qrels_cred_cleanup},
+"Rel_info_file format: Non-standard 'qrels_twoaspects'\n\
+Relevance and credibility for each docno to qid are determined from \n\
+rel_info_file, which consists of text tuples of the form \n\
+   qid  iter  docno  rel  cred \n\
+giving TREC document numbers (docno, a string) and their relevance (rel) \n\
+and credibility (cred), each a non-negative integer or -1 (unjudged), \n\
+to query qid (a string).  iter string field is ignored.   \n\
+Read as 'qrels_multiaspect' with two aspects. \n\
+Fields are separated by whitespace, string fields can contain no whitespace. \n\
+File may contain no NULL characters. \n\
+",
+     te_get_qrels_twoaspects, te_get_qrels_multiaspect_cleanup},
 
-   {"qrels_threeaspects",
-      "This was added by Lucas 'qrels'\n\
-      Relevance for each docno to qid is determined from rel_info_file, which \n\
-      consists of text tuples of the form \n\
-         qid  iter  docno  rel \n\
-      giving TREC document numbers (docno, a string) and their relevance (rel,  \n\
-      a non-negative integer less than 128, or -1 (unjudged)) \n\
-      to query qid (a string).  iter string field is ignored.   \n\
-      Fields are separated by whitespace, string fields can contain no whitespace. \n\
-      File may contain no NULL characters. \n\
-      ",
-     te_get_qrels_threeaspects, te_get_qrels_threeaspects_cleanup},
+  {"qrels_threeaspects",
+"Rel_info_file format: Non-standard 'qrels_threeaspects'\n\
+As 'qrels_twoaspects', with text tuples of the form \n\
+   qid  iter  docno  rel  cred  third \n\
+giving the judgements of a third aspect as well. \n\
+Read as 'qrels_multiaspect' with three aspects. \n\
+",
+     te_get_qrels_threeaspects, te_get_qrels_multiaspect_cleanup},
+
+  {"qrels_multiaspect",
+"Rel_info_file format: Non-standard 'qrels_multiaspect'\n\
+Judgements of each docno to qid on K aspects (eg, relevance, \n\
+credibility, correctness) are determined from rel_info_file, which \n\
+consists of text tuples of the form \n\
+   qid  iter  docno  rel_1 ... rel_K \n\
+giving TREC document numbers (docno, a string) and their judgement on \n\
+each aspect (a non-negative integer less than 32768, or -1 (unjudged)) \n\
+to query qid (a string).  iter string field is ignored.  K is between \n\
+1 and 8, and the same on every line.  Measures of a single aspect (eg, \n\
+map, ndcg) evaluate aspect 1; the multiaspect measures (eg, cam_multi) \n\
+evaluate all K. \n\
+Fields are separated by whitespace, string fields can contain no whitespace. \n\
+File may contain no NULL characters. \n\
+",
+     te_get_qrels_multiaspect, te_get_qrels_multiaspect_cleanup},
 
     {"qrels_jg",
 "Rel_info_file format: Standard 'qrels'\n\
@@ -260,11 +281,25 @@ topic (even given identical retrieval on the added nonrel docs).  How\n\
 to handle this correctly for preference evaluation will be an\n\
 important future research problem.\n\
 ", 
- te_get_qrels_prefs, te_get_qrels_prefs_cleanup}
+ te_get_qrels_prefs, te_get_qrels_prefs_cleanup},
 
+  {"qrels_bin",
+"Rel_info_file format: Binary 'qrels_bin'\n\
+The judgements of a 'qrels', 'qrels_twoaspects', 'qrels_threeaspects' or \n\
+'qrels_multiaspect' file, in a binary form written by \n\
+     trec_eval -Q qrels_file.bin [-R rel_info_format] qrels_file \n\
+The file is mapped into memory and used as it is, without parsing. \n\
+It holds a versioned header, a table of qids, a table of the \n\
+distinct docnos, and for each query its judged docs in docno order, the \n\
+number judged at each rel_level, and its judgements, a column per aspect. \n\
+A file of one aspect is evaluated as 'qrels', one of more as \n\
+'qrels_multiaspect'.  Judgements must be between -32768 and 32767.  It can \n\
+only be read on machines of the same byte order as the one that wrote it. \n\
+",
+     te_get_qrels_bin, te_get_qrels_bin_cleanup},
 };
 
-int te_num_rel_info_format =
+long te_num_rel_info_format =
     sizeof (te_rel_info_format)/sizeof (te_rel_info_format[0]);
 
 RESULTS_FILE_FORMAT te_results_format[] = {
@@ -284,30 +319,66 @@ File may contain no NULL characters. \n\
 Lines may contain fields after the run_id; they are ignored. \n\
 ",
      te_get_trec_results, te_get_trec_results_cleanup},
+    {"trec_results_bin",
+"Results_file format: Binary 'trec_results_bin'\n\
+The results of a 'trec_results' file, in a binary form written by \n\
+     trec_eval -C results_file.bin results_file \n\
+The file is mapped into memory and used as it is, without parsing, so \n\
+evaluating it starts much faster than evaluating the text file (with \n\
+exactly the same output).  It holds a versioned header, a table of qids, \n\
+a table of the distinct docnos, and the (docno, sim) of each result, \n\
+query by query.  It can only be read on machines of the same byte order \n\
+as the one that wrote it. \n\
+",
+     te_get_trec_results_bin, te_get_trec_results_bin_cleanup},
 };
-int te_num_results_format =
+long te_num_results_format =
     sizeof (te_results_format)/sizeof (te_results_format[0]);
 
-int te_form_res_rels_cleanup (), te_form_res_rels_jg_cleanup (),
-    te_form_pref_counts_cleanup (), te_form_pref_counts_cleanup (), te_form_res_rels_cred_cleanup(), te_form_res_rels_threeaspects_cleanup();
+int te_form_frame_cleanup (), te_form_gains_cleanup (),
+    te_form_rank_stats_cleanup (),
+    te_form_res_rels_jg_cleanup (),
+    te_form_pref_counts_cleanup (), te_form_pref_counts_cleanup (), te_meas_nlre_cleanup (),
+    te_meas_nlre_multi_cleanup (),
+    te_form_res_rels_cleanup_twoaspects (),
+    te_form_res_rels_cleanup_threeaspects (),
+    te_form_res_three_cleanup ();
 
 FORM_INTER_PROCS te_form_inter_procs[] = {
     {"qrels", "trec_results",
-     "Process for evaluating qrels and trec_results",
-     /* te_form_res_rels, */
-     te_form_res_rels_cleanup},
+     "Process for evaluating qrels (and qrels_multiaspect) and trec_results",
+     /* te_form_frame, te_form_res_rels, */
+     te_form_frame_cleanup},
+    {"qrels", "trec_results",
+     "Gains of the nDCG measures",
+     /* te_form_gains, */
+     te_form_gains_cleanup},
+    {"qrels", "trec_results",
+     "Ranking statistics of the standard measures (map, P, bpref, ...)",
+     /* te_form_rank_stats, */
+     te_form_rank_stats_cleanup},
     
 
     /* ADDED BY LUCAS CHAVES LIMA */
     {"qrels_twoaspects", "trec_results",
-     "Process for evaluating qrels_twoaspects and trec_results",
-     /* te_form_res_rels, */
-     te_form_res_rels_cred_cleanup},
+     "Normalisation constants of nlre (by number of docs)",
+     te_meas_nlre_cleanup},
+    {"qrels_multiaspect", "trec_results",
+     "Normalisation constants of nlre_multi (by number of docs)",
+     te_meas_nlre_multi_cleanup},
+    {"qrels_twoaspects", "trec_results",
+     "Process for evaluating qrels_twoaspects and trec_results (nwcs)",
+     /* te_form_res_rels_twoaspects, */
+     te_form_res_rels_cleanup_twoaspects},
 
      {"qrels_threeaspects", "trec_results",
-     "Process for evaluating qrels_twoaspects and trec_results",
-     /* te_form_res_rels, */
-     te_get_qrels_threeaspects_cleanup},
+     "Process for evaluating qrels_threeaspects and trec_results (nwcs)",
+     /* te_form_res_rels_threeaspects, */
+     te_form_res_rels_cleanup_threeaspects},
+    {"qrels_threeaspects", "trec_results",
+     "Process for evaluating qrels_threeaspects and trec_results (nlre)",
+     /* te_form_res_three, */
+     te_form_res_three_cleanup},
 
     /* ADDED BY LUCAS CHAVES LIMA */
 
@@ -330,7 +401,7 @@ FORM_INTER_PROCS te_form_inter_procs[] = {
      te_form_pref_counts_cleanup},
 };
 
-int te_num_form_inter_procs =
+long te_num_form_inter_procs =
     sizeof (te_form_inter_procs)/sizeof (te_form_inter_procs[0]);
 
 
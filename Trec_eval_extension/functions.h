@@ -13,6 +13,85 @@ void * te_chk_and_malloc (void *ptr, long *current_bound,
 			  const long needed, const size_t size);
 void * te_chk_and_realloc (void *ptr, long *current_bound,
 			   const long needed, const int size);
+/* Getting input files into memory, and comparing fields within them */
+int te_map_file (const char *file_name, INPUT_BUF *input_buf);
+int te_unmap_file (INPUT_BUF *input_buf);
+long te_count_lines (const INPUT_BUF *input_buf);
+int te_field_cmp (const char *field1, const char *field2);
+long te_field_len (const char *field);
+long te_field_hash (const char *field);
+char *te_field_copy (const char *field, char **pool_ptr);
+/* Running independent tasks on multiple threads */
+int te_run_parallel (long num_tasks, void *(*proc) (void *), void *args,
+		     size_t arg_size);
+long te_num_threads (long requested);
+/* Reproducible streams of random numbers */
+void te_rng_seed (TE_RNG *rng, uint64_t seed, uint64_t stream);
+uint64_t te_rng_next (TE_RNG *rng);
+long te_rng_below (TE_RNG *rng, long n);
+/* Sorting input lines (first members char *qid, char *docno) */
+int te_sort_lines_qid_docno (void *lines, long num_lines, size_t line_size,
+			     long num_threads);
+void te_sort_top (void *base, long num_elems, size_t elem_size, long num_top,
+		  int (*compar) ());
+/* Finding rel_info of a qid */
+int te_qid_index_build (const ALL_REL_INFO *all_rel_info,
+			QID_INDEX *qid_index);
+long te_qid_index_find (const QID_INDEX *qid_index, const char *qid);
+int te_qid_index_cleanup (QID_INDEX *qid_index);
+/* Mapping docnos of all input files to dense docids, in docno order */
+int te_docid_register (void *array, long num, size_t elem_size,
+		       size_t docno_offset, size_t docid_offset);
+int te_docid_assign (long num_threads);
+int te_docid_assign_resident (long num_threads);
+int te_docid_assign_group (void *array, long num, size_t elem_size,
+			   size_t docno_offset, size_t docid_offset,
+			   long num_threads);
+long te_docid_mark ();
+int te_docid_release (long mark);
+long te_num_docids ();
+int te_docid_cleanup ();
+/* Evaluating a run with a list of measures.  See eval_run.c */
+long te_eval_run (EPI *epi, TREC_MEAS **measures, long num_measures,
+		  const ALL_REL_INFO *all_rel_info, const QID_INDEX *qid_index,
+		  const ALL_ZSCORES *all_zscores,
+		  const ALL_RESULTS *all_results, TREC_EVAL *accum_eval,
+		  TREC_EVAL *q_evals);
+int te_eval_query (EPI *epi, TREC_MEAS **measures, long num_measures,
+		   const ALL_REL_INFO *all_rel_info, long rel_index,
+		   const ALL_ZSCORES *all_zscores, const RESULTS *results,
+		   TREC_EVAL *q_eval, TREC_EVAL *accum_eval);
+int te_eval_summary (EPI *epi, TREC_MEAS **measures, long num_measures,
+		     const ALL_REL_INFO *all_rel_info, TREC_EVAL *accum_eval);
+int te_mark_measure (EPI *epi, TREC_MEAS **measures, long num_measures,
+		     char *optarg);
+int te_cleanup_form_procs ();
+/* Bootstrap confidence intervals of summary values.  See bootstrap.c */
+int te_bootstrap_ci (EPI *epi, TREC_MEAS **measures, long num_measures,
+		     const TREC_EVAL *accum_eval);
+int te_bootstrap_cleanup ();
+/* Paired significance tests of runs against a baseline.  See compare_runs.c */
+int te_compare_runs (const EPI *epi, const TREC_EVAL *init_eval,
+		     const RUN_VALUES *run_values, long num_runs,
+		     long num_permutations);
+/* Output of measure values, in the format of epi->output_format.
+   See output.c */
+int te_output_start (const EPI *epi, const TREC_EVAL *init_eval);
+int te_output_line (const EPI *epi, const OUT_LINE *line);
+int te_output_float (const EPI *epi, const char *name, const char *qid,
+		     double value);
+int te_output_long (const EPI *epi, const char *name, const char *qid,
+		    long value);
+int te_output_string (const EPI *epi, const char *name, const char *qid,
+		      long type, const char *string);
+int te_output_flush ();
+int te_output_cleanup ();
+/* Per query values of runs to a values_bin file.  See put_values_bin.c */
+int te_put_values_bin_start (const char *values_file,
+			     const ALL_REL_INFO *all_rel_info,
+			     const TREC_EVAL *init_eval, long num_runs);
+int te_put_values_bin_run (const RUN_VALUES *run_values);
+int te_put_values_bin_end ();
 /* Functions for dealing with zscores */
 int te_get_zscores (const EPI *epi, const char *zscores_file,
 		    ALL_ZSCORES *zscores);
@@ -9,6 +9,7 @@
 #include "sysfunc.h"
 #include "trec_eval.h"
 #include "trec_format.h"
+#include "functions.h"
 #include <ctype.h>
 
 
@@ -243,6 +244,14 @@ te_get_prefs (EPI *epi, char *text_prefs_file, ALL_REL_INFO *all_rel_info)
     all_rel_info->num_q_rels = num_qid;
     all_rel_info->rel_info = rel_info_pool;
 
+    /* docids are assigned once all input files have been read */
+    if (UNDEF == te_docid_register (text_prefs_pool,
+				    text_prefs_ptr - text_prefs_pool,
+				    sizeof (TEXT_PREFS),
+				    offsetof (TEXT_PREFS, docno),
+				    offsetof (TEXT_PREFS, docid)))
+	return (UNDEF);
+
     Free (lines);
     return (1);
 }
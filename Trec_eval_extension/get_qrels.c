@@ -10,6 +10,7 @@
 #include "sysfunc.h"
 #include "trec_eval.h"
 #include "trec_format.h"
+#include "functions.h"
 #include <ctype.h>
 #include <stdlib.h>
 
@@ -25,6 +26,9 @@ File may contain no NULL characters.
 
 All <docno,rel> pairs stored in per query arrays within all_rel_info.
 Each list of query judgments is sorted lexicographically by docno.
+The file is mapped into memory and never written; docnos are whitespace
+terminated fields within it (compare with te_field_cmp), qids are NULL
+terminated copies.
 */
 
 /* Declarations in trec_eval.h (generic q info) and trec_format.h
@@ -63,12 +67,12 @@ typedef struct {
 static int parse_qrels_line (char **start_ptr, char **qid_ptr,
 			     char **docno_ptr, char **rel_ptr);
 
-static int comp_lines_qid_docno ();
 
 
 /* static pools of memory, allocated here and never changed.  
    Declared static so one day I can write a cleanup procedure to free them */
-static char *trec_qrels_buf = NULL;
+static INPUT_BUF trec_qrels_buf = {NULL, 0, 0};
+static char *qid_pool = NULL;
 static TEXT_QRELS_INFO *text_info_pool = NULL;
 static TEXT_QRELS *text_qrels_pool = NULL;
 static REL_INFO *rel_info_pool = NULL;
@@ -76,52 +80,40 @@ static REL_INFO *rel_info_pool = NULL;
 int
 te_get_qrels (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info)
 {
-    int fd;
-    int size = 0;
     char *ptr;
+    char *end;
     char *current_qid;
+    char *qid_ptr;
     long i;
     LINES *lines;
     LINES *line_ptr;
     long num_lines;
     long num_qid;
+    long qid_size;
     /* current pointers into static pools above */
     REL_INFO *rel_info_ptr;
     TEXT_QRELS_INFO *text_info_ptr;
     TEXT_QRELS *text_qrels_ptr;
     
-    /* Read entire file into memory */
-    if (-1 == (fd = open (text_qrels_file, 0)) ||
-        0 >= (size = lseek (fd, 0L, 2)) ||
-        NULL == (trec_qrels_buf = malloc ((unsigned) size+2)) ||
-        -1 == lseek (fd, 0L, 0) ||
-        size != read (fd, trec_qrels_buf, size) ||
-	-1 == close (fd)) {
+    /* Map (or read) entire file into memory.  Lines are parsed in place;
+       docnos in text_qrels are fields within the buffer */
+    if (UNDEF == te_map_file (text_qrels_file, &trec_qrels_buf)) {
         fprintf (stderr,
 		 "trec_eval.get_qrels: Cannot read qrels file '%s'\n",
 		 text_qrels_file);
         return (UNDEF);
     }
-    /* Append ending newline if not present, Append NULL terminator */
-    if (trec_qrels_buf[size-1] != '\n') {
-	trec_qrels_buf[size] = '\n';
-	size++;
-    }
-    trec_qrels_buf[size] = '\0';
 
     /* Count number of lines in file */
-    num_lines = 0;
-    for (ptr = trec_qrels_buf; *ptr; ptr = index(ptr,'\n')+1)
-	num_lines++;
+    num_lines = te_count_lines (&trec_qrels_buf);
 
     /* Get all lines */
     if (NULL == (lines = Malloc (num_lines, LINES)))
 	return (UNDEF);
     line_ptr = lines;
-    // printf("line_ptr: %s", line_ptr);
-    ptr = trec_qrels_buf;
-    while (*ptr) {
-    // printf("This is the *ptr: %s -- \n", ptr);
+    ptr = trec_qrels_buf.buf;
+    end = trec_qrels_buf.buf + trec_qrels_buf.size;
+    while (ptr < end) {
 	if (UNDEF == parse_qrels_line (&ptr, &line_ptr->qid,
 				       &line_ptr->docno, &line_ptr->rel)) {
 	    fprintf (stderr, "trec_eval.get_qrels: Malformed line %ld\n",
@@ -133,36 +125,38 @@ te_get_qrels (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info)
     num_lines = line_ptr-lines;
 
     /* Sort all lines by qid, then docno */
-    qsort ((char *) lines,
-	   (int) num_lines,
-	   sizeof (LINES),
-	   comp_lines_qid_docno);
-   // for( n = 0 ; n < num_lines; n++) {   
-   //    printf("%s, %s, %s \n", lines[n].qid ,  lines[n].docno, lines[n].rel);
-   // }
-   // exit(0);
-    /* Go through lines and count number of qid */
+    if (UNDEF == te_sort_lines_qid_docno (lines, num_lines, sizeof (LINES),
+					  epi->num_threads))
+	return (UNDEF);
+
+    /* Go through lines and count number of qid, and space needed for
+       NULL terminated copies of them */
     num_qid = 1;
+    qid_size = te_field_len (lines[0].qid) + 1;
     for (i = 1; i < num_lines; i++) {
-	if (strcmp (lines[i-1].qid, lines[i].qid))
+	if (te_field_cmp (lines[i-1].qid, lines[i].qid)) {
 	    /* New query */
 	    num_qid++;
+	    qid_size += te_field_len (lines[i].qid) + 1;
+	}
     }
 
     /* Allocate space for queries */
     if (NULL == (rel_info_pool = Malloc (num_qid, REL_INFO)) ||
 	NULL == (text_info_pool = Malloc (num_qid, TEXT_QRELS_INFO)) ||
-	NULL == (text_qrels_pool = Malloc (num_lines, TEXT_QRELS)))
+	NULL == (text_qrels_pool = Malloc (num_lines, TEXT_QRELS)) ||
+	NULL == (qid_pool = Malloc (qid_size, char)))
 	return (UNDEF);
 
     rel_info_ptr = rel_info_pool;
     text_info_ptr = text_info_pool;
     text_qrels_ptr = text_qrels_pool;
+    qid_ptr = qid_pool;
     
     /* Go through lines and store all info */
     current_qid = "";
     for (i = 0; i < num_lines; i++) {
-	if (strcmp (current_qid, lines[i].qid)) {
+	if (te_field_cmp (current_qid, lines[i].qid)) {
 	    /* New query.  End old query and start new one */
 	    if (i != 0) {
 		text_info_ptr->num_text_qrels =
@@ -170,8 +164,10 @@ te_get_qrels (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info)
 		text_info_ptr++;
 		rel_info_ptr++;
 	    }
-	    current_qid = lines[i].qid;
+	    current_qid = te_field_copy (lines[i].qid, &qid_ptr);
 	    text_info_ptr->text_qrels = text_qrels_ptr;
+	    text_info_ptr->num_rel_levels = 0;
+	    text_info_ptr->rel_levels = NULL;
 	    *rel_info_ptr =
 		(REL_INFO) {current_qid, "qrels", text_info_ptr};
 	}
@@ -185,17 +181,20 @@ te_get_qrels (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info)
     all_rel_info->num_q_rels = num_qid;
     all_rel_info->rel_info = rel_info_pool;
 
+    /* docids are assigned once all input files have been read */
+    if (UNDEF == te_docid_register (text_qrels_pool,
+				    text_qrels_ptr - text_qrels_pool,
+				    sizeof (TEXT_QRELS),
+				    offsetof (TEXT_QRELS, docno),
+				    offsetof (TEXT_QRELS, docid)))
+	return (UNDEF);
+
     Free (lines);
     return (1);
 }
 
-static int comp_lines_qid_docno (LINES *ptr1, LINES *ptr2)
-{
-    int cmp = strcmp (ptr1->qid, ptr2->qid);
-    if (cmp) return (cmp);
-    return (strcmp (ptr1->docno, ptr2->docno));
-}
-
+/* Parse one line of buf starting at *start_ptr.  Nothing is written into
+   the buffer; field pointers returned are views within it. */
 static int
 parse_qrels_line (char **start_ptr, char **qid_ptr,
 		  char **docno_ptr, char **rel_ptr)
@@ -205,11 +204,8 @@ parse_qrels_line (char **start_ptr, char **qid_ptr,
     /* Get qid */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     *qid_ptr = ptr;
-    // printf("qid_ptr:%s",&qid_ptr);
-    // printf("HUehuehue");
     while (! isspace (*ptr)) ptr++;
-    if (*ptr == '\n')  return (UNDEF);
-    *ptr++ = '\0';
+    if (*ptr++ == '\n')  return (UNDEF);
     /* Get iter, ignore */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     while (! isspace (*ptr)) ptr++;
@@ -218,23 +214,16 @@ parse_qrels_line (char **start_ptr, char **qid_ptr,
     /* Get docno */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     *docno_ptr = ptr;
-    
-    // exit(0);
     while (! isspace (*ptr)) ptr++;
-    if (*ptr == '\n') return (UNDEF);
-    *ptr++ = '\0';
+    if (*ptr++ == '\n') return (UNDEF);
     /* Get relevance */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     if (*ptr == '\n') return (UNDEF);
     *rel_ptr = ptr;
     while (! isspace (*ptr)) ptr++;
-    if (*ptr != '\n') {
-	*ptr++ = '\0';
-	while (*ptr != '\n' && isspace (*ptr)) ptr++;
-	if (*ptr != '\n') return (UNDEF);
-    }
-    *ptr++ = '\0';
-    *start_ptr = ptr;
+    while (*ptr != '\n' && isspace (*ptr)) ptr++;
+    if (*ptr != '\n') return (UNDEF);
+    *start_ptr = ptr + 1;
     return (0);
 }
 
@@ -242,9 +231,11 @@ parse_qrels_line (char **start_ptr, char **qid_ptr,
 int 
 te_get_qrels_cleanup ()
 {
-    if (trec_qrels_buf != NULL) {
-	Free (trec_qrels_buf);
-	trec_qrels_buf = NULL;
+    if (UNDEF == te_unmap_file (&trec_qrels_buf))
+	return (UNDEF);
+    if (qid_pool != NULL) {
+	Free (qid_pool);
+	qid_pool = NULL;
     }
     if (text_info_pool != NULL) {
 	Free (text_info_pool);
@@ -0,0 +1,506 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+
+/* Read all relevance information from a 'qrels_bin' file, the binary form
+of a qrels (or qrels_twoaspects, qrels_threeaspects, qrels_multiaspect)
+file written by 'trec_eval -Q' (te_put_qrels_bin below).  The file is
+     BIN_HEADER
+     BIN_QUERY       queries[num_qid]           in qid order
+     int64_t         docnos[num_docnos]         offsets into strings
+     int32_t         qrels[num_qrels]           index into docnos of each
+						judged doc, each query's
+						contiguous, in docno order
+     int32_t         levels[num_levels]         see below
+     int16_t         rels[num_qrels * num_aspects]
+						the judgements of each
+						query, a column per aspect
+     char            strings[strings_size]      NULL terminated qids and
+						docnos
+     '\n'
+all in the byte order of the machine that wrote it (checked by the
+byte_order field).  Each distinct docno is stored once.  levels holds
+for each query the number of docs judged at each rel_level from 0 to
+num_rel_levels-1, a row per aspect, so that form_frame.c need not count
+them.
+The final newline lets te_map_file map the file in place.  Nothing is
+parsed, and queries need not be sorted: qids and docnos are strings
+within the mapped file, and the judgements of multi-aspect files are used
+where they are.  A file of one aspect is read as 'qrels', one of several
+as 'qrels_multiaspect'.
+*/
+
+#define BIN_MAGIC "TRECQRL"
+#define BIN_BYTE_ORDER 0x01020304
+#define BIN_VERSION 1
+
+typedef struct {
+    char magic[8];                  /* BIN_MAGIC */
+    int32_t byte_order;             /* BIN_BYTE_ORDER */
+    int32_t version;                /* BIN_VERSION */
+    int64_t num_qid;
+    int64_t num_qrels;
+    int64_t num_docnos;
+    int64_t num_aspects;
+    int64_t num_levels;
+    int64_t strings_size;
+} BIN_HEADER;
+
+typedef struct {
+    int64_t qid;                    /* Offset of qid in strings */
+    int64_t start;                  /* Index of first judged doc of query */
+    int64_t num_qrels;
+    int64_t levels;                 /* Index of first count in levels */
+    int64_t num_rel_levels;
+} BIN_QUERY;
+
+/* Judged docs of a query being written, in either format */
+typedef struct {
+    TEXT_QRELS_INFO *text_qrels_info;     /* If qrels, else NULL */
+    TEXT_QRELS_MULTI_INFO *multi_info;    /* If qrels_multiaspect, else NULL */
+    long num_qrels;
+    long num_aspects;
+    long num_rel_levels;                  /* Highest judgement + 1 (at
+					     least 1) */
+} QUERY_QRELS;
+
+static int check_string (int64_t offset, const BIN_HEADER *header);
+static int get_query_qrels (const REL_INFO *rel_info, QUERY_QRELS *qq);
+static long qrels_docid (const QUERY_QRELS *qq, long i);
+static char *qrels_docno (const QUERY_QRELS *qq, long i);
+static long qrels_rel (const QUERY_QRELS *qq, long a, long i);
+static void put_field (const char *field, FILE *fp);
+
+/* static pools of memory, allocated here and never changed. */
+static INPUT_BUF bin_qrels_buf = {NULL, 0, 0};
+static TEXT_QRELS_INFO *text_info_pool = NULL;
+static TEXT_QRELS *text_qrels_pool = NULL;
+static TEXT_QRELS_MULTI_INFO *multi_info_pool = NULL;
+static TEXT_QRELS_MULTI *multi_qrels_pool = NULL;
+static REL_INFO *rel_info_pool = NULL;
+
+int
+te_get_qrels_bin (EPI *epi, char *bin_qrels_file, ALL_REL_INFO *all_rel_info)
+{
+    BIN_HEADER *header;
+    BIN_QUERY *queries;
+    int64_t *docnos;
+    int32_t *qrels;
+    int32_t *levels;
+    int16_t *rels;
+    char *strings;
+    long size;
+    long q, i;
+
+    if (UNDEF == te_map_file (bin_qrels_file, &bin_qrels_buf)) {
+        fprintf (stderr,
+		 "trec_eval.get_qrels_bin: Cannot read qrels file '%s'\n",
+		 bin_qrels_file);
+        return (UNDEF);
+    }
+
+    /* Check header, and that the sizes it gives are those of the file */
+    header = (BIN_HEADER *) bin_qrels_buf.buf;
+    if (bin_qrels_buf.size < (long) sizeof (BIN_HEADER) ||
+	memcmp (header->magic, BIN_MAGIC, sizeof (header->magic)) ||
+	header->byte_order != BIN_BYTE_ORDER) {
+	fprintf (stderr, "trec_eval.get_qrels_bin: '%s' is not a qrels_bin file (or was written on a machine of different byte order)\n",
+		 bin_qrels_file);
+	return (UNDEF);
+    }
+    if (header->version != BIN_VERSION) {
+	fprintf (stderr, "trec_eval.get_qrels_bin: '%s' is version %d, not %d\n",
+		 bin_qrels_file, (int) header->version, BIN_VERSION);
+	return (UNDEF);
+    }
+    size = bin_qrels_buf.size;
+    if (header->num_qid < 0 || header->num_qid > size ||
+	header->num_qrels < 0 || header->num_qrels > size ||
+	header->num_docnos < 0 || header->num_docnos > size ||
+	header->num_aspects < 1 || header->num_aspects > MAX_QRELS_ASPECTS ||
+	header->num_levels < 0 || header->num_levels > size ||
+	header->strings_size <= 0 || header->strings_size > size ||
+	size != (long) sizeof (BIN_HEADER) +
+	header->num_qid * (long) sizeof (BIN_QUERY) +
+	header->num_docnos * (long) sizeof (int64_t) +
+	header->num_qrels * (long) sizeof (int32_t) +
+	header->num_levels * (long) sizeof (int32_t) +
+	header->num_qrels * header->num_aspects * (long) sizeof (int16_t) +
+	header->strings_size + 1) {
+	fprintf (stderr, "trec_eval.get_qrels_bin: '%s' is truncated or corrupt\n",
+		 bin_qrels_file);
+	return (UNDEF);
+    }
+    queries = (BIN_QUERY *) (header + 1);
+    docnos = (int64_t *) (queries + header->num_qid);
+    qrels = (int32_t *) (docnos + header->num_docnos);
+    levels = qrels + header->num_qrels;
+    rels = (int16_t *) (levels + header->num_levels);
+    strings = (char *) (rels + header->num_qrels * header->num_aspects);
+
+    /* All strings are within strings, and NULL terminated */
+    if (strings[header->strings_size - 1] != '\0')
+	goto corrupt;
+    for (i = 0; i < header->num_docnos; i++) {
+	if (UNDEF == check_string (docnos[i], header))
+	    goto corrupt;
+    }
+
+    /* Allocate space for queries */
+    if (NULL == (rel_info_pool = Malloc (header->num_qid + 1, REL_INFO)))
+	return (UNDEF);
+    if (header->num_aspects == 1) {
+	if (NULL == (text_info_pool = Malloc (header->num_qid + 1,
+					      TEXT_QRELS_INFO)) ||
+	    NULL == (text_qrels_pool = Malloc (header->num_qrels + 1,
+					       TEXT_QRELS)))
+	    return (UNDEF);
+    }
+    else {
+	if (NULL == (multi_info_pool = Malloc (header->num_qid + 1,
+					       TEXT_QRELS_MULTI_INFO)) ||
+	    NULL == (multi_qrels_pool = Malloc (header->num_qrels + 1,
+						TEXT_QRELS_MULTI)))
+	    return (UNDEF);
+    }
+
+    for (q = 0; q < header->num_qid; q++) {
+	if (UNDEF == check_string (queries[q].qid, header) ||
+	    queries[q].start < 0 || queries[q].num_qrels < 0 ||
+	    queries[q].num_qrels > header->num_qrels - queries[q].start ||
+	    queries[q].levels < 0 || queries[q].num_rel_levels < 1 ||
+	    queries[q].num_rel_levels > header->num_levels ||
+	    queries[q].num_rel_levels * header->num_aspects >
+	    header->num_levels - queries[q].levels)
+	    goto corrupt;
+	for (i = queries[q].start;
+	     i < queries[q].start + queries[q].num_qrels;
+	     i++) {
+	    if (qrels[i] < 0 || qrels[i] >= header->num_docnos)
+		goto corrupt;
+	}
+	/* Judgements must be counted in levels */
+	for (i = queries[q].start * header->num_aspects;
+	     i < (queries[q].start + queries[q].num_qrels) * header->num_aspects;
+	     i++) {
+	    if (rels[i] >= queries[q].num_rel_levels)
+		goto corrupt;
+	}
+	if (header->num_aspects == 1) {
+	    for (i = queries[q].start;
+		 i < queries[q].start + queries[q].num_qrels;
+		 i++) {
+		text_qrels_pool[i].docno = strings + docnos[qrels[i]];
+		text_qrels_pool[i].rel = rels[i];
+	    }
+	    text_info_pool[q] = (TEXT_QRELS_INFO)
+		{queries[q].num_qrels, queries[q].num_qrels,
+		 &text_qrels_pool[queries[q].start],
+		 queries[q].num_rel_levels,
+		 (int *) levels + queries[q].levels};
+	    rel_info_pool[q] = (REL_INFO) {strings + queries[q].qid, "qrels",
+					   &text_info_pool[q]};
+	}
+	else {
+	    for (i = queries[q].start;
+		 i < queries[q].start + queries[q].num_qrels;
+		 i++)
+		multi_qrels_pool[i].docno = strings + docnos[qrels[i]];
+	    multi_info_pool[q] = (TEXT_QRELS_MULTI_INFO)
+		{queries[q].num_qrels, header->num_aspects,
+		 &multi_qrels_pool[queries[q].start],
+		 (short *) rels + queries[q].start * header->num_aspects,
+		 queries[q].num_rel_levels,
+		 (int *) levels + queries[q].levels};
+	    rel_info_pool[q] = (REL_INFO) {strings + queries[q].qid,
+					   "qrels_multiaspect",
+					   &multi_info_pool[q]};
+	}
+    }
+
+    all_rel_info->num_q_rels = header->num_qid;
+    all_rel_info->max_num_q_rels = header->num_qid;
+    all_rel_info->rel_info = rel_info_pool;
+
+    /* docids are assigned once all input files have been read */
+    if (header->num_aspects == 1)
+	return (te_docid_register (text_qrels_pool, header->num_qrels,
+				   sizeof (TEXT_QRELS),
+				   offsetof (TEXT_QRELS, docno),
+				   offsetof (TEXT_QRELS, docid)));
+    return (te_docid_register (multi_qrels_pool, header->num_qrels,
+			       sizeof (TEXT_QRELS_MULTI),
+			       offsetof (TEXT_QRELS_MULTI, docno),
+			       offsetof (TEXT_QRELS_MULTI, docid)));
+
+ corrupt:
+    fprintf (stderr, "trec_eval.get_qrels_bin: '%s' is corrupt\n",
+	     bin_qrels_file);
+    return (UNDEF);
+}
+
+static int
+check_string (int64_t offset, const BIN_HEADER *header)
+{
+    if (offset < 0 || offset >= header->strings_size)
+	return (UNDEF);
+    return (1);
+}
+
+int
+te_get_qrels_bin_cleanup ()
+{
+    if (UNDEF == te_unmap_file (&bin_qrels_buf))
+	return (UNDEF);
+    if (text_info_pool != NULL) {
+	Free (text_info_pool);
+	text_info_pool = NULL;
+    }
+    if (text_qrels_pool != NULL) {
+	Free (text_qrels_pool);
+	text_qrels_pool = NULL;
+    }
+    if (multi_info_pool != NULL) {
+	Free (multi_info_pool);
+	multi_info_pool = NULL;
+    }
+    if (multi_qrels_pool != NULL) {
+	Free (multi_qrels_pool);
+	multi_qrels_pool = NULL;
+    }
+    if (rel_info_pool != NULL) {
+	Free (rel_info_pool);
+	rel_info_pool = NULL;
+    }
+    return (1);
+}
+
+/* Write the judgements of all_rel_info (format qrels or
+   qrels_multiaspect, with docids assigned) to bin_qrels_file ("-" is
+   standard output) in the qrels_bin format above.
+   UNDEF returned if error, 1 otherwise. */
+int
+te_put_qrels_bin (const ALL_REL_INFO *all_rel_info, const char *bin_qrels_file)
+{
+    BIN_HEADER header;
+    BIN_QUERY query;
+    QUERY_QRELS qq;
+    char **docid_docno;           /* docno of each docid judged */
+    int32_t *docid_index;         /* its index in docnos of the file */
+    int32_t *counts = NULL;       /* levels of one aspect of a query */
+    long max_counts = 0;
+    long num_docids = te_num_docids ();
+    int64_t offset;
+    int32_t index;
+    int16_t rel;
+    long q, i, a;
+    FILE *fp;
+
+    /* Intern docnos: each docid judged gets the next index, so docnos
+       are stored once each, in docno order */
+    if (NULL == (docid_docno = Malloc (num_docids + 1, char *)) ||
+	NULL == (docid_index = Malloc (num_docids + 1, int32_t)))
+	return (UNDEF);
+    for (i = 0; i < num_docids; i++)
+	docid_docno[i] = NULL;
+    (void) memset (&header, 0, sizeof (header));
+    (void) memcpy (header.magic, BIN_MAGIC, sizeof (header.magic));
+    header.byte_order = BIN_BYTE_ORDER;
+    header.version = BIN_VERSION;
+    header.num_qid = all_rel_info->num_q_rels;
+    header.num_aspects = 1;
+    header.strings_size = 1;
+    for (q = 0; q < all_rel_info->num_q_rels; q++) {
+	if (UNDEF == get_query_qrels (&all_rel_info->rel_info[q], &qq))
+	    return (UNDEF);
+	if (q == 0)
+	    header.num_aspects = qq.num_aspects;
+	else if (qq.num_aspects != header.num_aspects) {
+	    fprintf (stderr, "trec_eval.put_qrels_bin: Queries judged on different numbers of aspects\n");
+	    return (UNDEF);
+	}
+	for (a = 0; a < qq.num_aspects; a++) {
+	    for (i = 0; i < qq.num_qrels; i++) {
+		if (qrels_rel (&qq, a, i) < -32768 ||
+		    qrels_rel (&qq, a, i) > 32767) {
+		    fprintf (stderr, "trec_eval.put_qrels_bin: Judgement %ld of query %s out of range\n",
+			     qrels_rel (&qq, a, i),
+			     all_rel_info->rel_info[q].qid);
+		    return (UNDEF);
+		}
+	    }
+	}
+	for (i = 0; i < qq.num_qrels; i++)
+	    docid_docno[qrels_docid (&qq, i)] = qrels_docno (&qq, i);
+	header.num_qrels += qq.num_qrels;
+	header.num_levels += qq.num_rel_levels * qq.num_aspects;
+	header.strings_size += te_field_len (all_rel_info->rel_info[q].qid) + 1;
+    }
+    for (i = 0; i < num_docids; i++) {
+	if (docid_docno[i] != NULL) {
+	    docid_index[i] = header.num_docnos++;
+	    header.strings_size += te_field_len (docid_docno[i]) + 1;
+	}
+    }
+
+    if (0 == strcmp (bin_qrels_file, "-"))
+	fp = stdout;
+    else if (NULL == (fp = fopen (bin_qrels_file, "w"))) {
+	fprintf (stderr, "trec_eval.put_qrels_bin: Cannot create '%s'\n",
+		 bin_qrels_file);
+	Free (docid_docno);
+	Free (docid_index);
+	return (UNDEF);
+    }
+
+    (void) fwrite (&header, sizeof (header), 1, fp);
+    /* Queries.  Their strings follow an empty string */
+    offset = 1;
+    query.start = 0;
+    query.levels = 0;
+    for (q = 0; q < all_rel_info->num_q_rels; q++) {
+	(void) get_query_qrels (&all_rel_info->rel_info[q], &qq);
+	query.qid = offset;
+	query.num_qrels = qq.num_qrels;
+	query.num_rel_levels = qq.num_rel_levels;
+	(void) fwrite (&query, sizeof (query), 1, fp);
+	query.start += query.num_qrels;
+	query.levels += query.num_rel_levels * qq.num_aspects;
+	offset += te_field_len (all_rel_info->rel_info[q].qid) + 1;
+    }
+    /* Docnos.  Their strings follow the qids */
+    for (i = 0; i < num_docids; i++) {
+	if (docid_docno[i] != NULL) {
+	    (void) fwrite (&offset, sizeof (offset), 1, fp);
+	    offset += te_field_len (docid_docno[i]) + 1;
+	}
+    }
+    /* Judged docs */
+    for (q = 0; q < all_rel_info->num_q_rels; q++) {
+	(void) get_query_qrels (&all_rel_info->rel_info[q], &qq);
+	for (i = 0; i < qq.num_qrels; i++) {
+	    index = docid_index[qrels_docid (&qq, i)];
+	    (void) fwrite (&index, sizeof (index), 1, fp);
+	}
+    }
+    /* Counts of docs at each rel_level, as form_frame.c would count */
+    for (q = 0; q < all_rel_info->num_q_rels; q++) {
+	(void) get_query_qrels (&all_rel_info->rel_info[q], &qq);
+	if (NULL == (counts = te_chk_and_malloc (counts, &max_counts,
+						 qq.num_rel_levels,
+						 sizeof (int32_t))))
+	    return (UNDEF);
+	for (a = 0; a < qq.num_aspects; a++) {
+	    (void) memset (counts, 0, qq.num_rel_levels * sizeof (int32_t));
+	    for (i = 0; i < qq.num_qrels; i++) {
+		if (qrels_rel (&qq, a, i) >= 0)
+		    counts[qrels_rel (&qq, a, i)]++;
+	    }
+	    (void) fwrite (counts, sizeof (int32_t), qq.num_rel_levels, fp);
+	}
+    }
+    /* Judgements, a column per aspect */
+    for (q = 0; q < all_rel_info->num_q_rels; q++) {
+	(void) get_query_qrels (&all_rel_info->rel_info[q], &qq);
+	for (a = 0; a < qq.num_aspects; a++) {
+	    for (i = 0; i < qq.num_qrels; i++) {
+		rel = qrels_rel (&qq, a, i);
+		(void) fwrite (&rel, sizeof (rel), 1, fp);
+	    }
+	}
+    }
+    /* Strings, then final newline */
+    (void) putc ('\0', fp);
+    for (q = 0; q < all_rel_info->num_q_rels; q++)
+	put_field (all_rel_info->rel_info[q].qid, fp);
+    for (i = 0; i < num_docids; i++) {
+	if (docid_docno[i] != NULL)
+	    put_field (docid_docno[i], fp);
+    }
+    (void) putc ('\n', fp);
+
+    if (counts != NULL)
+	Free (counts);
+    Free (docid_docno);
+    Free (docid_index);
+    if (ferror (fp) || (fp == stdout ? fflush (fp) : fclose (fp))) {
+	fprintf (stderr, "trec_eval.put_qrels_bin: Cannot write '%s'\n",
+		 bin_qrels_file);
+	return (UNDEF);
+    }
+    return (1);
+}
+
+/* Set qq to the judged docs of rel_info, and count its rel_levels */
+static int
+get_query_qrels (const REL_INFO *rel_info, QUERY_QRELS *qq)
+{
+    long i, a;
+
+    if (0 == strcmp ("qrels", rel_info->rel_format)) {
+	qq->text_qrels_info = (TEXT_QRELS_INFO *) rel_info->q_rel_info;
+	qq->multi_info = NULL;
+	qq->num_qrels = qq->text_qrels_info->num_text_qrels;
+	qq->num_aspects = 1;
+    }
+    else if (0 == strcmp ("qrels_multiaspect", rel_info->rel_format)) {
+	qq->text_qrels_info = NULL;
+	qq->multi_info = (TEXT_QRELS_MULTI_INFO *) rel_info->q_rel_info;
+	qq->num_qrels = qq->multi_info->num_text_qrels;
+	qq->num_aspects = qq->multi_info->num_aspects;
+    }
+    else {
+	fprintf (stderr, "trec_eval.put_qrels_bin: rel_info format not qrels or qrels_multiaspect\n");
+	return (UNDEF);
+    }
+    qq->num_rel_levels = 1;
+    for (a = 0; a < qq->num_aspects; a++) {
+	for (i = 0; i < qq->num_qrels; i++) {
+	    if (qrels_rel (qq, a, i) >= qq->num_rel_levels)
+		qq->num_rel_levels = qrels_rel (qq, a, i) + 1;
+	}
+    }
+    return (1);
+}
+
+static long
+qrels_docid (const QUERY_QRELS *qq, long i)
+{
+    if (qq->text_qrels_info)
+	return (qq->text_qrels_info->text_qrels[i].docid);
+    return (qq->multi_info->text_qrels[i].docid);
+}
+
+static char *
+qrels_docno (const QUERY_QRELS *qq, long i)
+{
+    if (qq->text_qrels_info)
+	return (qq->text_qrels_info->text_qrels[i].docno);
+    return (qq->multi_info->text_qrels[i].docno);
+}
+
+/* Judgement of aspect a of judged doc i */
+static long
+qrels_rel (const QUERY_QRELS *qq, long a, long i)
+{
+    if (qq->text_qrels_info)
+	return (qq->text_qrels_info->text_qrels[i].rel);
+    return (qq->multi_info->rels[a * qq->num_qrels + i]);
+}
+
+/* Write field (see te_field_cmp) to fp, NULL terminated */
+static void
+put_field (const char *field, FILE *fp)
+{
+    (void) fwrite (field, 1, te_field_len (field), fp);
+    (void) putc ('\0', fp);
+}
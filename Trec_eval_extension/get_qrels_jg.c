@@ -9,6 +9,7 @@
 #include "sysfunc.h"
 #include "trec_eval.h"
 #include "trec_format.h"
+#include "functions.h"
 #include <ctype.h>
 
 
@@ -218,6 +219,14 @@ te_get_qrels_jg (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info)
 
     all_rel_info->num_q_rels = num_qid;
     all_rel_info->rel_info = rel_info_pool;
+    /* docids are assigned once all input files have been read */
+    if (UNDEF == te_docid_register (text_qrels_pool,
+				    text_qrels_ptr - text_qrels_pool,
+				    sizeof (TEXT_QRELS),
+				    offsetof (TEXT_QRELS, docno),
+				    offsetof (TEXT_QRELS, docid)))
+	return (UNDEF);
+
     Free (lines);
     return (1);
 }
@@ -0,0 +1,319 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+
+/* Read all relevance information from a multi-aspect text_qrels_file.
+Relevance for each docno to qid is determined from text_qrels_file, which
+consists of text tuples of the form
+   qid  iter  docno  rel_1 ... rel_K
+giving TREC document numbers (docno, a string) and their judgements on
+each of K aspects (eg, relevance and credibility; each an integer between
+-32768 and 32767) to query qid (a string).  K, between 1 and
+MAX_QRELS_ASPECTS, must be the same on every line.  Iter is ignored.
+Fields are separated by whitespace, string fields can contain no whitespace.
+File may contain no NULL characters.
+
+qrels_twoaspects and qrels_threeaspects files are read here too, as
+multi-aspect files with K fixed at 2 and 3.
+
+All docnos are stored in per query arrays within all_rel_info, sorted
+lexicographically by docno.  The judgements of a query are stored as a
+structure of arrays, one column of shorts per aspect (see
+TEXT_QRELS_MULTI_INFO in trec_format.h), so that a measure going through
+one aspect only touches that aspect's judgements.
+The file is mapped into memory and never written; docnos are whitespace
+terminated fields within it (compare with te_field_cmp), qids are NULL
+terminated copies.
+*/
+
+/* Temp structure for values in input line */
+typedef struct {
+    char *qid;
+    char *docno;
+    char *rels;                 /* First judgement field */
+} LINES;
+
+static int get_qrels_multi (EPI *epi, char *text_qrels_file,
+			    ALL_REL_INFO *all_rel_info, long num_aspects);
+static int parse_qrels_line (char **start_ptr, char **qid_ptr,
+			     char **docno_ptr, char **rels_ptr,
+			     long *num_aspects_ptr);
+
+
+/* static pools of memory, allocated here and never changed.
+   Declared static so one day I can write a cleanup procedure to free them */
+static INPUT_BUF trec_qrels_buf = {NULL, 0, 0};
+static char *qid_pool = NULL;
+static TEXT_QRELS_MULTI_INFO *text_info_pool = NULL;
+static TEXT_QRELS_MULTI *text_qrels_pool = NULL;
+static short *rels_pool = NULL;
+static REL_INFO *rel_info_pool = NULL;
+
+int
+te_get_qrels_multiaspect (EPI *epi, char *text_qrels_file,
+			  ALL_REL_INFO *all_rel_info)
+{
+    return (get_qrels_multi (epi, text_qrels_file, all_rel_info, 0));
+}
+
+int
+te_get_qrels_twoaspects (EPI *epi, char *text_qrels_file,
+			 ALL_REL_INFO *all_rel_info)
+{
+    return (get_qrels_multi (epi, text_qrels_file, all_rel_info, 2));
+}
+
+int
+te_get_qrels_threeaspects (EPI *epi, char *text_qrels_file,
+			   ALL_REL_INFO *all_rel_info)
+{
+    return (get_qrels_multi (epi, text_qrels_file, all_rel_info, 3));
+}
+
+/* Read text_qrels_file with num_aspects judgements on each line (0 if
+   given by the first line) */
+static int
+get_qrels_multi (EPI *epi, char *text_qrels_file, ALL_REL_INFO *all_rel_info,
+		 long num_aspects)
+{
+    char *ptr;
+    char *end;
+    char *current_qid;
+    char *qid_ptr;
+    long i, j, a;
+    long line_aspects;
+    long rel;
+    LINES *lines;
+    LINES *line_ptr;
+    long num_lines;
+    long num_qid;
+    long qid_size;
+    /* current pointers into static pools above */
+    REL_INFO *rel_info_ptr;
+    TEXT_QRELS_MULTI_INFO *text_info_ptr;
+    TEXT_QRELS_MULTI *text_qrels_ptr;
+    short *rels_ptr;
+
+    /* Map (or read) entire file into memory.  Lines are parsed in place;
+       docnos in text_qrels are fields within the buffer */
+    if (UNDEF == te_map_file (text_qrels_file, &trec_qrels_buf)) {
+        fprintf (stderr,
+		 "trec_eval.get_qrels_multiaspect: Cannot read qrels file '%s'\n",
+		 text_qrels_file);
+        return (UNDEF);
+    }
+
+    /* Count number of lines in file */
+    num_lines = te_count_lines (&trec_qrels_buf);
+
+    /* Get all lines, checking each has num_aspects judgements */
+    if (NULL == (lines = Malloc (num_lines, LINES)))
+	return (UNDEF);
+    line_ptr = lines;
+    ptr = trec_qrels_buf.buf;
+    end = trec_qrels_buf.buf + trec_qrels_buf.size;
+    while (ptr < end) {
+	if (UNDEF == parse_qrels_line (&ptr, &line_ptr->qid,
+				       &line_ptr->docno, &line_ptr->rels,
+				       &line_aspects)) {
+	    fprintf (stderr,
+		     "trec_eval.get_qrels_multiaspect: Malformed line %ld\n",
+		     (long) (line_ptr - lines + 1));
+	    return (UNDEF);
+	}
+	if (line_aspects > MAX_QRELS_ASPECTS) {
+	    fprintf (stderr,
+		     "trec_eval.get_qrels_multiaspect: Line %ld has more than %d judgements\n",
+		     (long) (line_ptr - lines + 1), MAX_QRELS_ASPECTS);
+	    return (UNDEF);
+	}
+	if (num_aspects == 0)
+	    num_aspects = line_aspects;
+	if (line_aspects != num_aspects) {
+	    fprintf (stderr,
+		     "trec_eval.get_qrels_multiaspect: Line %ld has %ld judgements, not %ld\n",
+		     (long) (line_ptr - lines + 1), line_aspects,
+		     num_aspects);
+	    return (UNDEF);
+	}
+	line_ptr++;
+    }
+    num_lines = line_ptr-lines;
+
+    /* Sort all lines by qid, then docno */
+    if (UNDEF == te_sort_lines_qid_docno (lines, num_lines, sizeof (LINES),
+					  epi->num_threads))
+	return (UNDEF);
+
+    /* Go through lines and count number of qid, and space needed for
+       NULL terminated copies of them */
+    num_qid = 1;
+    qid_size = te_field_len (lines[0].qid) + 1;
+    for (i = 1; i < num_lines; i++) {
+	if (te_field_cmp (lines[i-1].qid, lines[i].qid)) {
+	    /* New query */
+	    num_qid++;
+	    qid_size += te_field_len (lines[i].qid) + 1;
+	}
+    }
+
+    /* Allocate space for queries */
+    if (NULL == (rel_info_pool = Malloc (num_qid, REL_INFO)) ||
+	NULL == (text_info_pool = Malloc (num_qid, TEXT_QRELS_MULTI_INFO)) ||
+	NULL == (text_qrels_pool = Malloc (num_lines, TEXT_QRELS_MULTI)) ||
+	NULL == (rels_pool = Malloc (num_lines * num_aspects, short)) ||
+	NULL == (qid_pool = Malloc (qid_size, char)))
+	return (UNDEF);
+
+    rel_info_ptr = rel_info_pool;
+    text_info_ptr = text_info_pool;
+    text_qrels_ptr = text_qrels_pool;
+    qid_ptr = qid_pool;
+
+    /* Go through lines and store all docnos */
+    current_qid = "";
+    for (i = 0; i < num_lines; i++) {
+	if (te_field_cmp (current_qid, lines[i].qid)) {
+	    /* New query.  End old query and start new one */
+	    if (i != 0) {
+		text_info_ptr->num_text_qrels =
+		    text_qrels_ptr - text_info_ptr->text_qrels;
+		text_info_ptr++;
+		rel_info_ptr++;
+	    }
+	    current_qid = te_field_copy (lines[i].qid, &qid_ptr);
+	    text_info_ptr->num_aspects = num_aspects;
+	    text_info_ptr->text_qrels = text_qrels_ptr;
+	    text_info_ptr->rels = rels_pool + i * num_aspects;
+	    text_info_ptr->num_rel_levels = 0;
+	    text_info_ptr->rel_levels = NULL;
+	    *rel_info_ptr =
+		(REL_INFO) {current_qid, "qrels_multiaspect", text_info_ptr};
+	}
+	text_qrels_ptr->docno = lines[i].docno;
+	text_qrels_ptr++;
+    }
+    /* End last qid */
+    text_info_ptr->num_text_qrels = text_qrels_ptr - text_info_ptr->text_qrels;
+
+    /* Store the judgements of each query, an aspect at a time */
+    for (text_info_ptr = text_info_pool;
+	 text_info_ptr < text_info_pool + num_qid;
+	 text_info_ptr++) {
+	line_ptr = lines + (text_info_ptr->text_qrels - text_qrels_pool);
+	for (j = 0; j < text_info_ptr->num_text_qrels; j++) {
+	    ptr = line_ptr[j].rels;
+	    rels_ptr = text_info_ptr->rels + j;
+	    for (a = 0; a < num_aspects; a++) {
+		rel = strtol (ptr, &ptr, 10);
+		if (rel < -32768 || rel > 32767) {
+		    fprintf (stderr,
+			     "trec_eval.get_qrels_multiaspect: Judgement %ld of docno %.*s out of range\n",
+			     rel, (int) te_field_len (line_ptr[j].docno),
+			     line_ptr[j].docno);
+		    return (UNDEF);
+		}
+		*rels_ptr = rel;
+		rels_ptr += text_info_ptr->num_text_qrels;
+	    }
+	}
+    }
+
+    all_rel_info->num_q_rels = num_qid;
+    all_rel_info->rel_info = rel_info_pool;
+
+    /* docids are assigned once all input files have been read */
+    if (UNDEF == te_docid_register (text_qrels_pool,
+				    text_qrels_ptr - text_qrels_pool,
+				    sizeof (TEXT_QRELS_MULTI),
+				    offsetof (TEXT_QRELS_MULTI, docno),
+				    offsetof (TEXT_QRELS_MULTI, docid)))
+	return (UNDEF);
+
+    Free (lines);
+    return (1);
+}
+
+/* Parse one line of buf starting at *start_ptr, returning the first of
+   its judgement fields in *rels_ptr and their number in
+   *num_aspects_ptr.  Nothing is written into the buffer; field pointers
+   returned are views within it. */
+static int
+parse_qrels_line (char **start_ptr, char **qid_ptr, char **docno_ptr,
+		  char **rels_ptr, long *num_aspects_ptr)
+{
+    char *ptr = *start_ptr;
+
+    /* Get qid */
+    while (*ptr != '\n' && isspace (*ptr)) ptr++;
+    *qid_ptr = ptr;
+    while (! isspace (*ptr)) ptr++;
+    if (*ptr++ == '\n')  return (UNDEF);
+    /* Get iter, ignore */
+    while (*ptr != '\n' && isspace (*ptr)) ptr++;
+    while (! isspace (*ptr)) ptr++;
+    if (*ptr == '\n') return (UNDEF);
+    ptr++;
+    /* Get docno */
+    while (*ptr != '\n' && isspace (*ptr)) ptr++;
+    *docno_ptr = ptr;
+    while (! isspace (*ptr)) ptr++;
+    if (*ptr++ == '\n') return (UNDEF);
+    /* Get judgements, each an integer */
+    while (*ptr != '\n' && isspace (*ptr)) ptr++;
+    if (*ptr == '\n') return (UNDEF);
+    *rels_ptr = ptr;
+    *num_aspects_ptr = 0;
+    while (*ptr != '\n') {
+	if (*ptr == '-' || *ptr == '+') ptr++;
+	if (! isdigit (*ptr)) return (UNDEF);
+	while (isdigit (*ptr)) ptr++;
+	if (! isspace (*ptr)) return (UNDEF);
+	(*num_aspects_ptr)++;
+	while (*ptr != '\n' && isspace (*ptr)) ptr++;
+    }
+    *start_ptr = ptr + 1;
+    return (0);
+}
+
+
+int
+te_get_qrels_multiaspect_cleanup ()
+{
+    if (UNDEF == te_unmap_file (&trec_qrels_buf))
+	return (UNDEF);
+    if (qid_pool != NULL) {
+	Free (qid_pool);
+	qid_pool = NULL;
+    }
+    if (text_info_pool != NULL) {
+	Free (text_info_pool);
+	text_info_pool = NULL;
+    }
+    if (text_qrels_pool != NULL) {
+	Free (text_qrels_pool);
+	text_qrels_pool = NULL;
+    }
+    if (rels_pool != NULL) {
+	Free (rels_pool);
+	rels_pool = NULL;
+    }
+    if (rel_info_pool != NULL) {
+	Free (rel_info_pool);
+	rel_info_pool = NULL;
+    }
+    return (1);
+}
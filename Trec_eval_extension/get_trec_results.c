@@ -9,6 +9,7 @@
 #include "sysfunc.h"
 #include "trec_eval.h"
 #include "trec_format.h"
+#include "functions.h"
 #include <ctype.h>
 
 /* Read all retrieved results information from trec_results_file.
@@ -20,31 +21,56 @@ giving TREC document numbers (a string) retrieved by query qid
 with the exception that the run_id field of the last line is kept and
 output.  In particular, note that the rank field is ignored here;
 internally ranks will be assigned by sorting by the sim field with ties 
-broken determinstically (using docno).
+broken determinstically (using docno).  The position of each line among
+the lines of its query is kept, though: if a query's lines are already in
+that order the sort is skipped (see form_frame.c).
 Sim is assumed to be higher for the docs to be retrieved first.
 File may contain no NULL characters.
 Any field following run_id is ignored.
 The runid is stored, but only from the last content line of the file (no
 check is made that it is consistent throughout).
+The file is mapped into memory and never written; docnos are whitespace
+terminated fields within it (compare with te_field_cmp), qids and the runid
+are NULL terminated copies.
 */
 
 /* Temp structure for values in input line */
 typedef struct {
     char *qid;
     char *docno;
-    char *sim;
+    float sim;
+    int line_num;               /* Index of line among all lines of file */
 } LINES;
 
+/* Input files at least this big are split into chunks which are counted
+   and parsed in parallel (if more than one thread is allowed, -j) */
+#define MIN_CHUNK_SIZE (1 << 20)
+
+/* One chunk of the input buffer, parsed by a single thread into its own
+   segment of lines */
+typedef struct {
+    char *start;                  /* First char of chunk (start of a line) */
+    char *end;                    /* One past final '\n' of chunk */
+    LINES *lines;                 /* Segment of lines for this chunk */
+    long num_lines;               /* Newlines in chunk, then lines parsed */
+    long error_line;              /* -1, or index in segment of bad line */
+    char *run_id_ptr;             /* run_id of last line parsed */
+} CHUNK;
+
+static void *count_chunk (void *arg);
+static void *parse_chunk (void *arg);
+
 static int parse_results_line (char **start_ptr, char **qid_ptr,
 			       char **docno_ptr, char **sim_ptr,
 			       char **run_id_ptr);
+static int read_stream_more ();
 
-static int comp_lines_qid_docno ();
 
 
 /* static pools of memory, allocated here and never changed.  
    Declared static so one day I can write a cleanup procedure to free them */
-static char *trec_results_buf = NULL;
+static INPUT_BUF trec_results_buf = {NULL, 0, 0};
+static char *qid_pool = NULL;
 static TEXT_RESULTS_INFO *text_info_pool = NULL;
 static TEXT_RESULTS *text_results_pool = NULL;
 static RESULTS *q_results_pool = NULL;
@@ -53,132 +79,513 @@ int
 te_get_trec_results (EPI *epi, char *text_results_file,
 		     ALL_RESULTS *all_results)
 {
-    int fd;
-    int size = 0;
     char *ptr;
+    char *end;
     char *current_qid;
+    char *qid_ptr;
     long i;
     LINES *lines;
     LINES *line_ptr;
     long num_lines;
     long num_qid;
+    long qid_size;
     char *run_id_ptr = NULL;
+    char *run_id;
+    CHUNK *chunks;
+    long num_chunks;
     /* current pointers into static pools above */
     RESULTS *q_results_ptr;
     TEXT_RESULTS_INFO *text_info_ptr;
     TEXT_RESULTS *text_results_ptr;
     
-    /* Read entire file into memory */
-    if (-1 == (fd = open (text_results_file, 0)) ||
-        0 >= (size = lseek (fd, 0L, 2)) ||
-        NULL == (trec_results_buf = malloc ((unsigned) size+2)) ||
-        -1 == lseek (fd, 0L, 0) ||
-        size != read (fd, trec_results_buf, size) ||
-	-1 == close (fd)) {
+    /* Map (or read) entire file into memory.  Lines are parsed in place;
+       docnos in text_results are fields within the buffer */
+    if (UNDEF == te_map_file (text_results_file, &trec_results_buf)) {
         fprintf (stderr,
 		 "trec_eval.get_results: Cannot read results file '%s'\n",
 		 text_results_file);
         return (UNDEF);
     }
 
-    /* Append ending newline if not present, Append NULL terminator */
-    if (trec_results_buf[size-1] != '\n') {
-	trec_results_buf[size] = '\n';
-	size++;
+    /* Split buffer at line boundaries into (roughly) equal chunks */
+    num_chunks = te_num_threads (epi->num_threads);
+    if (num_chunks > trec_results_buf.size / MIN_CHUNK_SIZE)
+	num_chunks = trec_results_buf.size / MIN_CHUNK_SIZE;
+    if (num_chunks < 1)
+	num_chunks = 1;
+    if (NULL == (chunks = Malloc (num_chunks, CHUNK)))
+	return (UNDEF);
+    ptr = trec_results_buf.buf;
+    end = trec_results_buf.buf + trec_results_buf.size;
+    for (i = 0; i < num_chunks; i++) {
+	chunks[i].start = ptr;
+	if (i == num_chunks - 1)
+	    ptr = end;
+	else {
+	    ptr = trec_results_buf.buf +
+		(trec_results_buf.size / num_chunks) * (i+1);
+	    if (ptr < chunks[i].start)
+		ptr = chunks[i].start;
+	    if (ptr < end)
+		ptr = (char *) memchr (ptr, '\n', end - ptr) + 1;
+	}
+	chunks[i].end = ptr;
     }
-    trec_results_buf[size] = '\0';
 
-    /* Count number of lines in file */
+    /* Count number of lines in each chunk */
+    if (UNDEF == te_run_parallel (num_chunks, count_chunk, chunks,
+				  sizeof (CHUNK)))
+	return (UNDEF);
     num_lines = 0;
-    for (ptr = trec_results_buf; *ptr; ptr = index(ptr,'\n')+1)
-	num_lines++;
+    for (i = 0; i < num_chunks; i++)
+	num_lines += chunks[i].num_lines;
 
-    /* Get all lines */
+    /* Get all lines, each chunk into its own segment of lines */
     if (NULL == (lines = Malloc (num_lines, LINES)))
 	return (UNDEF);
     line_ptr = lines;
-    ptr = trec_results_buf;
-    while (*ptr) {
-	/* Get current line */
-	/* Ignore blank lines (people seem to insist on them!) */
-	while (*ptr && *ptr != '\n' && isspace (*ptr)) ptr++;
-	if (*ptr == '\n') {
-	    ptr++;
-	    continue;
-	}
-	if (UNDEF == parse_results_line (&ptr, &line_ptr->qid,&line_ptr->docno,
-					 &line_ptr->sim, &run_id_ptr)) {
+    for (i = 0; i < num_chunks; i++) {
+	chunks[i].lines = line_ptr;
+	line_ptr += chunks[i].num_lines;
+    }
+    if (UNDEF == te_run_parallel (num_chunks, parse_chunk, chunks,
+				  sizeof (CHUNK)))
+	return (UNDEF);
+
+    /* Stitch segments together (blank lines leave gaps), in file order */
+    line_ptr = lines;
+    for (i = 0; i < num_chunks; i++) {
+	if (chunks[i].error_line >= 0) {
 	    fprintf (stderr, "trec_eval.get_results: Malformed line %ld\n",
-		     (long) (line_ptr - lines + 1));
+		     (long) (line_ptr - lines + chunks[i].error_line + 1));
 	    return (UNDEF);
 	}
-	line_ptr++;
+	if (line_ptr != chunks[i].lines && chunks[i].num_lines > 0)
+	    (void) memmove (line_ptr, chunks[i].lines,
+			    chunks[i].num_lines * sizeof (LINES));
+	line_ptr += chunks[i].num_lines;
+	if (chunks[i].run_id_ptr != NULL)
+	    run_id_ptr = chunks[i].run_id_ptr;
     }
     num_lines = line_ptr-lines;
+    Free (chunks);
+    for (i = 0; i < num_lines; i++)
+	lines[i].line_num = i;
 
     /* Sort all lines by qid, then docno */
-    qsort ((char *) lines,
-	   (int) num_lines,
-	   sizeof (LINES),
-	   comp_lines_qid_docno);
+    if (UNDEF == te_sort_lines_qid_docno (lines, num_lines, sizeof (LINES),
+					  epi->num_threads))
+	return (UNDEF);
 
-    /* Go through lines and count number of qid */
+    if (num_lines == 0) {
+	/* No results (eg, only blank lines) */
+	all_results->num_q_results = 0;
+	all_results->results = NULL;
+	Free (lines);
+	return (1);
+    }
+
+    /* Go through lines and count number of qid, and space needed for
+       NULL terminated copies of them and the run_id */
     num_qid = 1;
+    qid_size = te_field_len (lines[0].qid) + 1 + te_field_len (run_id_ptr) + 1;
     for (i = 1; i < num_lines; i++) {
-	if (strcmp (lines[i-1].qid, lines[i].qid))
+	if (te_field_cmp (lines[i-1].qid, lines[i].qid)) {
 	    /* New query */
 	    num_qid++;
+	    qid_size += te_field_len (lines[i].qid) + 1;
+	}
     }
 
     /* Allocate space for queries */
     if (NULL == (q_results_pool = Malloc (num_qid, RESULTS)) ||
 	NULL == (text_info_pool = Malloc (num_qid, TEXT_RESULTS_INFO)) ||
-	NULL == (text_results_pool = Malloc (num_lines, TEXT_RESULTS)))
+	NULL == (text_results_pool = Malloc (num_lines, TEXT_RESULTS)) ||
+	NULL == (qid_pool = Malloc (qid_size, char)))
 	return (UNDEF);
 
     q_results_ptr = q_results_pool;
     text_info_ptr = text_info_pool;
     text_results_ptr = text_results_pool;
+    qid_ptr = qid_pool;
+    run_id = te_field_copy (run_id_ptr, &qid_ptr);
     
     /* Go through lines and store all info */
     current_qid = "";
     for (i = 0; i < num_lines; i++) {
-	if (strcmp (current_qid, lines[i].qid)) {
+	if (te_field_cmp (current_qid, lines[i].qid)) {
 	    /* New query.  End old query and start new one */
 	    if (i != 0) {
 		text_info_ptr->num_text_results =
 		    text_results_ptr - text_info_ptr->text_results;
+		te_results_file_pos (text_info_ptr);
 		text_info_ptr++;
 		q_results_ptr++;
 	    }
-	    current_qid = lines[i].qid;
+	    current_qid = te_field_copy (lines[i].qid, &qid_ptr);
 	    text_info_ptr->text_results = text_results_ptr;
 	    *q_results_ptr =
-		(RESULTS) {current_qid, run_id_ptr, "trec_results",
+		(RESULTS) {current_qid, run_id, "trec_results",
 			   text_info_ptr};
 	}
 	text_results_ptr->docno = lines[i].docno;
-	text_results_ptr->sim = atof (lines[i].sim);
+	text_results_ptr->sim = lines[i].sim;
+	text_results_ptr->file_pos = lines[i].line_num;
 	text_results_ptr++;
     }
     /* End last qid */
     text_info_ptr->num_text_results =
 	text_results_ptr - text_info_ptr->text_results;
+    te_results_file_pos (text_info_ptr);
 
     all_results->num_q_results = num_qid;
     all_results->results = q_results_pool;
 
+    /* docids are assigned once all input files have been read */
+    if (UNDEF == te_docid_register (text_results_pool,
+				    text_results_ptr - text_results_pool,
+				    sizeof (TEXT_RESULTS),
+				    offsetof (TEXT_RESULTS, docno),
+				    offsetof (TEXT_RESULTS, docid)))
+	return (UNDEF);
+
     Free (lines);
     return (1);
 }
 
-static int comp_lines_qid_docno (LINES *ptr1, LINES *ptr2)
+/* Read the results of a run one query at a time, instead of all at once
+as te_get_trec_results does.  The lines of each query must be together in
+text_results_file (as a run is normally written); they need not be in any
+particular order otherwise.  Each call returns in *results the next query,
+whose results are valid until the next call: only the lines of one query
+are held in memory, so peak memory is that of the largest query whatever
+the size of the run.  The file is read sequentially, and may be a pipe
+("-" means standard input).
+The results of a query are stored exactly as te_get_trec_results would
+store them, and their docids are assigned by te_docid_assign_group
+(te_docid_assign_resident must have been called).  The run_id of a query
+is that of its last line.
+Return 1 if *results is a query, 0 at end of file, UNDEF if error.
+*/
+
+/* Bytes read from the file at a time */
+#define STREAM_READ_SIZE (1 << 20)
+
+static int stream_fd = -1;
+static char *stream_buf = NULL;   /* Unparsed lines of the file read so far.
+				     Always room for one more char */
+static long max_stream_buf = 0;
+static long stream_size = 0;      /* Number of bytes in stream_buf */
+static long stream_pos = 0;       /* Start of lines not yet returned.
+				     Lines before it are discarded when
+				     more of the file is read */
+static long stream_eof = 0;
+static long stream_num_lines = 0; /* Lines returned so far */
+static LINES *stream_lines = NULL;
+static long max_stream_lines = 0;
+static char *stream_qid = NULL;
+static long max_stream_qid = 0;
+static char **stream_run_ids = NULL; /* All distinct run_ids seen, so
+				       that earlier ones stay valid */
+static long num_stream_run_ids = 0;
+static long max_stream_run_ids = 0;
+static TEXT_RESULTS *stream_text_results = NULL;
+static long max_stream_text_results = 0;
+static TEXT_RESULTS_INFO stream_text_info;
+static RESULTS stream_results;
+
+int
+te_get_trec_results_query (EPI *epi, char *text_results_file,
+			   RESULTS **results)
 {
-    int cmp = strcmp (ptr1->qid, ptr2->qid);
-    if (cmp) return (cmp);
-    return (strcmp (ptr1->docno, ptr2->docno));
+    char *ptr;
+    char *nl;
+    char *end;
+    char *sim_ptr;
+    char *run_id_ptr = NULL;
+    char *run_id;
+    char *pool_ptr;
+    long off, qid_off;
+    long num_lines;
+    long i;
+
+    if (stream_fd == -1) {
+	if (0 == strcmp (text_results_file, "-"))
+	    stream_fd = 0;
+	else if (-1 == (stream_fd = open (text_results_file, 0))) {
+	    fprintf (stderr,
+		     "trec_eval.get_results: Cannot read results file '%s'\n",
+		     text_results_file);
+	    return (UNDEF);
+	}
+	stream_size = stream_pos = stream_eof = stream_num_lines = 0;
+    }
+
+    /* Find the lines of the next query: all lines up to the first line
+       with a different qid, reading more of the file until it is found */
+    off = stream_pos;
+    qid_off = -1;
+    num_lines = 0;
+    while (1) {
+	if (off >= stream_size ||
+	    NULL == (nl = memchr (stream_buf + off, '\n', stream_size - off))) {
+	    if (stream_eof) {
+		if (off >= stream_size)
+		    break;
+		/* Append ending newline to last line */
+		stream_buf[stream_size++] = '\n';
+		continue;
+	    }
+	    /* Discard the lines already returned, and read more */
+	    if (stream_pos > 0) {
+		(void) memmove (stream_buf, stream_buf + stream_pos,
+				stream_size - stream_pos);
+		stream_size -= stream_pos;
+		off -= stream_pos;
+		if (qid_off >= 0)
+		    qid_off -= stream_pos;
+		stream_pos = 0;
+	    }
+	    if (UNDEF == read_stream_more ()) {
+		fprintf (stderr,
+			 "trec_eval.get_results: Cannot read results file '%s'\n",
+			 text_results_file);
+		return (UNDEF);
+	    }
+	    continue;
+	}
+	/* Ignore blank lines */
+	ptr = stream_buf + off;
+	while (*ptr != '\n' && isspace (*ptr)) ptr++;
+	if (*ptr != '\n') {
+	    if (qid_off < 0)
+		qid_off = ptr - stream_buf;
+	    else if (te_field_cmp (stream_buf + qid_off, ptr))
+		break;
+	    num_lines++;
+	}
+	off = nl - stream_buf + 1;
+    }
+    if (num_lines == 0)
+	return (0);
+
+    /* Parse the lines of the query, and sort them by docno */
+    if (NULL == (stream_lines =
+		 te_chk_and_malloc (stream_lines, &max_stream_lines,
+				    num_lines, sizeof (LINES))) ||
+	NULL == (stream_text_results =
+		 te_chk_and_malloc (stream_text_results,
+				    &max_stream_text_results,
+				    num_lines, sizeof (TEXT_RESULTS))))
+	return (UNDEF);
+    ptr = stream_buf + stream_pos;
+    end = stream_buf + off;
+    i = 0;
+    while (ptr < end) {
+	while (*ptr != '\n' && isspace (*ptr)) ptr++;
+	if (*ptr == '\n') {
+	    ptr++;
+	    continue;
+	}
+	if (UNDEF == parse_results_line (&ptr, &stream_lines[i].qid,
+					 &stream_lines[i].docno, &sim_ptr,
+					 &run_id_ptr)) {
+	    fprintf (stderr, "trec_eval.get_results: Malformed line %ld\n",
+		     stream_num_lines + i + 1);
+	    return (UNDEF);
+	}
+	stream_lines[i].sim = atof (sim_ptr);
+	stream_lines[i].line_num = i;
+	i++;
+    }
+    stream_num_lines += num_lines;
+    if (UNDEF == te_sort_lines_qid_docno (stream_lines, num_lines,
+					  sizeof (LINES), epi->num_threads))
+	return (UNDEF);
+
+    /* NULL terminated copies of qid and run_id */
+    if (NULL == (stream_qid =
+		 te_chk_and_malloc (stream_qid, &max_stream_qid,
+				    te_field_len (stream_lines[0].qid) + 1,
+				    sizeof (char))))
+	return (UNDEF);
+    pool_ptr = stream_qid;
+    (void) te_field_copy (stream_lines[0].qid, &pool_ptr);
+    for (i = 0; i < num_stream_run_ids; i++) {
+	if (0 == te_field_cmp (stream_run_ids[i], run_id_ptr))
+	    break;
+    }
+    if (i >= num_stream_run_ids) {
+	if (NULL == (stream_run_ids =
+		     te_chk_and_realloc (stream_run_ids, &max_stream_run_ids,
+					 num_stream_run_ids + 1,
+					 sizeof (char *))) ||
+	    NULL == (pool_ptr = Malloc (te_field_len (run_id_ptr) + 1, char)))
+	    return (UNDEF);
+	stream_run_ids[num_stream_run_ids++] =
+	    te_field_copy (run_id_ptr, &pool_ptr);
+    }
+    run_id = stream_run_ids[i];
+
+    for (i = 0; i < num_lines; i++) {
+	stream_text_results[i].docno = stream_lines[i].docno;
+	stream_text_results[i].sim = stream_lines[i].sim;
+	stream_text_results[i].file_pos = stream_lines[i].line_num;
+    }
+    stream_text_info.num_text_results = num_lines;
+    stream_text_info.max_num_text_results = 0;
+    stream_text_info.text_results = stream_text_results;
+    te_results_file_pos (&stream_text_info);
+    if (UNDEF == te_docid_assign_group (stream_text_results, num_lines,
+					sizeof (TEXT_RESULTS),
+					offsetof (TEXT_RESULTS, docno),
+					offsetof (TEXT_RESULTS, docid),
+					epi->num_threads))
+	return (UNDEF);
+
+    stream_results = (RESULTS) {stream_qid, run_id, "trec_results",
+				&stream_text_info};
+    *results = &stream_results;
+    stream_pos = off;
+    return (1);
+}
+
+/* Read up to STREAM_READ_SIZE more bytes of the file into stream_buf */
+static int
+read_stream_more ()
+{
+    ssize_t ret;
+
+    if (NULL == (stream_buf =
+		 te_chk_and_realloc (stream_buf, &max_stream_buf,
+				     stream_size + STREAM_READ_SIZE + 1,
+				     sizeof (char))))
+	return (UNDEF);
+    do {
+	ret = read (stream_fd, stream_buf + stream_size,
+		    (size_t) (max_stream_buf - stream_size - 1));
+    } while (ret == -1 && errno == EINTR);
+    if (ret < 0)
+	return (UNDEF);
+    if (ret == 0)
+	stream_eof = 1;
+    stream_size += ret;
+    return (1);
+}
+
+int
+te_get_trec_results_query_cleanup ()
+{
+    long i;
+
+    if (stream_fd > 0 && -1 == close (stream_fd))
+	return (UNDEF);
+    stream_fd = -1;
+    if (max_stream_buf > 0) {
+	Free (stream_buf);
+	max_stream_buf = 0;
+    }
+    if (max_stream_lines > 0) {
+	Free (stream_lines);
+	max_stream_lines = 0;
+    }
+    if (max_stream_qid > 0) {
+	Free (stream_qid);
+	max_stream_qid = 0;
+    }
+    for (i = 0; i < num_stream_run_ids; i++)
+	Free (stream_run_ids[i]);
+    num_stream_run_ids = 0;
+    if (max_stream_run_ids > 0) {
+	Free (stream_run_ids);
+	max_stream_run_ids = 0;
+    }
+    if (max_stream_text_results > 0) {
+	Free (stream_text_results);
+	max_stream_text_results = 0;
+    }
+    return (1);
+}
+
+/* Turn the file_pos of the results of a query, on entry the index of
+   each result in the input (eg, the line number), into its position
+   (from 1) among the results of its query: possible if the query's
+   results were together in the input, otherwise file_pos is set to 0 */
+void
+te_results_file_pos (TEXT_RESULTS_INFO *text_results_info)
+{
+    TEXT_RESULTS *text_results = text_results_info->text_results;
+    long num_results = text_results_info->num_text_results;
+    long min_pos, max_pos;
+    long i;
+
+    if (num_results == 0)
+	return;
+    min_pos = max_pos = text_results[0].file_pos;
+    for (i = 1; i < num_results; i++) {
+	if (text_results[i].file_pos < min_pos)
+	    min_pos = text_results[i].file_pos;
+	if (text_results[i].file_pos > max_pos)
+	    max_pos = text_results[i].file_pos;
+    }
+    /* Indices are distinct, so they are together if they span no more
+       than num_results */
+    if (max_pos - min_pos + 1 == num_results) {
+	for (i = 0; i < num_results; i++)
+	    text_results[i].file_pos -= min_pos - 1;
+    }
+    else {
+	for (i = 0; i < num_results; i++)
+	    text_results[i].file_pos = 0;
+    }
+}
+
+static void *
+count_chunk (void *arg)
+{
+    CHUNK *chunk = (CHUNK *) arg;
+    INPUT_BUF chunk_buf;
+
+    chunk_buf.buf = chunk->start;
+    chunk_buf.size = chunk->end - chunk->start;
+    chunk->num_lines = te_count_lines (&chunk_buf);
+    return (NULL);
+}
+
+/* Parse all lines of one chunk into its segment.  On a malformed line,
+   record its index within the segment and stop */
+static void *
+parse_chunk (void *arg)
+{
+    CHUNK *chunk = (CHUNK *) arg;
+    char *ptr = chunk->start;
+    LINES *line_ptr = chunk->lines;
+    char *sim_ptr;
+
+    chunk->error_line = -1;
+    chunk->run_id_ptr = NULL;
+    while (ptr < chunk->end) {
+	/* Get current line */
+	/* Ignore blank lines (people seem to insist on them!) */
+	while (*ptr != '\n' && isspace (*ptr)) ptr++;
+	if (*ptr == '\n') {
+	    ptr++;
+	    continue;
+	}
+	if (UNDEF == parse_results_line (&ptr, &line_ptr->qid,&line_ptr->docno,
+					 &sim_ptr, &chunk->run_id_ptr)) {
+	    chunk->error_line = line_ptr - chunk->lines;
+	    break;
+	}
+	line_ptr->sim = atof (sim_ptr);
+	line_ptr++;
+    }
+    chunk->num_lines = line_ptr - chunk->lines;
+    return (NULL);
 }
 
+/* Parse one line of buf starting at *start_ptr.  Nothing is written into
+   the buffer; field pointers returned are views within it. */
 static int
 parse_results_line (char **start_ptr, char **qid_ptr, char **docno_ptr,
 		    char **sim_ptr, char **run_id_ptr)
@@ -188,8 +595,7 @@ parse_results_line (char **start_ptr, char **qid_ptr, char **docno_ptr,
     /* Get qid */
     *qid_ptr = ptr;
     while (! isspace (*ptr)) ptr++;
-    if (*ptr == '\n')  return (UNDEF);
-    *ptr++ = '\0';
+    if (*ptr++ == '\n')  return (UNDEF);
     /* Skip iter */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     while (! isspace (*ptr)) ptr++;
@@ -198,8 +604,7 @@ parse_results_line (char **start_ptr, char **qid_ptr, char **docno_ptr,
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     *docno_ptr = ptr;
     while (! isspace (*ptr)) ptr++;
-    if (*ptr == '\n') return (UNDEF);
-    *ptr++ = '\0';
+    if (*ptr++ == '\n') return (UNDEF);
     /* Skip rank */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     while (! isspace (*ptr)) ptr++;
@@ -208,29 +613,25 @@ parse_results_line (char **start_ptr, char **qid_ptr, char **docno_ptr,
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     *sim_ptr = ptr;
     while (! isspace (*ptr)) ptr++;
-    if (*ptr == '\n')return (UNDEF);
-    *ptr++ = '\0';
+    if (*ptr++ == '\n')return (UNDEF);
     /* Get run_id */
     while (*ptr != '\n' && isspace (*ptr)) ptr++;
     if (*ptr == '\n') return (UNDEF);
     *run_id_ptr = ptr;
-    while (! isspace (*ptr)) ptr++;
-    if (*ptr != '\n') {
-	/* Skip over rest of line */
-	*ptr++ = '\0';
-	while (*ptr != '\n') ptr++;
-    }
-    *ptr++ = '\0';
-    *start_ptr = ptr;
+    /* Skip over rest of line */
+    while (*ptr != '\n') ptr++;
+    *start_ptr = ptr + 1;
     return (0);
 }
 
 int 
 te_get_trec_results_cleanup ()
 {
-    if (trec_results_buf != NULL) {
-	Free (trec_results_buf);
-	trec_results_buf = NULL;
+    if (UNDEF == te_unmap_file (&trec_results_buf))
+	return (UNDEF);
+    if (qid_pool != NULL) {
+	Free (qid_pool);
+	qid_pool = NULL;
     }
     if (text_info_pool != NULL) {
 	Free (text_info_pool);
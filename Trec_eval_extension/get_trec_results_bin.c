@@ -0,0 +1,386 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+
+/* Read all retrieved results information from a 'trec_results_bin' file,
+the binary form of a trec_results file written by 'trec_eval -C'
+(te_put_trec_results_bin below).  The file is
+     BIN_HEADER
+     BIN_QUERY       queries[num_qid]           in qid order
+     int64_t         docnos[num_docnos]         offsets into strings
+     BIN_RESULT      results[num_results]       each query's contiguous,
+						in docno order
+     int32_t         file_pos[num_results]      see TEXT_RESULTS
+     char            strings[strings_size]      NULL terminated run_id,
+						qids and docnos
+     '\n'
+all in the byte order of the machine that wrote it (checked by the
+byte_order field).  Each distinct docno is stored once; results refer to
+it by its index in docnos.  The final newline lets te_map_file map the
+file in place: nothing is parsed or copied, qids, runid and docnos are
+strings within the mapped file.  The results are those of the trec_results
+file, in the same order, so evaluation is exactly the same as for it.
+*/
+
+#define BIN_MAGIC "TRECRES"
+#define BIN_BYTE_ORDER 0x01020304
+#define BIN_VERSION 1
+
+typedef struct {
+    char magic[8];                  /* BIN_MAGIC */
+    int32_t byte_order;             /* BIN_BYTE_ORDER */
+    int32_t version;                /* BIN_VERSION */
+    int64_t num_qid;
+    int64_t num_results;
+    int64_t num_docnos;
+    int64_t strings_size;
+    int64_t run_id;                 /* Offset of run_id in strings */
+} BIN_HEADER;
+
+typedef struct {
+    int64_t qid;                    /* Offset of qid in strings */
+    int64_t start;                  /* Index of first result of query */
+    int64_t num_results;
+} BIN_QUERY;
+
+typedef struct {
+    int32_t docno;                  /* Index into docnos */
+    float sim;
+} BIN_RESULT;
+
+static int check_string (int64_t offset, const BIN_HEADER *header);
+static int check_file_pos (const int32_t *file_pos, long num_results);
+static void put_field (const char *field, FILE *fp);
+
+/* static pools of memory, allocated here and never changed. */
+static INPUT_BUF bin_results_buf = {NULL, 0, 0};
+static TEXT_RESULTS_INFO *text_info_pool = NULL;
+static TEXT_RESULTS *text_results_pool = NULL;
+static RESULTS *q_results_pool = NULL;
+/* Space reserved for checking file_pos */
+static char *seen = NULL;
+static long max_seen = 0;
+
+int
+te_get_trec_results_bin (EPI *epi, char *bin_results_file,
+			 ALL_RESULTS *all_results)
+{
+    BIN_HEADER *header;
+    BIN_QUERY *queries;
+    int64_t *docnos;
+    BIN_RESULT *results;
+    int32_t *file_pos;
+    char *strings;
+    long size;
+    long q, i;
+    long next_start;
+    TEXT_RESULTS *text_results_ptr;
+    BIN_RESULT *bin_ptr;
+
+    if (UNDEF == te_map_file (bin_results_file, &bin_results_buf)) {
+        fprintf (stderr,
+		 "trec_eval.get_results_bin: Cannot read results file '%s'\n",
+		 bin_results_file);
+        return (UNDEF);
+    }
+
+    /* Check header, and that the sizes it gives are those of the file */
+    header = (BIN_HEADER *) bin_results_buf.buf;
+    if (bin_results_buf.size < (long) sizeof (BIN_HEADER) ||
+	memcmp (header->magic, BIN_MAGIC, sizeof (header->magic)) ||
+	header->byte_order != BIN_BYTE_ORDER) {
+	fprintf (stderr, "trec_eval.get_results_bin: '%s' is not a trec_results_bin file (or was written on a machine of different byte order)\n",
+		 bin_results_file);
+	return (UNDEF);
+    }
+    if (header->version != BIN_VERSION) {
+	fprintf (stderr, "trec_eval.get_results_bin: '%s' is version %d, not %d\n",
+		 bin_results_file, (int) header->version, BIN_VERSION);
+	return (UNDEF);
+    }
+    size = bin_results_buf.size;
+    if (header->num_qid < 0 || header->num_qid > size ||
+	header->num_results < 0 || header->num_results > size ||
+	header->num_docnos < 0 || header->num_docnos > size ||
+	header->strings_size <= 0 || header->strings_size > size ||
+	size != (long) sizeof (BIN_HEADER) +
+	header->num_qid * (long) sizeof (BIN_QUERY) +
+	header->num_docnos * (long) sizeof (int64_t) +
+	header->num_results * (long) (sizeof (BIN_RESULT) + sizeof (int32_t)) +
+	header->strings_size + 1) {
+	fprintf (stderr, "trec_eval.get_results_bin: '%s' is truncated or corrupt\n",
+		 bin_results_file);
+	return (UNDEF);
+    }
+    queries = (BIN_QUERY *) (header + 1);
+    docnos = (int64_t *) (queries + header->num_qid);
+    results = (BIN_RESULT *) (docnos + header->num_docnos);
+    file_pos = (int32_t *) (results + header->num_results);
+    strings = (char *) (file_pos + header->num_results);
+
+    /* All strings are within strings, and NULL terminated */
+    if (strings[header->strings_size - 1] != '\0' ||
+	UNDEF == check_string (header->run_id, header))
+	goto corrupt;
+    for (i = 0; i < header->num_docnos; i++) {
+	if (UNDEF == check_string (docnos[i], header))
+	    goto corrupt;
+    }
+
+    /* Allocate space for queries */
+    if (NULL == (q_results_pool = Malloc (header->num_qid + 1, RESULTS)) ||
+	NULL == (text_info_pool = Malloc (header->num_qid + 1,
+					  TEXT_RESULTS_INFO)) ||
+	NULL == (text_results_pool = Malloc (header->num_results + 1,
+					     TEXT_RESULTS)))
+	return (UNDEF);
+
+    /* Queries are in turn, and between them have every result.  The
+       file_pos of a query are all 0, or 1 to its num_results in some
+       order (form_frame.c indexes by them) */
+    next_start = 0;
+    for (q = 0; q < header->num_qid; q++) {
+	if (UNDEF == check_string (queries[q].qid, header) ||
+	    queries[q].start != next_start || queries[q].num_results < 0 ||
+	    queries[q].num_results > header->num_results - next_start ||
+	    UNDEF == check_file_pos (&file_pos[next_start],
+				     queries[q].num_results))
+	    goto corrupt;
+	next_start += queries[q].num_results;
+	text_results_ptr = &text_results_pool[queries[q].start];
+	bin_ptr = &results[queries[q].start];
+	for (i = 0; i < queries[q].num_results; i++) {
+	    if (bin_ptr[i].docno < 0 || bin_ptr[i].docno >= header->num_docnos)
+		goto corrupt;
+	    text_results_ptr[i].docno = strings + docnos[bin_ptr[i].docno];
+	    text_results_ptr[i].sim = bin_ptr[i].sim;
+	    text_results_ptr[i].file_pos = file_pos[queries[q].start + i];
+	}
+	text_info_pool[q].num_text_results = queries[q].num_results;
+	text_info_pool[q].max_num_text_results = queries[q].num_results;
+	text_info_pool[q].text_results = text_results_ptr;
+	q_results_pool[q] = (RESULTS) {strings + queries[q].qid,
+				       strings + header->run_id,
+				       "trec_results", &text_info_pool[q]};
+    }
+
+    if (next_start != header->num_results)
+	goto corrupt;
+
+    all_results->num_q_results = header->num_qid;
+    all_results->results = q_results_pool;
+
+    /* docids are assigned once all input files have been read */
+    if (UNDEF == te_docid_register (text_results_pool, header->num_results,
+				    sizeof (TEXT_RESULTS),
+				    offsetof (TEXT_RESULTS, docno),
+				    offsetof (TEXT_RESULTS, docid)))
+	return (UNDEF);
+    return (1);
+
+ corrupt:
+    fprintf (stderr, "trec_eval.get_results_bin: '%s' is corrupt\n",
+	     bin_results_file);
+    return (UNDEF);
+}
+
+static int
+check_string (int64_t offset, const BIN_HEADER *header)
+{
+    if (offset < 0 || offset >= header->strings_size)
+	return (UNDEF);
+    return (1);
+}
+
+static int
+check_file_pos (const int32_t *file_pos, long num_results)
+{
+    long i;
+
+    for (i = 0; i < num_results && file_pos[i] == 0; i++)
+	;
+    if (i >= num_results)
+	return (1);
+
+    if (NULL == (seen = te_chk_and_malloc (seen, &max_seen,
+					   num_results, sizeof (char))))
+	return (UNDEF);
+    (void) memset (seen, 0, num_results);
+    for (i = 0; i < num_results; i++) {
+	if (file_pos[i] < 1 || file_pos[i] > num_results ||
+	    seen[file_pos[i] - 1])
+	    return (UNDEF);
+	seen[file_pos[i] - 1] = 1;
+    }
+    return (1);
+}
+
+int
+te_get_trec_results_bin_cleanup ()
+{
+    if (UNDEF == te_unmap_file (&bin_results_buf))
+	return (UNDEF);
+    if (text_info_pool != NULL) {
+	Free (text_info_pool);
+	text_info_pool = NULL;
+    }
+    if (text_results_pool != NULL) {
+	Free (text_results_pool);
+	text_results_pool = NULL;
+    }
+    if (q_results_pool != NULL) {
+	Free (q_results_pool);
+	q_results_pool = NULL;
+    }
+    if (max_seen > 0) {
+	Free (seen);
+	seen = NULL;
+	max_seen = 0;
+    }
+    return (1);
+}
+
+/* Write the results of all_results (format trec_results, with docids
+   assigned) to bin_results_file ("-" is standard output) in the
+   trec_results_bin format above.
+   UNDEF returned if error, 1 otherwise. */
+int
+te_put_trec_results_bin (const ALL_RESULTS *all_results,
+			 const char *bin_results_file)
+{
+    BIN_HEADER header;
+    BIN_QUERY query;
+    BIN_RESULT result;
+    TEXT_RESULTS_INFO *text_info;
+    TEXT_RESULTS *text_results;
+    char **docid_docno;           /* docno of each docid retrieved */
+    int32_t *docid_index;         /* its index in docnos of the file */
+    long num_docids = te_num_docids ();
+    char *run_id = all_results->num_q_results > 0 ?
+	all_results->results[0].run_id : "";
+    int64_t offset;
+    int32_t pos;
+    long q, i;
+    FILE *fp;
+
+    for (q = 0; q < all_results->num_q_results; q++) {
+	if (strcmp ("trec_results", all_results->results[q].ret_format)) {
+	    fprintf (stderr,
+		     "trec_eval.put_results_bin: results not in trec_results format\n");
+	    return (UNDEF);
+	}
+    }
+
+    /* Intern docnos: each docid retrieved gets the next index, so docnos
+       are stored once each, in docno order */
+    if (NULL == (docid_docno = Malloc (num_docids + 1, char *)) ||
+	NULL == (docid_index = Malloc (num_docids + 1, int32_t)))
+	return (UNDEF);
+    for (i = 0; i < num_docids; i++)
+	docid_docno[i] = NULL;
+    (void) memset (&header, 0, sizeof (header));
+    (void) memcpy (header.magic, BIN_MAGIC, sizeof (header.magic));
+    header.byte_order = BIN_BYTE_ORDER;
+    header.version = BIN_VERSION;
+    header.num_qid = all_results->num_q_results;
+    for (q = 0; q < all_results->num_q_results; q++) {
+	text_info = all_results->results[q].q_results;
+	text_results = text_info->text_results;
+	for (i = 0; i < text_info->num_text_results; i++)
+	    docid_docno[text_results[i].docid] = text_results[i].docno;
+	header.num_results += text_info->num_text_results;
+    }
+    header.run_id = 0;
+    header.strings_size = te_field_len (run_id) + 1;
+    for (q = 0; q < all_results->num_q_results; q++)
+	header.strings_size += te_field_len (all_results->results[q].qid) + 1;
+    for (i = 0; i < num_docids; i++) {
+	if (docid_docno[i] != NULL) {
+	    docid_index[i] = header.num_docnos++;
+	    header.strings_size += te_field_len (docid_docno[i]) + 1;
+	}
+    }
+
+    if (0 == strcmp (bin_results_file, "-"))
+	fp = stdout;
+    else if (NULL == (fp = fopen (bin_results_file, "w"))) {
+	fprintf (stderr, "trec_eval.put_results_bin: Cannot create '%s'\n",
+		 bin_results_file);
+	Free (docid_docno);
+	Free (docid_index);
+	return (UNDEF);
+    }
+
+    (void) fwrite (&header, sizeof (header), 1, fp);
+    /* Queries.  Their strings follow run_id */
+    offset = te_field_len (run_id) + 1;
+    query.start = 0;
+    for (q = 0; q < all_results->num_q_results; q++) {
+	text_info = all_results->results[q].q_results;
+	query.qid = offset;
+	query.num_results = text_info->num_text_results;
+	(void) fwrite (&query, sizeof (query), 1, fp);
+	query.start += query.num_results;
+	offset += te_field_len (all_results->results[q].qid) + 1;
+    }
+    /* Docnos.  Their strings follow the qids */
+    for (i = 0; i < num_docids; i++) {
+	if (docid_docno[i] != NULL) {
+	    (void) fwrite (&offset, sizeof (offset), 1, fp);
+	    offset += te_field_len (docid_docno[i]) + 1;
+	}
+    }
+    /* Results, then their file_pos */
+    for (q = 0; q < all_results->num_q_results; q++) {
+	text_info = all_results->results[q].q_results;
+	text_results = text_info->text_results;
+	for (i = 0; i < text_info->num_text_results; i++) {
+	    result.docno = docid_index[text_results[i].docid];
+	    result.sim = text_results[i].sim;
+	    (void) fwrite (&result, sizeof (result), 1, fp);
+	}
+    }
+    for (q = 0; q < all_results->num_q_results; q++) {
+	text_info = all_results->results[q].q_results;
+	text_results = text_info->text_results;
+	for (i = 0; i < text_info->num_text_results; i++) {
+	    pos = text_results[i].file_pos;
+	    (void) fwrite (&pos, sizeof (pos), 1, fp);
+	}
+    }
+    /* Strings, then final newline */
+    put_field (run_id, fp);
+    for (q = 0; q < all_results->num_q_results; q++)
+	put_field (all_results->results[q].qid, fp);
+    for (i = 0; i < num_docids; i++) {
+	if (docid_docno[i] != NULL)
+	    put_field (docid_docno[i], fp);
+    }
+    (void) putc ('\n', fp);
+
+    Free (docid_docno);
+    Free (docid_index);
+    if (ferror (fp) || (fp == stdout ? fflush (fp) : fclose (fp))) {
+	fprintf (stderr, "trec_eval.put_results_bin: Cannot write '%s'\n",
+		 bin_results_file);
+	return (UNDEF);
+    }
+    return (1);
+}
+
+/* Write field (see te_field_cmp) to fp, NULL terminated */
+static void
+put_field (const char *field, FILE *fp)
+{
+    (void) fwrite (field, 1, te_field_len (field), fp);
+    (void) putc ('\0', fp);
+}
@@ -51,9 +51,9 @@ te_calc_11ptavg (const EPI *epi, const REL_INFO *rel_info,
     long *cutoffs;    /* cutoffs expressed in num rel docs instead of percents*/
     long current_cut; /* current index into cutoffs */
     RES_RELS rr;
+    RANK_STATS rs;
     long rel_so_far;
     long i;
-    double precis, int_precis;
     double sum = 0.0;
 
     if (0 == tm->meas_params->num_params) {
@@ -61,7 +61,7 @@ te_calc_11ptavg (const EPI *epi, const REL_INFO *rel_info,
 	return (UNDEF);
     }
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &rr))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &rr, &rs))
 	return (UNDEF);
 
     /* translate percentage of rels as given in the measure params, to
@@ -77,27 +77,17 @@ te_calc_11ptavg (const EPI *epi, const REL_INFO *rel_info,
     while (current_cut >= 0 && cutoffs[current_cut] > rr.num_rel_ret)
 	current_cut--;
 
-    /* Loop over all retrieved docs in reverse order.  Needs to be
-       reverse order since are calcualting interpolated precision.
-       Int_Prec (X) defined to be MAX (Prec (Y)) for all Y >= X. */
-    precis = (double) rr.num_rel_ret / (double) rr.num_ret;
-    int_precis = precis;
-    rel_so_far = rr.num_rel_ret;
-    for (i = rr.num_ret; i > 0 && rel_so_far > 0; i--) {
-	precis = (double) rel_so_far / (double) i;
-	if (int_precis < precis)
-	    int_precis = precis;
-	if (rr.results_rel_list[i-1] >= epi->relevance_level) {
-            while (current_cut >= 0 && rel_so_far == cutoffs[current_cut]) {
-		sum += int_precis;
-                current_cut--;
-            }
-            rel_so_far--;
+    /* Interpolated precision at each number of rel docs retrieved, in
+       reverse order (see form_rank_stats.c) */
+    for (rel_so_far = rr.num_rel_ret; rel_so_far > 0; rel_so_far--) {
+	while (current_cut >= 0 && rel_so_far == cutoffs[current_cut]) {
+	    sum += rs.int_prec[rel_so_far];
+	    current_cut--;
 	}
     }
 
     while (current_cut >= 0) {
-	sum += int_precis;
+	sum += rs.int_prec[0];
 	current_cut--;
     }
 
@@ -50,31 +50,22 @@ te_calc_P (const EPI *epi, const REL_INFO *rel_info, const RESULTS *results,
 	  const TREC_MEAS *tm, TREC_EVAL *eval)
 {
     long *cutoffs = (long *) tm->meas_params->param_values;
-    long cutoff_index = 0;
+    long cutoff_index;
     long i;
     RES_RELS res_rels;
-    long rel_so_far = 0;
+    RANK_STATS rs;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &res_rels, &rs))
 	return (UNDEF);
 
-    for (i = 0; i < res_rels.num_ret; i++) {
-	if (i == cutoffs[cutoff_index]) {
-	    /* Calculate previous cutoff threshold.
-	       Note all guaranteed to be positive by init_meas */
-	    eval->values[tm->eval_index + cutoff_index].value =
-		(double) rel_so_far / (double) i;
-	    if (++cutoff_index == tm->meas_params->num_params)
-		break;
-	}
-	if (res_rels.results_rel_list[i] >= epi->relevance_level)
-	    rel_so_far++;
-    }
-    /* calculate values for those cutoffs not achieved */
-    while (cutoff_index < tm->meas_params->num_params) {
-	eval->values[tm->eval_index+cutoff_index].value =
-	    (double) rel_so_far / (double) cutoffs[cutoff_index];
-	cutoff_index++;
+    /* Cutoffs beyond the retrieved docs are filled in with nonrel docs.
+       Note all guaranteed to be positive by init_meas */
+    for (cutoff_index = 0;
+	 cutoff_index < tm->meas_params->num_params;
+	 cutoff_index++) {
+	i = MIN (cutoffs[cutoff_index], res_rels.num_ret);
+	eval->values[tm->eval_index + cutoff_index].value =
+	    (double) rs.rel_ret[i] / (double) cutoffs[cutoff_index];
     }
     return (1);
 }
@@ -43,23 +43,17 @@ te_calc_Rprec (const EPI *epi, const REL_INFO *rel_info, const RESULTS *results,
 	       const TREC_MEAS *tm, TREC_EVAL *eval)
 {
     RES_RELS res_rels;
+    RANK_STATS rs;
     long num_to_look_at;
-    long rel_so_far;
-    long i;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &res_rels, &rs))
 	return (UNDEF);
 
-    rel_so_far = 0;
     num_to_look_at = MIN (res_rels.num_ret, res_rels.num_rel);
     if (0 == num_to_look_at)
 	return (0);
 
-    for (i = 0; i < num_to_look_at; i++) {
-	if (res_rels.results_rel_list[i] >= epi->relevance_level)
-	    rel_so_far++;
-    }
     eval->values[tm->eval_index].value =
-	(double) rel_so_far / (double) res_rels.num_rel;
+	(double) rs.rel_ret[num_to_look_at] / (double) res_rels.num_rel;
     return (1);
 }
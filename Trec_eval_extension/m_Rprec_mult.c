@@ -45,48 +45,25 @@ te_calc_Rprec_mult (const EPI *epi, const REL_INFO *rel_info,
 		    TREC_EVAL *eval)
 {
     double *cutoff_percents = (double *) tm->meas_params->param_values;
-    long *cutoffs;    /* cutoffs expressed in num ret docs instead of percents*/
-    long current_cut; /* current index into cutoffs */
+    long cutoff;      /* cutoff expressed in num ret docs instead of percent */
     RES_RELS rr;
-    long rel_so_far;
+    RANK_STATS rs;
     long i;
-    double precis, int_precis;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &rr))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &rr, &rs))
 	return (UNDEF);
 
     /* translate percentage of rels as given in the measure params, to
        an actual cutoff number of docs. */
-    if (NULL == (cutoffs = Malloc (tm->meas_params->num_params, long)))
-	return (UNDEF);
-    for (i = 0; i < tm->meas_params->num_params; i++)
-	cutoffs[i] = (long)(cutoff_percents[i] * rr.num_rel +0.9);
-    precis = (double) rr.num_rel_ret / (double) rr.num_ret;
-    int_precis = precis;
-
-    current_cut = tm->meas_params->num_params - 1;
-    while (current_cut >= 0 && cutoffs[current_cut] > rr.num_ret) {
-	eval->values[tm->eval_index + current_cut].value =
-	    (double) rr.num_rel_ret / (double) cutoffs[current_cut];
-	current_cut--;
+    for (i = 0; i < tm->meas_params->num_params; i++) {
+	cutoff = (long)(cutoff_percents[i] * rr.num_rel +0.9);
+	if (cutoff > rr.num_ret)
+	    eval->values[tm->eval_index + i].value =
+		(double) rr.num_rel_ret / (double) cutoff;
+	else if (cutoff > 0)
+	    eval->values[tm->eval_index + i].value =
+		(double) rs.rel_ret[cutoff] / (double) cutoff;
     }
 
-    /* Loop over all retrieved docs in reverse order.  */
-    rel_so_far = rr.num_rel_ret;
-    for (i = rr.num_ret; i > 0 && rel_so_far > 0; i--) {
-	precis = (double) rel_so_far / (double) i;
-	if (int_precis < precis)
-	    int_precis = precis;
-	while (current_cut >= 0 && i == cutoffs[current_cut]) {
-	    eval->values[tm->eval_index + current_cut].value = precis;
-	    current_cut--;
-	}
-	if (rr.results_rel_list[i-1] >= epi->relevance_level) {
-            rel_so_far--;
-	}
-    }
-
-    (void) Free (cutoffs);
-
     return (1);
 }
@@ -38,28 +38,30 @@ te_calc_binG (const EPI *epi, const REL_INFO *rel_info, const RESULTS *results,
 	     const TREC_MEAS *tm, TREC_EVAL *eval)
 {
     RES_RELS res_rels;
+    RANK_STATS rs;
     double sum;
     long rel_so_far;
     long i;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &res_rels, &rs))
 	return (UNDEF);
 
-    rel_so_far = 0;
-    sum = 0.0;
-    for (i = 0; i < res_rels.num_ret; i++) {
-	if (res_rels.results_rel_list[i] >= epi->relevance_level) {
-	    rel_so_far++;
-	    sum += (double) 1.0 / (double) log2 ((double) (3 + i - rel_so_far));
-	    if (epi->debug_level > 0) 
+    if (epi->debug_level > 0) {
+	rel_so_far = 0;
+	sum = 0.0;
+	for (i = 0; i < res_rels.num_ret; i++) {
+	    if (res_rels.results_rel_list[i] >= epi->relevance_level) {
+		rel_so_far++;
+		sum += (double) 1.0 / (double) log2 ((double) (3 + i - rel_so_far));
 		printf("binG: %ld %ld %6.4f\n",
 		       i, rel_so_far, sum);
+	    }
 	}
     }
     /* Average over the rel docs */
-    if (rel_so_far) {
+    if (rs.rel_ret[res_rels.num_ret]) {
 	eval->values[tm->eval_index].value = 
-	    sum / (double) res_rels.num_rel;
+	    rs.bin_g_sum / (double) res_rels.num_rel;
     }
     return (1);
 }
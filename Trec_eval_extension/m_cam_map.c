@@ -42,13 +42,16 @@ te_calc_cam_map (const EPI *epi, const REL_INFO *rel_info, const RESULTS *result
     long rel_so_far;
     long i;
     long pa;
+    EVAL_FRAME *frame;
     double tmp_map;
+
+    /* The judgements of all aspects come from one merge */
+    if (UNDEF == te_form_frame (epi, rel_info, results, 2, &frame))
+	return (UNDEF);
     tmp_map = 0.0;
     for (pa = 0; pa <= 1; pa++)
     {
-        RES_RELS res_rels = {.num_rel_ret=0, .num_ret = 0, .num_nonpool=0, .num_unjudged_in_pool=0,.num_rel=0,.num_rel_levels=0,.rel_levels =0,.results_rel_list=0};
-        if (UNDEF == te_form_res_rels_two (epi, rel_info, results, &res_rels, &pa))
-    	return (UNDEF);
+        RES_RELS res_rels = frame->res_rels[pa];
         rel_so_far = 0;
         sum = 0.0;
         for (i = 0; i < res_rels.num_ret; i++) {
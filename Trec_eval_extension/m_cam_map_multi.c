@@ -0,0 +1,71 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+#include "trec_format.h"
+
+static int
+te_calc_cam_map_multi (const EPI *epi, const REL_INFO *rel_info,
+		       const RESULTS *results, const TREC_MEAS *tm,
+		       TREC_EVAL *eval);
+static PARAMS default_cam_map_multi_weights = { NULL, 0, NULL};
+
+/* See trec_eval.h for definition of TREC_MEAS */
+TREC_MEAS te_meas_cam_map_multi =
+    {"cam_map_multi",
+     "    Convex aggregating measure (CAM) of MAP over any number of aspects\n\
+    The weighted sum over all aspects of the rel_info (eg, the K columns of\n\
+    'qrels_multiaspect') of the average precision of each aspect, as\n\
+    cam_map does for two aspects (Lioma, Simonsen and Larsen, ICTIR '17).\n\
+    Weights are equal by default; they can be given on the command line as\n\
+    one parameter per aspect.\n\
+    Eg, 'trec_eval -R qrels_multiaspect -m cam_map_multi.0.5,0.3,0.2 ...'\n",
+     te_init_meas_s_float_p_float,
+     te_calc_cam_map_multi,
+     te_acc_meas_s,
+     te_calc_avg_meas_s,
+     te_print_single_meas_s_float,
+     te_print_final_meas_s_float_p,
+     &default_cam_map_multi_weights, -1};
+
+static int
+te_calc_cam_map_multi (const EPI *epi, const REL_INFO *rel_info,
+		       const RESULTS *results, const TREC_MEAS *tm,
+		       TREC_EVAL *eval)
+{
+    EVAL_FRAME *frame;
+    double weights[MAX_QRELS_ASPECTS];
+    const RES_RELS *res_rels;
+    double sum;
+    double cam_map;
+    long rel_so_far;
+    long i, a;
+
+    if (UNDEF == te_form_frame (epi, rel_info, results, 0, &frame) ||
+	UNDEF == te_form_frame_weights (tm, frame, weights))
+	return (UNDEF);
+
+    cam_map = 0.0;
+    for (a = 0; a < frame->num_aspects; a++) {
+	res_rels = &frame->res_rels[a];
+	rel_so_far = 0;
+	sum = 0.0;
+	for (i = 0; i < res_rels->num_ret; i++) {
+	    if (res_rels->results_rel_list[i] >= epi->relevance_level) {
+		rel_so_far++;
+		sum += (double) rel_so_far / (double) (i + 1);
+	    }
+	}
+	if (rel_so_far)
+	    cam_map += weights[a] * sum / (double) res_rels->num_rel;
+    }
+    eval->values[tm->eval_index].value = cam_map;
+    return (1);
+}
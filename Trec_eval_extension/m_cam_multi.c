@@ -0,0 +1,70 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+#include "trec_format.h"
+
+static int
+te_calc_cam_multi (const EPI *epi, const REL_INFO *rel_info,
+		   const RESULTS *results, const TREC_MEAS *tm,
+		   TREC_EVAL *eval);
+static PARAMS default_cam_multi_weights = { NULL, 0, NULL};
+
+/* See trec_eval.h for definition of TREC_MEAS */
+TREC_MEAS te_meas_cam_multi =
+    {"cam_multi",
+     "    Convex aggregating measure (CAM) of nDCG over any number of aspects\n\
+    The weighted sum over all aspects of the rel_info (eg, the K columns of\n\
+    'qrels_multiaspect') of the nDCG of each aspect, as cam does for two\n\
+    aspects (Lioma, Simonsen and Larsen, ICTIR '17).  The gain of a doc is\n\
+    its judgement.  Weights are equal by default; they can be given on the\n\
+    command line as one parameter per aspect.\n\
+    Eg, 'trec_eval -R qrels_multiaspect -m cam_multi.0.5,0.3,0.2 ...'\n",
+     te_init_meas_s_float_p_float,
+     te_calc_cam_multi,
+     te_acc_meas_s,
+     te_calc_avg_meas_s,
+     te_print_single_meas_s_float,
+     te_print_final_meas_s_float_p,
+     &default_cam_multi_weights, -1};
+
+static int
+te_calc_cam_multi (const EPI *epi, const REL_INFO *rel_info,
+		   const RESULTS *results, const TREC_MEAS *tm,
+		   TREC_EVAL *eval)
+{
+    EVAL_FRAME *frame;
+    double weights[MAX_QRELS_ASPECTS];
+    const RES_RELS *res_rels;
+    GAINS gains;
+    double results_dcg, ideal_dcg;
+    double cam;
+    long a;
+
+    if (UNDEF == te_form_frame (epi, rel_info, results, 0, &frame) ||
+	UNDEF == te_form_frame_weights (tm, frame, weights))
+	return (UNDEF);
+
+    cam = 0.0;
+    for (a = 0; a < frame->num_aspects; a++) {
+	res_rels = &frame->res_rels[a];
+	/* Gains are the judgements; the ideal ranking has all judged
+	   docs, by decreasing judgement */
+	if (UNDEF == te_form_gains (res_rels, NULL, &gains))
+	    return (UNDEF);
+	results_dcg = te_gains_dcg (&gains, res_rels->results_rel_list,
+				    0, res_rels->num_ret);
+	ideal_dcg = te_gains_ideal_dcg (&gains, 0, gains.total_num_at_levels);
+	if (ideal_dcg > 0.0)
+	    cam += weights[a] * results_dcg / ideal_dcg;
+    }
+    eval->values[tm->eval_index].value = cam;
+    return (1);
+}
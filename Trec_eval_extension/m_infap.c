@@ -42,47 +42,13 @@ te_calc_infap (const EPI *epi, const REL_INFO *rel_info, const RESULTS *results,
 	       const TREC_MEAS *tm, TREC_EVAL *eval)
 {
     RES_RELS res_rels;
-    long j;
-    long nonrel_so_far, rel_so_far, pool_unjudged_so_far;
-    double inf_ap = 0.0;
+    RANK_STATS rs;
+    double inf_ap;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &res_rels, &rs))
 	return (UNDEF);
 
-    nonrel_so_far = 0;
-    rel_so_far = 0;
-    pool_unjudged_so_far = 0;
-    for (j = 0; j < res_rels.num_ret; j++) {
-	if (res_rels.results_rel_list[j] == RELVALUE_NONPOOL)
-	    /* document not in pool. Skip */
-	    continue;
-	if (res_rels.results_rel_list[j] == RELVALUE_UNJUDGED) {
-	    /* document in pool but unjudged. */
-	    pool_unjudged_so_far++;
-	    continue;
-	}
-
-	if (res_rels.results_rel_list[j] >= 0 &&
-	    res_rels.results_rel_list[j] < epi->relevance_level) {
-	    nonrel_so_far++;
-	}
-	else {
-	    /* Judged Rel doc */
-	    rel_so_far++;
-	    /* Special case nonrel_so_far == 0 to avoid division by 0 */
-	    /* inf_ap */
-	    if (0 == j)
-		inf_ap += 1.0;
-	    else {
-		double fj = (double) j;
-		inf_ap += 1.0 / (fj+1.0) +
-		    (fj / (fj+1.0)) *
-		    ((rel_so_far-1+nonrel_so_far+pool_unjudged_so_far) / fj)  *
-		    ((rel_so_far-1 + INFAP_EPSILON) / 
-		     (rel_so_far-1 + nonrel_so_far + 2 * INFAP_EPSILON));
-	    }
-	}
-    }
+    inf_ap = rs.infap_sum;
     if (res_rels.num_rel) {
 	inf_ap /= res_rels.num_rel;
     }
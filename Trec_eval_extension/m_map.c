@@ -44,25 +44,15 @@ te_calc_map (const EPI *epi, const REL_INFO *rel_info, const RESULTS *results,
 	     const TREC_MEAS *tm, TREC_EVAL *eval)
 {
     RES_RELS res_rels;
-    double sum;
-    long rel_so_far;
-    long i;
+    RANK_STATS rs;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &res_rels, &rs))
 	return (UNDEF);
 
-    rel_so_far = 0;
-    sum = 0.0;
-    for (i = 0; i < res_rels.num_ret; i++) {
-	if (res_rels.results_rel_list[i] >= epi->relevance_level) {
-	    rel_so_far++;
-	    sum += (double) rel_so_far / (double) (i + 1);
-	}
-    }
     /* Average over the rel docs */
-    if (rel_so_far) {
+    if (rs.rel_ret[res_rels.num_ret]) {
 	eval->values[tm->eval_index].value = 
-	    sum / (double) res_rels.num_rel;
+	    rs.prec_sum[res_rels.num_ret] / (double) res_rels.num_rel;
     }
     return (1);
 }
@@ -9,7 +9,6 @@
 #include "trec_eval.h"
 #include "functions.h"
 #include "trec_format.h"
-double log2(double x);
 
 static int 
 te_calc_ndcg_cut (const EPI *epi, const REL_INFO *rel_info,
@@ -44,82 +43,39 @@ te_calc_ndcg_cut (const EPI *epi, const REL_INFO *rel_info,
 		  const RESULTS *results, const TREC_MEAS *tm, TREC_EVAL *eval)
 {
     long  *cutoffs = (long *) tm->meas_params->param_values;
-    long cutoff_index = 0;
+    long cutoff_index;
     RES_RELS res_rels;
-    double gain, sum;
+    GAINS gains;
+    double sum;
     double ideal_dcg;          /* ideal discounted cumulative gain */
-    long cur_lvl, lvl_count;
-    long i;
+    long start, end;
    
     if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
 	return (UNDEF);
 
+    /* Gains are the rel_levels */
+    if (UNDEF == te_form_gains (&res_rels, NULL, &gains))
+	return (UNDEF);
+
+    /* Add the dcg and ideal dcg of the ranks up to each cutoff to those
+       of the previous cutoff, and normalize */
     sum = 0.0;
-    for (i = 0; i < res_rels.num_ret; i++) {
-        if (i == cutoffs[cutoff_index]) {
-            /* Calculate previous cutoff threshold.
-             Note i guaranteed to be positive by init_meas */
-            eval->values[tm->eval_index + cutoff_index].value = sum;
-            if (++cutoff_index == tm->meas_params->num_params)
-                break;
-	    if (epi->debug_level > 0) 
-		printf("ndcg_cut: cutoff %ld dcg %6.4f\n", i, sum);
-        }
-	gain = res_rels.results_rel_list[i];
-	if (gain > 0) {
-	    /* Note: i+2 since doc i has rank i+1 */
-	    sum += gain / log2((double) (i+2));
-	    if (epi->debug_level > 1) 
-		printf("ndcg_cut:%ld %3.1f %6.4f\n", i, gain, sum);
-	}
-    }
-    /* calculate values for those cutoffs not achieved */
-    while (cutoff_index < tm->meas_params->num_params) {
-	eval->values[tm->eval_index + cutoff_index].value = sum;
-	if (epi->debug_level > 0) 
-	    printf("ndcg_cut: cutoff %ld dcg %6.4f\n",
-		   cutoffs[cutoff_index], sum);
-        cutoff_index++;
-    }
-    /* Calculate ideal discounted cumulative gain for this topic, and 
-     normalize previous sum by it */
-    cutoff_index = 0;
-    cur_lvl = res_rels.num_rel_levels - 1;
-    lvl_count = 0;
     ideal_dcg = 0.0;
-    for (i = 0; 1; i++) {
-	lvl_count++;
-	while (cur_lvl > 0 && lvl_count > res_rels.rel_levels[cur_lvl]) {
-	    cur_lvl--;
-	    lvl_count = 1;
-	}
-	if (cur_lvl == 0)
-	    break;
-
-        if (i == cutoffs[cutoff_index]) {
-            /* Calculate previous cutoff threshold.
-             Note i guaranteed to be positive by init_meas */
-	    if (ideal_dcg > 0.0) 
-		eval->values[tm->eval_index + cutoff_index].value /= ideal_dcg;
-	    if (epi->debug_level > 0)
-		printf("ndcg_cut: cutoff %ld idcg %6.4f\n", i, ideal_dcg);
-            if (++cutoff_index == tm->meas_params->num_params)
-                break;
-        }
-	gain = cur_lvl;
-	ideal_dcg += gain / (double) log2((double)(i + 2));
-	if (epi->debug_level > 0) 
-	    printf("ndcg_cut:%ld %ld %3.1f %6.4f\n",i, cur_lvl, gain,ideal_dcg);
-    }
-
-    /* calculate values for those cutoffs not achieved */
-    while (cutoff_index < tm->meas_params->num_params) {
-	if (ideal_dcg > 0.0) 
+    start = 0;
+    for (cutoff_index = 0; cutoff_index < tm->meas_params->num_params;
+	 cutoff_index++) {
+	end = cutoffs[cutoff_index];
+	sum += te_gains_dcg (&gains, res_rels.results_rel_list,
+			     MIN (start, res_rels.num_ret),
+			     MIN (end, res_rels.num_ret));
+	ideal_dcg += te_gains_ideal_dcg (&gains, start, end);
+	eval->values[tm->eval_index + cutoff_index].value = sum;
+	if (ideal_dcg > 0.0)
 	    eval->values[tm->eval_index + cutoff_index].value /= ideal_dcg;
-	if (epi->debug_level > 0)
-	    printf("ndcg_cut: cutoff %ld idcg %6.4f\n",
-		   cutoffs[cutoff_index], ideal_dcg);
-        cutoff_index++;
+	if (epi->debug_level > 0) 
+	    printf("ndcg_cut: cutoff %ld dcg %6.4f idcg %6.4f\n",
+		   end, sum, ideal_dcg);
+	start = end;
     }
 
     return (1);
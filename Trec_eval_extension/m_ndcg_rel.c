@@ -10,7 +10,6 @@
 #include "trec_eval.h"
 #include "functions.h"
 #include "trec_format.h"
-double log2(double x);
 
 static int 
 te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
@@ -52,25 +51,6 @@ TREC_MEAS te_meas_ndcg_rel =
      te_print_final_meas_s_float_p,
      &default_ndcg_gains, -1};
 
-/* Keep track of valid rel_levels and associated gains */
-/* Initialized in setup_gains */
-typedef struct {
-    long rel_level;
-    long num_at_level;
-    double gain;
-} REL_GAIN;
-
-typedef struct {
-    REL_GAIN *rel_gains;
-    long num_gains;
-    long total_num_at_levels;
-} GAINS;
-
-static int setup_gains (const TREC_MEAS *tm, const RES_RELS *res_rels,
-			GAINS *gains);
-static double get_gain (const long rel_level, const GAINS *gains);
-static int comp_rel_gain ();
-
 static int 
 te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
 	       const RESULTS *results, const TREC_MEAS *tm, TREC_EVAL *eval)
@@ -88,7 +68,7 @@ te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
     if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
 	return (UNDEF);
 
-    if (UNDEF == setup_gains (tm, &res_rels, &gains))
+    if (UNDEF == te_form_gains (&res_rels, tm->meas_params, &gains))
 	return (UNDEF);
 
     results_dcg = 0.0;
@@ -99,10 +79,10 @@ te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
     
     for (i = 0; i < res_rels.num_ret && ideal_gain > 0.0; i++) {
 	/* Calculate change in results dcg */
-	results_gain = get_gain (res_rels.results_rel_list[i], &gains);
+	results_gain = te_gains_gain (&gains, res_rels.results_rel_list[i]);
 	if (results_gain != 0)
-	    /* Note: i+2 since doc i has rank i+1 */
-	    results_dcg += results_gain / log2((double) (i+2));
+	    /* Note: discount[i] since doc i has rank i+1 */
+	    results_dcg += results_gain / gains.discount[i];
 	/* Calculate change in ideal dcg */
 	num_at_level++;
 	while (cur_level >= 0 &&
@@ -113,7 +93,7 @@ te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
 	}
 	if (ideal_gain > 0.0) {
 	    num_rel++;
-	    ideal_dcg += ideal_gain / log2((double)(i + 2));
+	    ideal_dcg += ideal_gain / gains.discount[i];
 	}
 	/* Average will include this point if rel */
 	if (results_gain > 0) {
@@ -128,9 +108,9 @@ te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
     if (i < res_rels.num_ret) {
 	while (i < res_rels.num_ret) {
 	    /* Calculate change in results dcg */
-	    results_gain = get_gain (res_rels.results_rel_list[i], &gains);
+	    results_gain = te_gains_gain (&gains, res_rels.results_rel_list[i]);
 	    if (results_gain != 0)
-		results_dcg += results_gain / log2((double) (i+2));
+		results_dcg += results_gain / gains.discount[i];
 	    /* Average will include this point if rel */
 	    if (results_gain > 0) {
 		sum += results_dcg / ideal_dcg;
@@ -154,7 +134,7 @@ te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
 	}
 	if (ideal_gain > 0.0) {
 	    num_rel++;
-	    ideal_dcg += ideal_gain / log2((double)(i + 2));
+	    ideal_dcg += ideal_gain / gains.discount[i];
 	}
 	if (epi->debug_level > 0) 
 	    printf("ndcg_rel: %ld %ld %3.1f %6.4f %3.1f %6.4f\n",
@@ -170,75 +150,5 @@ te_calc_ndcg_rel (const EPI *epi, const REL_INFO *rel_info,
     if (sum > 0.0)
 	eval->values[tm->eval_index].value = sum / num_rel;
 
-    Free (gains.rel_gains);
-    return (1);
-}
-
-static int
-setup_gains (const TREC_MEAS *tm, const RES_RELS *res_rels, GAINS *gains)
-{
-    FLOAT_PARAM_PAIR *pairs = NULL;
-    long num_pairs = 0;
-    long i,j;
-    long num_gains;
-
-    if (tm->meas_params) {
-	pairs = (FLOAT_PARAM_PAIR *) tm->meas_params->param_values;
-	num_pairs = tm->meas_params->num_params;
-    }
-
-    if (NULL == (gains->rel_gains = Malloc(res_rels->num_rel_levels + num_pairs,
-					   REL_GAIN)))
-	return (UNDEF);
-    num_gains = 0;
-    for (i = 0; i < num_pairs; i++) {
-	gains->rel_gains[num_gains].rel_level = atol (pairs[i].name);
-	gains->rel_gains[num_gains].gain = (double) pairs[i].value;
-	gains->rel_gains[num_gains].num_at_level = 0;
-	num_gains++;
-    }
-
-    for (i = 0; i < res_rels->num_rel_levels; i++) {
-	for (j = 0; j < num_gains && gains->rel_gains[j].rel_level != i; j++)
-	    ;
-	if (j < num_gains)
-	    /* Was included in list of parameters. Update occurrence info */
-	    gains->rel_gains[j].num_at_level = res_rels->rel_levels[i];
-	else {
-	    /* Not included in list of parameters. New gain level */
-	    gains->rel_gains[num_gains].rel_level = i;
-	    gains->rel_gains[num_gains].gain = (double) i;
-	    gains->rel_gains[num_gains].num_at_level = res_rels->rel_levels[i];
-	    num_gains++;
-	}
-    }
-
-    /* Sort gains by increasing gain value */
-    qsort ((char *) gains->rel_gains,
-           (int) num_gains,
-           sizeof (REL_GAIN),
-           comp_rel_gain);
-
-    gains->total_num_at_levels = 0;
-    for (i = 0; i < num_gains; i++)
-	gains->total_num_at_levels += gains->rel_gains[i].num_at_level;	
-
-    gains->num_gains = num_gains;
     return (1);
 }
-
-static int comp_rel_gain (REL_GAIN *ptr1, REL_GAIN *ptr2)
-{
-    return (ptr1->gain - ptr2->gain);
-}
-
-static double
-get_gain (const long rel_level, const GAINS *gains)
-{
-    long i;
-    for (i = 0; i < gains->num_gains; i++)
-	if (rel_level == gains->rel_gains[i].rel_level)
-	    return (gains->rel_gains[i].gain);
-    return (0.0);   /* Print Error ?? */
-}
-
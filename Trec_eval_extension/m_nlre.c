@@ -1,8 +1,8 @@
-/* 
-   Copyright (c) 2008 - Chris Buckley. 
+/*
+   Copyright (c) 2008 - Chris Buckley.
 
    Permission is granted for use and modification of this file for
-   research, non-commercial purposes. 
+   research, non-commercial purposes.
 */
 
 #include "common.h"
@@ -10,14 +10,16 @@
 #include "trec_eval.h"
 #include "functions.h"
 #include "trec_format.h"
-#include <ctype.h>
 
 double log2(double x);
 
-static int 
+static int
 te_calc_nlre (const EPI *epi, const REL_INFO *rel_info,
 		const RESULTS *results, const TREC_MEAS *tm, TREC_EVAL *eval);
-static PARAMS default_nlre = { NULL, 0, NULL}; // useless
+static double nlre_param_array[] = {0.5, 0.5};
+static PARAMS default_nlre_params = {
+    NULL, sizeof (nlre_param_array) / sizeof (nlre_param_array[0]),
+    &nlre_param_array[0]};
 
 
 /* See trec_eval.h for definition of TREC_MEAS */
@@ -30,120 +32,150 @@ TREC_MEAS te_meas_nlre =
     This evaluation measure was designed to measure the effectiveness of both relevance and credibility\n\
     in ranked lists of retrieval results simultaneously and without bias in favour of either relevance or credibility\n\
     The values are set to the appropriate relevance and credibility by default.  \n\
-    The default values of u and v are 0.5 (default) so far it can only be overridden on the code.\n",
-     te_init_meas_s_float_p_pair,
+    The weights u (relevance) and v (credibility) are 0.5 by default; they can\n\
+    be given on the command line, u first.\n\
+    Eg, 'trec_eval -m nlre.0.6,0.4 ...'\n",
+     te_init_meas_s_float_p_float,
      te_calc_nlre,
      te_acc_meas_s,
      te_calc_avg_meas_s,
      te_print_single_meas_s_float,
      te_print_final_meas_s_float_p,
-     &default_nlre, -1};
+     (void *) &default_nlre_params, -1};
 
+/* Normalisation constants C_LRE, indexed by number of docs, of the u and
+   v they were computed for (0.0 if not computed yet, or to be
+   recomputed) */
+static THREAD_LOCAL float *c_lre_table;
+static THREAD_LOCAL long max_c_lre_table = 0;
+static THREAD_LOCAL double c_lre_u, c_lre_v;
 
-typedef struct {
-    char *docno;
-    float sim;
-    long pos_rank_rel;
-    long pos_rank_cred;
-    long rel;
-    long cred;
-} DOCNO_IDEAL_INFO;
+static float calc_lre (const EVAL_FRAME *frame, const double *discount,
+			double u_param, double v_param);
+static int calc_clre (long num_results, double u, double v, float *c_lre);
 
-
-static DOCNO_IDEAL_INFO *docno_info_ideal;
-static long max_docno_info_ideal = 0;
-static float calc_lre(), calc_clre();
-
-static int 
+static int
 te_calc_nlre (const EPI *epi, const REL_INFO *rel_info,
 	       const RESULTS *results, const TREC_MEAS *tm, TREC_EVAL *eval)
 {
-    RES_RELS res_rels;
-    long num_results;
-    long max_rel;
-    long max_cred;
+    double *params = (double *) tm->meas_params->param_values;
+    EVAL_FRAME *frame;
+    const double *discount;
     float error;
     float c_lre;
     float nlre;
 
-    TEXT_RESULTS_INFO *text_results_info;
-    TEXT_QRELS_CRED_INFO *trec_qrels;
-
-    TEXT_QRELS_CRED *qrels_ptr;
-
-    text_results_info = (TEXT_RESULTS_INFO *) results->q_results;
-    trec_qrels = (TEXT_QRELS_CRED_INFO *) rel_info->q_rel_info;
-
-    qrels_ptr = trec_qrels->text_qrels_cred;
-    max_rel = qrels_ptr->rel;
-    max_cred = qrels_ptr->cred;
-
-    num_results = text_results_info->num_text_results;
-
-    DOCNO_IDEAL_INFO *docno_info_ideal;
-
-
-    if (NULL == (docno_info_ideal = te_chk_and_malloc (docno_info_ideal, &max_docno_info_ideal,
-				    num_results, sizeof (DOCNO_IDEAL_INFO))))
+    if (tm->meas_params->num_params != 2) {
+	fprintf (stderr, "trec_eval.nlre: needs two parameters u and v, eg nlre.0.5,0.5\n");
 	return (UNDEF);
-	
+    }
 
+    /* Ideal positions of the docs for relevance and credibility; the
+       first max_num_docs_per_topic docs (in docno order) are evaluated */
+    if (UNDEF == te_form_frame (epi, rel_info, results, 2, &frame) ||
+	UNDEF == te_form_frame_ideal (frame) ||
+	UNDEF == te_form_frame_discount (frame->num_ideal, &discount))
+	return (UNDEF);
 
-    if (UNDEF == te_form_res_rels_cred (epi, rel_info, results, &res_rels, &docno_info_ideal))
+    error = calc_lre (frame, discount, params[0], params[1]);
+    if (UNDEF == calc_clre (frame->num_ideal, params[0], params[1], &c_lre))
 	return (UNDEF);
-    
-    max_docno_info_ideal = 0;
-    error = calc_lre(num_results, docno_info_ideal);
-    c_lre = calc_clre(num_results);
     nlre = 1 - (error/c_lre);
     eval->values[tm->eval_index].value = nlre;
-    
 
     return (1);
 }
 
+/* Compute the Local Rank Error of the ranking (LRE): the error of each
+   pair of adjacent docs, in rank order, discounted by the rank of the
+   first of the pair */
 static float
-calc_lre(int num_results, DOCNO_IDEAL_INFO *idealrankings){
-	float LRE = 0;
-    float u =0.5;
-    float v = 0.5;
-	int i, j, e_r, e_c;
-
-    /*The LRE is equal to 1 if n = 1*/
-    if (num_results < 2){
-        return (0);
-    }
-
-    /*Compute the Local Rank Error a ranking (LRE) */
-	for (i = 0; i < num_results; i++) {
-		j = i+1;
-		if (j < num_results){
-			e_r = max(0, idealrankings[i].pos_rank_rel - idealrankings[j].pos_rank_rel);
-			e_c = max(0, idealrankings[i].pos_rank_cred - idealrankings[j].pos_rank_cred);
-			LRE += ((u+e_r) * (v+e_c) - (u*v))/log2(i+2); /*The +2 is because the for starts from 0.*/ 
-		}
+calc_lre (const EVAL_FRAME *frame, const double *discount,
+	  double u_param, double v_param)
+{
+    const long *pos_rank_rel = frame->ideal_pos[0];
+    const long *pos_rank_cred = frame->ideal_pos[1];
+    float LRE = 0;
+    float u = u_param;
+    float v = v_param;
+    long i, j, d, prev_d;
+    int e_r, e_c;
+
+    j = 0;
+    prev_d = -1;
+    for (i = 0; i < frame->num_docs; i++) {
+	d = frame->ranked[i];
+	if (d >= frame->num_ideal)
+	    continue;
+	if (prev_d >= 0) {
+	    e_r = MAX (0, pos_rank_rel[prev_d] - pos_rank_rel[d]);
+	    e_c = MAX (0, pos_rank_cred[prev_d] - pos_rank_cred[d]);
+	    /* Note: pair starts at doc j-1, with rank j */
+	    LRE += ((u+e_r) * (v+e_c) - (u*v))/discount[j-1];
+	}
+	prev_d = d;
+	j++;
     }
-	return (LRE);
+    return (LRE);
 }
 
-static float calc_clre(int num_results){
-    int j;
-    double u= 0.5;
-    double v=0.5;
+/* Set *c_lre to the normalisation constant C_LRE of num_results docs:
+   the LRE of the reverse of the ideal ordering of both aspects.  Each
+   constant is computed once per thread (for the current u and v).
+   UNDEF returned if error, 1 otherwise. */
+static int
+calc_clre (long num_results, double u, double v, float *c_lre)
+{
+    long old_max;
+    long j, m;
     float clre = 0;
 
     // FIX FOR SHORT RANKINGS //
-    if (num_results <= 2){
-        return (1);
+    if (num_results <= 2) {
+	*c_lre = 1;
+	return (1);
+    }
+    if (num_results == 3) {
+	*c_lre = 2;
+	return (1);
+    }
+
+    if (u != c_lre_u || v != c_lre_v) {
+	if (max_c_lre_table > 0)
+	    (void) memset (c_lre_table, 0, max_c_lre_table * sizeof (float));
+	c_lre_u = u;
+	c_lre_v = v;
+    }
+    if (num_results >= max_c_lre_table) {
+	old_max = max_c_lre_table;
+	if (NULL == (c_lre_table =
+		     te_chk_and_realloc (c_lre_table, &max_c_lre_table,
+					 num_results + 1, sizeof (float))))
+	    return (UNDEF);
+	(void) memset (c_lre_table + old_max, 0,
+		       (max_c_lre_table - old_max) * sizeof (float));
     }
-    if (num_results == 3){
-        return (2);
+    if (c_lre_table[num_results] != 0.0) {
+	*c_lre = c_lre_table[num_results];
+	return (1);
     }
 
     /*This loop will compute the value of the normalisation constant.*/
-    for (j = 0; j <= floor((num_results/2)-1); ++j)
-    {
-        clre += ((pow((num_results - (2*j) -1),2)) + ((u+v)*(num_results-(2*j)-1)))/(1+(log2(1+j)));
+    for (j = 0; j <= num_results/2 - 1; ++j) {
+	m = num_results - 2*j - 1;
+	clre += ((double) m * m + (u+v) * m) / (1 + log2 ((double) (1+j)));
     }
-    return (clre);
+    c_lre_table[num_results] = clre;
+    *c_lre = clre;
+    return (1);
+}
+
+int
+te_meas_nlre_cleanup ()
+{
+    if (max_c_lre_table > 0) {
+	Free (c_lre_table);
+	max_c_lre_table = 0;
+    }
+    return (1);
 }
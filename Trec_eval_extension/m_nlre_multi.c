@@ -0,0 +1,180 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+#include "trec_format.h"
+
+double log2(double x);
+
+static int
+te_calc_nlre_multi (const EPI *epi, const REL_INFO *rel_info,
+		    const RESULTS *results, const TREC_MEAS *tm,
+		    TREC_EVAL *eval);
+static PARAMS default_nlre_multi_weights = { NULL, 0, NULL};
+
+/* See trec_eval.h for definition of TREC_MEAS */
+TREC_MEAS te_meas_nlre_multi =
+    {"nlre_multi",
+     "    Normalised Local Rank Error (NLRE) over any number of aspects\n\
+    As nlre (Lioma, Simonsen and Larsen, ICTIR '17), over all aspects of the\n\
+    rel_info (eg, the K columns of 'qrels_multiaspect').  The error of two\n\
+    adjacent docs is prod_a (w_a + e_a) - prod_a w_a, where e_a is how far\n\
+    they are out of the ideal order of aspect a, and is normalised by the\n\
+    greatest possible total error.  The w_a (u and v of nlre) are equal,\n\
+    summing to 1, by default; they can be given on the command line as one\n\
+    parameter per aspect.\n\
+    Eg, 'trec_eval -R qrels_multiaspect -m nlre_multi.0.5,0.3,0.2 ...'\n",
+     te_init_meas_s_float_p_float,
+     te_calc_nlre_multi,
+     te_acc_meas_s,
+     te_calc_avg_meas_s,
+     te_print_single_meas_s_float,
+     te_print_final_meas_s_float_p,
+     &default_nlre_multi_weights, -1};
+
+/* Normalisation constants C_LRE, indexed by number of docs, of the
+   weights they were computed for (0.0 if not computed yet, or to be
+   recomputed) */
+static THREAD_LOCAL double *c_lre_table;
+static THREAD_LOCAL long max_c_lre_table = 0;
+static THREAD_LOCAL double c_lre_weights[MAX_QRELS_ASPECTS];
+static THREAD_LOCAL long c_lre_num_aspects = 0;
+
+static double pair_error (const double *weights, long num_aspects,
+			  const long *errors);
+static int calc_clre (long n, const double *weights, long num_aspects,
+		      double *c_lre);
+
+static int
+te_calc_nlre_multi (const EPI *epi, const REL_INFO *rel_info,
+		    const RESULTS *results, const TREC_MEAS *tm,
+		    TREC_EVAL *eval)
+{
+    EVAL_FRAME *frame;
+    double weights[MAX_QRELS_ASPECTS];
+    long errors[MAX_QRELS_ASPECTS];
+    const double *discount;
+    double lre, c_lre;
+    long i, j, d, prev_d, a;
+
+    if (UNDEF == te_form_frame (epi, rel_info, results, 0, &frame) ||
+	UNDEF == te_form_frame_ideal (frame) ||
+	UNDEF == te_form_frame_weights (tm, frame, weights) ||
+	UNDEF == te_form_frame_discount (frame->num_ideal, &discount))
+	return (UNDEF);
+
+    /* Local rank error of each pair of adjacent docs of the ideal
+       orderings (see trec_format.h), in rank order */
+    lre = 0.0;
+    j = 0;
+    prev_d = -1;
+    for (i = 0; i < frame->num_docs; i++) {
+	d = frame->ranked[i];
+	if (d >= frame->num_ideal)
+	    continue;
+	if (prev_d >= 0) {
+	    for (a = 0; a < frame->num_aspects; a++)
+		errors[a] = MAX (0, frame->ideal_pos[a][prev_d] -
+				 frame->ideal_pos[a][d]);
+	    /* Note: pair starts at doc j-1, with rank j */
+	    lre += pair_error (weights, frame->num_aspects, errors) /
+		discount[j-1];
+	}
+	prev_d = d;
+	j++;
+    }
+
+    if (UNDEF == calc_clre (frame->num_ideal, weights, frame->num_aspects,
+			    &c_lre))
+	return (UNDEF);
+
+    eval->values[tm->eval_index].value = 1.0 - lre / c_lre;
+    return (1);
+}
+
+/* Set *c_lre to the normalisation constant of n docs: the error of the
+   reverse of the ideal ordering of every aspect, as nlre (with the same
+   constants for short rankings).  Each constant is computed once per
+   thread (for the current weights).
+   UNDEF returned if error, 1 otherwise. */
+static int
+calc_clre (long n, const double *weights, long num_aspects, double *c_lre)
+{
+    long errors[MAX_QRELS_ASPECTS];
+    long old_max;
+    long j, m, a;
+
+    if (n <= 2) {
+	*c_lre = 1.0;
+	return (1);
+    }
+    if (n == 3) {
+	*c_lre = 2.0;
+	return (1);
+    }
+
+    if (num_aspects != c_lre_num_aspects ||
+	memcmp (weights, c_lre_weights, num_aspects * sizeof (double))) {
+	if (max_c_lre_table > 0)
+	    (void) memset (c_lre_table, 0, max_c_lre_table * sizeof (double));
+	(void) memcpy (c_lre_weights, weights, num_aspects * sizeof (double));
+	c_lre_num_aspects = num_aspects;
+    }
+    if (n >= max_c_lre_table) {
+	old_max = max_c_lre_table;
+	if (NULL == (c_lre_table =
+		     te_chk_and_realloc (c_lre_table, &max_c_lre_table,
+					 n + 1, sizeof (double))))
+	    return (UNDEF);
+	(void) memset (c_lre_table + old_max, 0,
+		       (max_c_lre_table - old_max) * sizeof (double));
+    }
+    if (c_lre_table[n] != 0.0) {
+	*c_lre = c_lre_table[n];
+	return (1);
+    }
+
+    *c_lre = 0.0;
+    for (j = 0; j <= n/2 - 1; j++) {
+	m = n - 2*j - 1;
+	for (a = 0; a < num_aspects; a++)
+	    errors[a] = m;
+	*c_lre += pair_error (weights, num_aspects, errors) /
+	    (1.0 + log2 ((double) (1+j)));
+    }
+    c_lre_table[n] = *c_lre;
+    return (1);
+}
+
+/* Error of a pair of adjacent docs, errors[a] out of order on aspect a */
+static double
+pair_error (const double *weights, long num_aspects, const long *errors)
+{
+    double prod_error = 1.0;
+    double prod_weight = 1.0;
+    long a;
+
+    for (a = 0; a < num_aspects; a++) {
+	prod_error *= weights[a] + (double) errors[a];
+	prod_weight *= weights[a];
+    }
+    return (prod_error - prod_weight);
+}
+
+int
+te_meas_nlre_multi_cleanup ()
+{
+    if (max_c_lre_table > 0) {
+	Free (c_lre_table);
+	max_c_lre_table = 0;
+    }
+    c_lre_num_aspects = 0;
+    return (1);
+}
@@ -40,6 +40,7 @@ TREC_MEAS te_meas_nlre_three =
 
 typedef struct {
     char *docno;
+    int docid;
     float sim;
     long pos_rank_rel;
     long pos_rank_cred;
@@ -50,8 +51,6 @@ typedef struct {
 } DOCNO_IDEAL_INFO;
 
 
-static DOCNO_IDEAL_INFO *docno_info_ideal;
-static long max_docno_info_ideal = 0;
 static float calc_lre_three(), calc_clre_three();
 
 static int 
@@ -60,39 +59,27 @@ te_calc_nlre_three (const EPI *epi, const REL_INFO *rel_info,
 {
     RES_RELS res_rels;
     long num_results;
-    long max_rel;
-    long max_cred;
-    long max_third;
     float error;
     float c_lre;
     float nlre;
     TEXT_RESULTS_INFO *text_results_info;
-    TEXT_QRELS_THREE_INFO *trec_qrels;
-
-    TEXT_QRELS_THREE *qrels_ptr;
 
     text_results_info = (TEXT_RESULTS_INFO *) results->q_results;
-    trec_qrels = (TEXT_QRELS_THREE_INFO *) rel_info->q_rel_info;
-
-    qrels_ptr = trec_qrels->text_qrels_three;
-    max_rel = qrels_ptr->rel;
-    max_cred = qrels_ptr->cred;
-    max_third = qrels_ptr->third;
 
     num_results = text_results_info->num_text_results;
+    /* Only look at epi->max_num_docs_per_topic, as
+       te_form_res_three does when filling in docno_info_ideal */
+    if (num_results > epi->max_num_docs_per_topic)
+	num_results = epi->max_num_docs_per_topic;
 
     DOCNO_IDEAL_INFO *docno_info_ideal;
 
-
-    if (NULL == (docno_info_ideal = te_chk_and_malloc (docno_info_ideal, &max_docno_info_ideal,
-                    num_results, sizeof (DOCNO_IDEAL_INFO))))
-    return (UNDEF);
-    
+    /* docno_info_ideal is set to the space of the form procedure
+       below, valid until its next call on this thread */
 
     if (UNDEF == te_form_res_three (epi, rel_info, results, &res_rels, &docno_info_ideal))
     return (UNDEF);
     
-    max_docno_info_ideal = 0;
     error = calc_lre_three(num_results, docno_info_ideal);
     c_lre = calc_clre_three(num_results);
     // printf("%lf --- %lf\n", error,c_lre);
@@ -42,6 +42,7 @@ TREC_MEAS te_meas_nwcs =
 
 typedef struct {
     char *docno;
+    int docid;
     float sim;
     long pos_rank_rel;
     long pos_rank_cred;
@@ -51,8 +52,6 @@ typedef struct {
 } DOCNO_IDEAL_INFO;
 
 
-static DOCNO_IDEAL_INFO *docno_info_ideal;
-static long max_docno_info_ideal = 0;
 static float calc_nwcs();
 
 static int 
@@ -64,28 +63,24 @@ te_calc_nwcs (const EPI *epi, const REL_INFO *rel_info,
 
     float nWCS;
     TEXT_RESULTS_INFO *text_results_info;
-    TEXT_QRELS_CRED_INFO *trec_qrels;
 
-    
     text_results_info = (TEXT_RESULTS_INFO *) results->q_results;
-    trec_qrels = (TEXT_QRELS_CRED_INFO *) rel_info->q_rel_info;
-
 
     num_results = text_results_info->num_text_results;
+    /* Only look at epi->max_num_docs_per_topic, as
+       te_form_res_rels_twoaspects does when filling in docno_info_ideal */
+    if (num_results > epi->max_num_docs_per_topic)
+	num_results = epi->max_num_docs_per_topic;
 
     DOCNO_IDEAL_INFO *docno_info_ideal;
 
-
-    if (NULL == (docno_info_ideal = te_chk_and_malloc (docno_info_ideal, &max_docno_info_ideal,
-				    trec_qrels->num_text_qrels, sizeof (DOCNO_IDEAL_INFO))))
-	return (UNDEF);
-	
+    /* docno_info_ideal is set to the space of the form procedure
+       below, valid until its next call on this thread */
 
     if (UNDEF == te_form_res_rels_twoaspects (epi, rel_info, results, &res_rels, &docno_info_ideal))
 	return (UNDEF);
     int i;
     
-    max_docno_info_ideal = 0;
     nWCS = calc_nwcs(num_results, docno_info_ideal);
     eval->values[tm->eval_index].value = nWCS;
     
@@ -0,0 +1,108 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+#include "trec_format.h"
+
+static int
+te_calc_nwcs_multi (const EPI *epi, const REL_INFO *rel_info,
+		    const RESULTS *results, const TREC_MEAS *tm,
+		    TREC_EVAL *eval);
+static PARAMS default_nwcs_multi_weights = { NULL, 0, NULL};
+
+/* See trec_eval.h for definition of TREC_MEAS */
+TREC_MEAS te_meas_nwcs_multi =
+    {"nwcs_multi",
+     "    Normalised Weighted Cumulative Score (NWCS) over any number of aspects\n\
+    As nwcs (Lioma, Simonsen and Larsen, ICTIR '17), with the score of a doc\n\
+    the weighted sum of its judgements on all aspects of the rel_info (eg,\n\
+    the K columns of 'qrels_multiaspect'), unjudged as 0.  The ideal ranking\n\
+    orders the judged docs by decreasing score.  Weights are equal by\n\
+    default; they can be given on the command line as one parameter per\n\
+    aspect.\n\
+    Eg, 'trec_eval -R qrels_multiaspect -m nwcs_multi.0.5,0.3,0.2 ...'\n",
+     te_init_meas_s_float_p_float,
+     te_calc_nwcs_multi,
+     te_acc_meas_s,
+     te_calc_avg_meas_s,
+     te_print_single_meas_s_float,
+     te_print_final_meas_s_float_p,
+     &default_nwcs_multi_weights, -1};
+
+static int comp_score ();
+
+static int
+te_calc_nwcs_multi (const EPI *epi, const REL_INFO *rel_info,
+		    const RESULTS *results, const TREC_MEAS *tm,
+		    TREC_EVAL *eval)
+{
+    EVAL_FRAME *frame;
+    double weights[MAX_QRELS_ASPECTS];
+    double *ideal_scores;
+    const double *discount;
+    double score;
+    double wcs, ideal_wcs;
+    long i, j, d, a;
+
+    if (UNDEF == te_form_frame (epi, rel_info, results, 0, &frame) ||
+	UNDEF == te_form_frame_rank_all (frame) ||
+	UNDEF == te_form_frame_weights (tm, frame, weights) ||
+	UNDEF == te_form_frame_discount (frame->num_ideal, &discount))
+	return (UNDEF);
+
+    /* Score of each judged doc, in decreasing order */
+    if (NULL == (ideal_scores = Malloc (frame->num_qrels + 1, double)))
+	return (UNDEF);
+    for (i = 0; i < frame->num_qrels; i++) {
+	ideal_scores[i] = 0.0;
+	for (a = 0; a < frame->num_aspects; a++)
+	    ideal_scores[i] += weights[a] *
+		(double) MAX (frame->qrels_rels[a][i], 0);
+    }
+    qsort ((char *) ideal_scores,
+	   (int) frame->num_qrels,
+	   sizeof (double),
+	   comp_score);
+
+    /* Go through the docs of the ideal orderings (see trec_format.h) in
+       rank order */
+    wcs = 0.0;
+    ideal_wcs = 0.0;
+    j = 0;
+    for (i = 0; i < frame->num_docs; i++) {
+	d = frame->ranked[i];
+	if (d >= frame->num_ideal)
+	    continue;
+	score = 0.0;
+	for (a = 0; a < frame->num_aspects; a++)
+	    score += weights[a] * (double) MAX (frame->rels[a][d], 0);
+	wcs += score / discount[j];
+	if (j < frame->num_qrels)
+	    ideal_wcs += ideal_scores[j] / discount[j];
+	j++;
+    }
+    if (ideal_wcs > 0.0)
+	eval->values[tm->eval_index].value = wcs / ideal_wcs;
+
+    Free (ideal_scores);
+    return (1);
+}
+
+static int
+comp_score (ptr1, ptr2)
+double *ptr1;
+double *ptr2;
+{
+    if (*ptr1 > *ptr2)
+        return (-1);
+    if (*ptr1 < *ptr2)
+        return (1);
+    return (0);
+}
@@ -36,17 +36,13 @@ te_calc_recip_rank (const EPI *epi, const REL_INFO *rel_info,
 		    TREC_EVAL *eval)
 {
     RES_RELS res_rels;
-    long i;
+    RANK_STATS rs;
 
-    if (UNDEF == te_form_res_rels (epi, rel_info, results, &res_rels))
+    if (UNDEF == te_form_rank_stats (epi, rel_info, results, &res_rels, &rs))
 	return (UNDEF);
 
-    for (i = 0; i < res_rels.num_ret; i++) {
-	if (res_rels.results_rel_list[i] >= epi->relevance_level)
-	    break;
-    }
-    if (i <  res_rels.num_ret)
+    if (rs.first_rel)
 	eval->values[tm->eval_index].value =
-	    (double) 1.0 / (double) (i+1);
+	    (double) 1.0 / (double) rs.first_rel;
     return (1);
 }
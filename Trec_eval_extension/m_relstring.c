@@ -43,7 +43,7 @@ TREC_MEAS te_meas_relstring =
      te_calc_avg_meas_empty,
      te_print_q_relstring,
      te_print_relstring,
-     (void *) &default_relstring_params, -1};
+     (void *) &default_relstring_params, -1, 1};
 
 static int 
 te_calc_relstring (const EPI *epi, const REL_INFO *rel_info,
@@ -81,11 +81,8 @@ te_calc_relstring (const EPI *epi, const REL_INFO *rel_info,
 static int
 te_print_q_relstring (const EPI *epi, const TREC_MEAS *tm,const TREC_EVAL *eval)
 {
-    printf ("%-22s\t%s\t'%s'\n",
-            eval->values[tm->eval_index].name,
-            eval->qid,
-	    current_string);
-    return (1);
+    return (te_output_string (epi, eval->values[tm->eval_index].name,
+			      eval->qid, OUT_QUOTED, current_string));
 }
 
 
@@ -96,7 +93,7 @@ te_print_relstring (const EPI *epi, TREC_MEAS *tm, TREC_EVAL *eval)
 	string_len = 0;
 	Free (current_string);
     }
-    if (tm->meas_params->printable_params) {
+    if (tm->meas_params->printable_params && epi->num_runs <= 1) {
         Free (eval->values[tm->eval_index].name);
         Free (tm->meas_params->printable_params);
         Free (tm->meas_params->param_values);
@@ -15,19 +15,23 @@ static int
 te_calc_runid (const EPI *epi, const REL_INFO *rel_info,
 	       const RESULTS *results, const TREC_MEAS *tm, TREC_EVAL *eval);
 static int
+te_print_q_runid (const EPI *epi, const TREC_MEAS *tm, const TREC_EVAL *eval);
+static int
 te_print_runid (const EPI *epi, TREC_MEAS *tm, TREC_EVAL *eval);
 
 /* See trec_eval.h for definition of TREC_MEAS */
 TREC_MEAS te_meas_runid = 
     {"runid",
-     "    Runid given by results input file.\n",
+     "    Runid given by results input file.\n\
+    When evaluating several results files, it is also printed for each\n\
+    query, so every line of output can be matched with its run.\n",
      te_init_meas_empty,
      te_calc_runid,
      te_acc_meas_empty,
      te_calc_avg_meas_empty,
-     te_print_single_meas_empty,
+     te_print_q_runid,
      te_print_runid,
-     NULL, -1};
+     NULL, -1, 1};
 
 static char *runid;
 static int 
@@ -38,10 +42,20 @@ te_calc_runid (const EPI *epi, const REL_INFO *rel_info,
     return (1);
 }
 
+static int
+te_print_q_runid (const EPI *epi, const TREC_MEAS *tm, const TREC_EVAL *eval)
+{
+    if (epi->num_runs > 1)
+	return (te_output_string (epi, "runid", eval->qid, OUT_STRING,
+				  runid));
+    return (1);
+}
+
 static int
 te_print_runid (const EPI *epi, TREC_MEAS *tm, TREC_EVAL *eval)
 {
     if (epi->summary_flag)
-	printf ("%-22s\t%s\t%s\n", "runid", eval->qid, runid);
+	return (te_output_string (epi, "runid", eval->qid, OUT_STRING,
+				  runid));
     return (1);
 }
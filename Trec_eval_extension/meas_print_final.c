@@ -24,6 +24,8 @@
    Measures are defined in measures.c.
 */
 
+static int print_ci (const EPI *epi, const TREC_EVAL *eval, long index);
+
 /* ---------------- Print final measure generic procedures -------------- */
 
 /* Measure does not require printing or storage */
@@ -39,12 +41,12 @@ int
 te_print_final_meas_s_float (const EPI *epi, TREC_MEAS *tm,
 			     TREC_EVAL *eval)
 {
-    if (epi->summary_flag)
-	printf ("%s%-22s\t%s\t%6.4f\n",
-		epi->zscore_flag ? "Z": "",
-		eval->values[tm->eval_index].name,
-		eval->qid,
-		eval->values[tm->eval_index].value);
+    if (epi->summary_flag &&
+	(UNDEF == te_output_float (epi, eval->values[tm->eval_index].name,
+				   eval->qid,
+				   eval->values[tm->eval_index].value) ||
+	 UNDEF == print_ci (epi, eval, tm->eval_index)))
+	return (UNDEF);
     return (1);
 }
 
@@ -55,15 +57,12 @@ te_print_final_meas_s_long (const EPI *epi, TREC_MEAS *tm,
 {
     if (epi->summary_flag) {
 	if (epi->zscore_flag)
-	    printf ("Z%-22s\t%s\t%6.4f\n",
-		    eval->values[tm->eval_index].name,
-		    eval->qid,
-		    eval->values[tm->eval_index].value);
-	else 
-	    printf ("%-22s\t%s\t%ld\n",
-		    eval->values[tm->eval_index].name,
-		    eval->qid,
-		    (long) eval->values[tm->eval_index].value);
+	    return (te_output_float (epi, eval->values[tm->eval_index].name,
+				     eval->qid,
+				     eval->values[tm->eval_index].value));
+	return (te_output_long (epi, eval->values[tm->eval_index].name,
+				eval->qid,
+				(long) eval->values[tm->eval_index].value));
     }
     return (1);
 }
@@ -77,15 +76,17 @@ te_print_final_meas_a_cut (const EPI *epi, TREC_MEAS *tm,
     long i;
 
     for (i = 0; i < tm->meas_params->num_params; i++) {
-	if (epi->summary_flag)
-	    printf ("%s%-22s\t%s\t%6.4f\n",
-		    epi->zscore_flag ? "Z": "",
-		    eval->values[tm->eval_index + i].name,
-		    eval->qid,
-		    eval->values[tm->eval_index + i].value);
-	Free (eval->values[tm->eval_index + i].name);
+	if (epi->summary_flag &&
+	    (UNDEF == te_output_float (epi,
+				       eval->values[tm->eval_index + i].name,
+				       eval->qid,
+				       eval->values[tm->eval_index + i].value) ||
+	     UNDEF == print_ci (epi, eval, tm->eval_index + i)))
+	    return (UNDEF);
+	if (epi->num_runs <= 1)
+	    Free (eval->values[tm->eval_index + i].name);
     }
-    if (tm->meas_params->printable_params) {
+    if (tm->meas_params->printable_params && epi->num_runs <= 1) {
 	Free (tm->meas_params->param_values);
 	Free (tm->meas_params->printable_params);
     }
@@ -98,16 +99,50 @@ int
 te_print_final_meas_s_float_p (const EPI *epi, TREC_MEAS *tm,
 			       TREC_EVAL *eval)
 {
-    if (epi->summary_flag)
-	printf ("%s%-22s\t%s\t%6.4f\n",
-		epi->zscore_flag ? "Z": "",
-		eval->values[tm->eval_index].name,
-		eval->qid,
-		eval->values[tm->eval_index].value);
-    if (tm->meas_params->printable_params) {
+    if (epi->summary_flag &&
+	(UNDEF == te_output_float (epi, eval->values[tm->eval_index].name,
+				   eval->qid,
+				   eval->values[tm->eval_index].value) ||
+	 UNDEF == print_ci (epi, eval, tm->eval_index)))
+	return (UNDEF);
+    if (tm->meas_params->printable_params && epi->num_runs <= 1) {
 	Free (eval->values[tm->eval_index].name);
 	Free (tm->meas_params->printable_params);
 	Free (tm->meas_params->param_values);
     }
     return (1);
 }
+
+/* Print the bootstrap confidence intervals of value index (if any; see
+   bootstrap.c) after its summary line, as the summary values of
+   measure_ci95 */
+static int
+print_ci (const EPI *epi, const TREC_EVAL *eval, long index)
+{
+    static char *fields[] = {"percentile_low", "percentile_high",
+			     "bca_low", "bca_high"};
+    OUT_LINE line;
+    char *name;
+    long i;
+    int status;
+
+    if (epi->summary_ci == NULL || isnan (epi->summary_ci[4 * index]))
+	return (1);
+    if (NULL == (name = Malloc (strlen (eval->values[index].name) + 6,
+				char)))
+	return (UNDEF);
+    (void) sprintf (name, "%s_ci95", eval->values[index].name);
+    line.prefix = epi->zscore_flag ? "Z": "";
+    line.name = name;
+    line.key_field = "qid";
+    line.key = "all";
+    line.num_values = 4;
+    for (i = 0; i < 4; i++) {
+	line.values[i].field = fields[i];
+	line.values[i].type = OUT_FLOAT;
+	line.values[i].value = epi->summary_ci[4 * index + i];
+    }
+    status = te_output_line (epi, &line);
+    Free (name);
+    return (status);
+}
@@ -40,17 +40,8 @@ int
 te_print_single_meas_s_float (const EPI *epi, const TREC_MEAS *tm,
 			      const TREC_EVAL *eval)
 {
-    if (epi->zscore_flag)
-	printf ("Z%-22s\t%s\t%6.4f\n",
-		eval->values[tm->eval_index].name,
-		eval->qid,
-		eval->values[tm->eval_index].value);
-    else 
-	printf ("%-22s\t%s\t%6.4f\n",
-		eval->values[tm->eval_index].name,
-		eval->qid,
-		eval->values[tm->eval_index].value);
-    return (1);
+    return (te_output_float (epi, eval->values[tm->eval_index].name,
+			     eval->qid, eval->values[tm->eval_index].value));
 }
 
 /* Measure is a single long measure with no parameters. */
@@ -59,16 +50,12 @@ te_print_single_meas_s_long (const EPI *epi, const TREC_MEAS *tm,
 			     const TREC_EVAL *eval)
 {
     if (epi->zscore_flag)
-	printf ("Z%-22s\t%s\t%6.4f\n",
-		eval->values[tm->eval_index].name,
-		eval->qid,
-		eval->values[tm->eval_index].value);
-    else 
-	printf ("%-22s\t%s\t%ld\n",
-		eval->values[tm->eval_index].name,
-		eval->qid,
-		(long) eval->values[tm->eval_index].value);
-    return (1);
+	return (te_output_float (epi, eval->values[tm->eval_index].name,
+				 eval->qid,
+				 eval->values[tm->eval_index].value));
+    return (te_output_long (epi, eval->values[tm->eval_index].name,
+			    eval->qid,
+			    (long) eval->values[tm->eval_index].value));
 }
 
 /* Measure is a float array with cutoffs */
@@ -78,16 +65,10 @@ te_print_single_meas_a_cut (const EPI *epi, const TREC_MEAS *tm,
 {
     long i;
     for (i = 0; i < tm->meas_params->num_params; i++) {
-	if (epi->zscore_flag)
-	    printf ("Z%-22s\t%s\t%6.4f\n",
-		    eval->values[tm->eval_index+i].name,
-		    eval->qid,
-		    eval->values[tm->eval_index+i].value);
-	else 
-	    printf ("%-22s\t%s\t%6.4f\n",
-		    eval->values[tm->eval_index+i].name,
-		    eval->qid,
-		    eval->values[tm->eval_index+i].value);
+	if (UNDEF == te_output_float (epi, eval->values[tm->eval_index+i].name,
+				      eval->qid,
+				      eval->values[tm->eval_index+i].value))
+	    return (UNDEF);
     }
     return (1);
 }
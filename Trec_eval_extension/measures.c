@@ -119,6 +119,10 @@ extern TREC_MEAS te_meas_cam_map;
 extern TREC_MEAS te_meas_cam_map_three;
 extern TREC_MEAS te_meas_nwcs;
 extern TREC_MEAS te_meas_nwcs_three;
+extern TREC_MEAS te_meas_cam_multi;
+extern TREC_MEAS te_meas_cam_map_multi;
+extern TREC_MEAS te_meas_nlre_multi;
+extern TREC_MEAS te_meas_nwcs_multi;
 
 TREC_MEAS *te_trec_measures[] = {
     &te_meas_runid,
@@ -180,8 +184,12 @@ TREC_MEAS *te_trec_measures[] = {
     &te_meas_cam_map_three, //Added by Lucas
     &te_meas_nwcs, // Added by Lucas
     &te_meas_nwcs_three, //Added by Lucas
+    &te_meas_nlre_multi,
+    &te_meas_cam_multi,
+    &te_meas_cam_map_multi,
+    &te_meas_nwcs_multi,
 };
-int te_num_trec_measures = sizeof (te_trec_measures) / sizeof (te_trec_measures[0]);
+long te_num_trec_measures = sizeof (te_trec_measures) / sizeof (te_trec_measures[0]);
 
 static char *off_names[] =  {
     "runid", "num_q", "num_ret", "num_rel", "num_rel_ret", "map", "gm_map", 
@@ -227,6 +235,10 @@ static char *qrels_threeaspects_names[] =  {
     "runid","num_q", "nlre_three", "cam_three_ndcg","cam_map_three","nwcs_three",
     NULL}; 
 
+static char *qrels_multiaspect_names[] =  {
+    "runid", "num_q", "nlre_multi", "cam_multi", "cam_map_multi", "nwcs_multi",
+    NULL};
+
 
 TREC_MEASURE_NICKNAMES te_trec_measure_nicknames[] = {
     {"official", off_names},
@@ -237,6 +249,7 @@ TREC_MEASURE_NICKNAMES te_trec_measure_nicknames[] = {
     {"qrels_jg", qrels_jg_names},
     {"twoaspects", qrels_cred_names},
     {"threeaspects", qrels_threeaspects_names},
+    {"multiaspect", qrels_multiaspect_names},
 };
-int te_num_trec_measure_nicknames =
+long te_num_trec_measure_nicknames =
     sizeof (te_trec_measure_nicknames) / sizeof (te_trec_measure_nicknames[0]);
@@ -0,0 +1,795 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Output of measure values.  The print procedures of the measures (see
+   meas_print_single.c and meas_print_final.c) give each line of output
+   to te_output_line (or te_output_float, ... for lines of one value),
+   which formats it in the output format of epi->output_format into a
+   large buffer.  The buffer is written to stdout by te_output_flush (or
+   whenever it fills up), after each query and summary, so that output
+   is in the same order as anything else written to stdout.
+   Floats and longs are formatted here rather than by printf, but the
+   'text' format is exactly what printf ("%s%-22s\t%s\t%6.4f\n", ...)
+   gave.  Lines are only ever output by the main thread (see
+   eval_run.c), so the buffer is not per thread.
+   The structured formats ('jsonl', 'csv', 'csv_wide') identify each
+   value by runid (epi->run_id), qid and measure.  'csv_wide' puts the
+   lines of a query (up to the next flush) in one row, with a column for
+   each value of init_eval (see te_output_start), written as the lines
+   come since they come in the order of the values.
+*/
+
+static long put_text (const OUT_LINE *line, char *buf);
+static long put_tsv (const OUT_LINE *line, char *buf);
+static long put_jsonl (const OUT_LINE *line, char *buf);
+static long put_binary (const OUT_LINE *line, char *buf);
+static int start_csv (const EPI *epi, const TREC_EVAL *init_eval);
+static long put_csv (const OUT_LINE *line, char *buf);
+static int start_csv_wide (const EPI *epi, const TREC_EVAL *init_eval);
+static long put_csv_wide (const OUT_LINE *line, char *buf);
+static long end_csv_wide_row (char *buf);
+static const char *line_run_id (const OUT_LINE *line);
+static const char *line_qid (const OUT_LINE *line);
+static long put_padded (char *buf, const char *string, long width);
+static long put_float (char *buf, double value, long width);
+static long put_long (char *buf, long value);
+static long put_json_string (char *buf, const char *string);
+static long put_csv_field (char *buf, const char *string);
+static long put_csv_measure (char *buf, const OUT_LINE *line,
+			     const char *field);
+static long put_csv_chars (char *buf, const char *string);
+static void free_columns ();
+static int write_buf ();
+static const OUTPUT_FORMAT *get_format (const EPI *epi);
+
+OUTPUT_FORMAT te_output_format[] = {
+    {"text",
+"Output format: 'text'\n\
+Each line is \n\
+   measure  qid  value \n\
+with the measure name padded to 22 characters, and fields separated by \n\
+tabs.  qid is 'all' for the summary values.  Floats are printed with 4 \n\
+decimals. \n",
+     NULL, put_text, NULL},
+    {"tsv",
+"Output format: 'tsv'\n\
+As 'text', without the padding of measure names. \n",
+     NULL, put_tsv, NULL},
+    {"jsonl",
+"Output format: 'jsonl'\n\
+Each line is a JSON object, a record per runid, qid and measure \n\
+   {\"runid\":\"STANDARD\",\"qid\":\"301\",\"measure\":\"map\",\"value\":0.2000} \n\
+Values are named as in the description of the line in the trec_eval help \n\
+(eg, \"percentile_low\" for the -B confidence intervals), or \"value\" if \n\
+there is just one.  qid is 'all' for the summary values, and for the -P \n\
+comparisons (whose runid is that of the candidate run).  Floats are \n\
+printed with 4 decimals (null for NaN). \n",
+     NULL, put_jsonl, NULL},
+    {"binary",
+"Output format: 'binary'\n\
+Each line is \n\
+   measure  qid  num_values  {type  value}* \n\
+where measure and qid are NULL terminated strings, num_values and each \n\
+type (0 float, 1 integer, 2 or 3 string) are one byte, and a value is an \n\
+8 byte double or integer (in the byte order of the machine) or a NULL \n\
+terminated string. \n",
+     NULL, put_binary, NULL},
+    {"csv",
+"Output format: 'csv'\n\
+Comma separated values, after a header line, a record per runid, qid and \n\
+measure \n\
+   runid,qid,measure,value \n\
+quoted as in RFC 4180 where needed.  Lines of several values (eg, the -B \n\
+confidence intervals) give a record for each, with measure \n\
+'measure:value_name' (eg, 'map_ci95:percentile_low').  qid is as for \n\
+'jsonl'. \n\
+Floats are printed with 4 decimals (empty for NaN). \n",
+     start_csv, put_csv, NULL},
+    {"csv_wide",
+"Output format: 'csv_wide'\n\
+Comma separated values, a row per runid and qid \n\
+   runid,qid,value_1,...,value_n \n\
+with a column for each measure value requested, named in a header line. \n\
+A value not printed for a query (eg, gm_map with -q) is empty.  Cannot be \n\
+used with -B or -P. \n",
+     start_csv_wide, put_csv_wide, end_csv_wide_row},
+};
+long te_num_output_format =
+    sizeof (te_output_format) / sizeof (te_output_format[0]);
+
+#define OUT_BUF_SIZE (1 << 16)
+/* Longest formatted float (printf of %.4f of the largest double) */
+#define MAX_FLOAT_LEN 320
+
+static char *out_buf = NULL;
+static long max_out_buf = 0;
+static long out_len = 0;
+
+/* Format of the last line output */
+static const char *format_name = NULL;
+static const OUTPUT_FORMAT *format;
+/* epi->run_id of the line being output */
+static const char *run_id;
+
+/* Header line, written before the first line output after
+   te_output_start */
+static char *header = NULL;
+static long header_len = 0;
+/* Columns of 'csv_wide', and the row being output: its qid (NULL if no
+   row has been started since the last flush), and the next column */
+static char **columns = NULL;
+static char *column_names = NULL;
+static long num_columns = 0;
+static char *row_qid = NULL;
+static char *row_qid_buf = NULL;
+static long max_row_qid_buf = 0;
+static long row_column;
+
+/* Output line in the format of epi->output_format.
+   Return UNDEF if error */
+int
+te_output_line (const EPI *epi, const OUT_LINE *line)
+{
+    long needed;
+    long i;
+
+    if (epi->output_format != format_name &&
+	NULL == get_format (epi))
+	return (UNDEF);
+
+    /* Upper bound of the formatted length of line (strings may be
+       escaped as up to 6 characters each) */
+    needed = strlen (line->prefix) + strlen (line->name) +
+	strlen (line->key_field) + strlen (line->key) + 64;
+    if (epi->run_id != NULL)
+	needed += strlen (epi->run_id);
+    for (i = 0; i < line->num_values; i++) {
+	needed += strlen (line->values[i].field) + 16;
+	if (line->values[i].type == OUT_STRING ||
+	    line->values[i].type == OUT_QUOTED)
+	    needed += strlen (line->values[i].string);
+	else
+	    needed += MAX_FLOAT_LEN;
+    }
+    needed = 6 * needed * MAX (line->num_values, 1) + header_len +
+	2 * num_columns;
+
+    if (out_len + needed > max_out_buf) {
+	if (UNDEF == write_buf ())
+	    return (UNDEF);
+	if (needed > max_out_buf &&
+	    NULL == (out_buf = te_chk_and_malloc (out_buf, &max_out_buf,
+						  MAX (needed, OUT_BUF_SIZE),
+						  sizeof (char))))
+	    return (UNDEF);
+    }
+    if (header_len > 0) {
+	(void) memcpy (&out_buf[out_len], header, header_len);
+	out_len += header_len;
+	header_len = 0;
+    }
+    run_id = epi->run_id != NULL ? epi->run_id : "";
+    out_len += format->put_line (line, &out_buf[out_len]);
+    return (1);
+}
+
+/* Start the output of runs evaluated with the values of init_eval, in
+   the format of epi->output_format (giving any header line it has).
+   Return UNDEF if error */
+int
+te_output_start (const EPI *epi, const TREC_EVAL *init_eval)
+{
+    if (UNDEF == te_output_flush ())
+	return (UNDEF);
+    free_columns ();
+    header_len = 0;
+    if (NULL == get_format (epi))
+	return (UNDEF);
+    if (format->start != NULL)
+	return (format->start (epi, init_eval));
+    return (1);
+}
+
+/* Output the float value of measure value name for qid, as a zscore if
+   epi->zscore_flag */
+int
+te_output_float (const EPI *epi, const char *name, const char *qid,
+		 double value)
+{
+    OUT_LINE line;
+
+    line.prefix = epi->zscore_flag ? "Z" : "";
+    line.name = name;
+    line.key_field = "qid";
+    line.key = qid;
+    line.num_values = 1;
+    line.values[0].field = "value";
+    line.values[0].type = OUT_FLOAT;
+    line.values[0].value = value;
+    return (te_output_line (epi, &line));
+}
+
+/* Output the integer value of measure value name for qid */
+int
+te_output_long (const EPI *epi, const char *name, const char *qid,
+		long value)
+{
+    OUT_LINE line;
+
+    line.prefix = "";
+    line.name = name;
+    line.key_field = "qid";
+    line.key = qid;
+    line.num_values = 1;
+    line.values[0].field = "value";
+    line.values[0].type = OUT_LONG;
+    line.values[0].value = (double) value;
+    return (te_output_line (epi, &line));
+}
+
+/* Output the string value (of type OUT_STRING or OUT_QUOTED) of measure
+   value name for qid */
+int
+te_output_string (const EPI *epi, const char *name, const char *qid,
+		  long type, const char *string)
+{
+    OUT_LINE line;
+
+    line.prefix = "";
+    line.name = name;
+    line.key_field = "qid";
+    line.key = qid;
+    line.num_values = 1;
+    line.values[0].field = "value";
+    line.values[0].type = type;
+    line.values[0].string = string;
+    return (te_output_line (epi, &line));
+}
+
+/* Write the lines output so far to stdout, ending any csv_wide row (for
+   which te_output_line always leaves room).  Return UNDEF if error */
+int
+te_output_flush ()
+{
+    if (row_qid != NULL)
+	out_len += format->end_row (&out_buf[out_len]);
+    return (write_buf ());
+}
+
+static int
+write_buf ()
+{
+    if (out_len > 0 &&
+	out_len != (long) fwrite (out_buf, 1, out_len, stdout)) {
+	out_len = 0;
+	return (UNDEF);
+    }
+    out_len = 0;
+    return (1);
+}
+
+int
+te_output_cleanup ()
+{
+    if (UNDEF == te_output_flush ())
+	return (UNDEF);
+    if (max_out_buf > 0) {
+	Free (out_buf);
+	out_buf = NULL;
+	max_out_buf = 0;
+    }
+    free_columns ();
+    header_len = 0;
+    return (1);
+}
+
+static void
+free_columns ()
+{
+    if (columns != NULL) {
+	Free (columns);
+	Free (column_names);
+	columns = NULL;
+	num_columns = 0;
+    }
+    if (header != NULL) {
+	Free (header);
+	header = NULL;
+    }
+    if (max_row_qid_buf > 0) {
+	Free (row_qid_buf);
+	row_qid_buf = NULL;
+	max_row_qid_buf = 0;
+    }
+    row_qid = NULL;
+}
+
+static const OUTPUT_FORMAT *
+get_format (const EPI *epi)
+{
+    long i;
+
+    for (i = 0; i < te_num_output_format; i++) {
+	if (0 == strcmp (epi->output_format, te_output_format[i].name)) {
+	    format_name = epi->output_format;
+	    format = &te_output_format[i];
+	    return (format);
+	}
+    }
+    fprintf (stderr, "trec_eval.output: Illegal output format '%s'\n",
+	     epi->output_format);
+    return (NULL);
+}
+
+/* ---------------- Output formats -------------- */
+
+static long
+put_text (const OUT_LINE *line, char *buf)
+{
+    char *ptr = buf;
+    long i;
+
+    ptr += put_padded (ptr, line->prefix, 0);
+    ptr += put_padded (ptr, line->name, 22);
+    *ptr++ = '\t';
+    ptr += put_padded (ptr, line->key, 0);
+    for (i = 0; i < line->num_values; i++) {
+	*ptr++ = '\t';
+	switch (line->values[i].type) {
+	case OUT_FLOAT:
+	    ptr += put_float (ptr, line->values[i].value, 6);
+	    break;
+	case OUT_LONG:
+	    ptr += put_long (ptr, (long) line->values[i].value);
+	    break;
+	case OUT_QUOTED:
+	    *ptr++ = '\'';
+	    ptr += put_padded (ptr, line->values[i].string, 0);
+	    *ptr++ = '\'';
+	    break;
+	default:
+	    ptr += put_padded (ptr, line->values[i].string, 0);
+	    break;
+	}
+    }
+    *ptr++ = '\n';
+    return (ptr - buf);
+}
+
+static long
+put_tsv (const OUT_LINE *line, char *buf)
+{
+    char *ptr = buf;
+    long i;
+
+    ptr += put_padded (ptr, line->prefix, 0);
+    ptr += put_padded (ptr, line->name, 0);
+    *ptr++ = '\t';
+    ptr += put_padded (ptr, line->key, 0);
+    for (i = 0; i < line->num_values; i++) {
+	*ptr++ = '\t';
+	switch (line->values[i].type) {
+	case OUT_FLOAT:
+	    ptr += put_float (ptr, line->values[i].value, 0);
+	    break;
+	case OUT_LONG:
+	    ptr += put_long (ptr, (long) line->values[i].value);
+	    break;
+	default:
+	    ptr += put_padded (ptr, line->values[i].string, 0);
+	    break;
+	}
+    }
+    *ptr++ = '\n';
+    return (ptr - buf);
+}
+
+static long
+put_jsonl (const OUT_LINE *line, char *buf)
+{
+    char *ptr = buf;
+    long i;
+
+    ptr += put_padded (ptr, "{\"runid\":\"", 0);
+    ptr += put_json_string (ptr, line_run_id (line));
+    ptr += put_padded (ptr, "\",\"qid\":\"", 0);
+    ptr += put_json_string (ptr, line_qid (line));
+    ptr += put_padded (ptr, "\",\"measure\":\"", 0);
+    ptr += put_json_string (ptr, line->prefix);
+    ptr += put_json_string (ptr, line->name);
+    *ptr++ = '"';
+    for (i = 0; i < line->num_values; i++) {
+	ptr += put_padded (ptr, ",\"", 0);
+	ptr += put_json_string (ptr, line->values[i].field);
+	ptr += put_padded (ptr, "\":", 0);
+	switch (line->values[i].type) {
+	case OUT_FLOAT:
+	    if (isfinite (line->values[i].value))
+		ptr += put_float (ptr, line->values[i].value, 0);
+	    else
+		ptr += put_padded (ptr, "null", 0);
+	    break;
+	case OUT_LONG:
+	    ptr += put_long (ptr, (long) line->values[i].value);
+	    break;
+	default:
+	    *ptr++ = '"';
+	    ptr += put_json_string (ptr, line->values[i].string);
+	    *ptr++ = '"';
+	    break;
+	}
+    }
+    ptr += put_padded (ptr, "}\n", 0);
+    return (ptr - buf);
+}
+
+static long
+put_binary (const OUT_LINE *line, char *buf)
+{
+    char *ptr = buf;
+    int64_t l;
+    long i;
+
+    ptr += put_padded (ptr, line->prefix, 0);
+    ptr += put_padded (ptr, line->name, 0);
+    *ptr++ = '\0';
+    ptr += put_padded (ptr, line->key, 0);
+    *ptr++ = '\0';
+    *ptr++ = (char) line->num_values;
+    for (i = 0; i < line->num_values; i++) {
+	*ptr++ = (char) line->values[i].type;
+	switch (line->values[i].type) {
+	case OUT_FLOAT:
+	    (void) memcpy (ptr, &line->values[i].value, sizeof (double));
+	    ptr += sizeof (double);
+	    break;
+	case OUT_LONG:
+	    l = (int64_t) line->values[i].value;
+	    (void) memcpy (ptr, &l, sizeof (int64_t));
+	    ptr += sizeof (int64_t);
+	    break;
+	default:
+	    ptr += put_padded (ptr, line->values[i].string, 0);
+	    *ptr++ = '\0';
+	    break;
+	}
+    }
+    return (ptr - buf);
+}
+
+static int
+start_csv (const EPI *epi, const TREC_EVAL *init_eval)
+{
+    static char csv_header[] = "runid,qid,measure,value\n";
+
+    if (NULL == (header = Malloc (sizeof (csv_header), char)))
+	return (UNDEF);
+    (void) strcpy (header, csv_header);
+    header_len = strlen (header);
+    return (1);
+}
+
+static long
+put_csv (const OUT_LINE *line, char *buf)
+{
+    char *ptr = buf;
+    long i;
+
+    for (i = 0; i < line->num_values; i++) {
+	ptr += put_csv_field (ptr, line_run_id (line));
+	*ptr++ = ',';
+	ptr += put_csv_field (ptr, line_qid (line));
+	*ptr++ = ',';
+	ptr += put_csv_measure (ptr, line, line->num_values > 1 ?
+				line->values[i].field : NULL);
+	*ptr++ = ',';
+	switch (line->values[i].type) {
+	case OUT_FLOAT:
+	    if (isfinite (line->values[i].value))
+		ptr += put_float (ptr, line->values[i].value, 0);
+	    break;
+	case OUT_LONG:
+	    ptr += put_long (ptr, (long) line->values[i].value);
+	    break;
+	default:
+	    ptr += put_csv_field (ptr, line->values[i].string);
+	    break;
+	}
+	*ptr++ = '\n';
+    }
+    return (ptr - buf);
+}
+
+/* Columns are the values of init_eval, named without any Z prefix of
+   -Z (the whole row has it) */
+static int
+start_csv_wide (const EPI *epi, const TREC_EVAL *init_eval)
+{
+    long size, i;
+    char *ptr;
+
+    size = 0;
+    for (i = 0; i < init_eval->num_values; i++)
+	size += strlen (init_eval->values[i].name) + 1;
+    if (NULL == (columns = Malloc (init_eval->num_values + 1, char *)) ||
+	NULL == (column_names = Malloc (size + 1, char)) ||
+	NULL == (header = Malloc (2 * size + 32, char)))
+	return (UNDEF);
+    num_columns = init_eval->num_values;
+
+    ptr = column_names;
+    for (i = 0; i < num_columns; i++) {
+	columns[i] = ptr;
+	ptr += put_padded (ptr, init_eval->values[i].name, 0);
+	*ptr++ = '\0';
+    }
+    ptr = header;
+    ptr += put_padded (ptr, "runid,qid", 0);
+    for (i = 0; i < num_columns; i++) {
+	*ptr++ = ',';
+	ptr += put_csv_field (ptr, columns[i]);
+    }
+    *ptr++ = '\n';
+    header_len = ptr - header;
+    return (1);
+}
+
+/* Add the value of line to the row of its qid, after empty values for
+   any columns skipped.  A line of a value that is not a column (eg, the
+   runid), or out of order, is left out */
+static long
+put_csv_wide (const OUT_LINE *line, char *buf)
+{
+    char *ptr = buf;
+    const char *qid = line_qid (line);
+    long i;
+
+    if (line->num_values != 1)
+	return (0);
+    if (row_qid != NULL && strcmp (row_qid, qid))
+	ptr += end_csv_wide_row (ptr);
+    if (row_qid == NULL) {
+	if (NULL == (row_qid_buf = te_chk_and_malloc (row_qid_buf,
+						      &max_row_qid_buf,
+						      strlen (qid) + 1,
+						      sizeof (char))))
+	    return (ptr - buf);
+	row_qid = strcpy (row_qid_buf, qid);
+	row_column = 0;
+	ptr += put_csv_field (ptr, line_run_id (line));
+	*ptr++ = ',';
+	ptr += put_csv_field (ptr, qid);
+    }
+
+    for (i = row_column; i < num_columns; i++) {
+	if (0 == strcmp (columns[i], line->name))
+	    break;
+    }
+    if (i >= num_columns)
+	return (ptr - buf);
+    for (; row_column <= i; row_column++)
+	*ptr++ = ',';
+
+    switch (line->values[0].type) {
+    case OUT_FLOAT:
+	if (isfinite (line->values[0].value))
+	    ptr += put_float (ptr, line->values[0].value, 0);
+	break;
+    case OUT_LONG:
+	ptr += put_long (ptr, (long) line->values[0].value);
+	break;
+    default:
+	ptr += put_csv_field (ptr, line->values[0].string);
+	break;
+    }
+    return (ptr - buf);
+}
+
+/* Empty values for the rest of the columns of the row, and end it */
+static long
+end_csv_wide_row (char *buf)
+{
+    char *ptr = buf;
+
+    if (row_qid == NULL)
+	return (0);
+    for (; row_column < num_columns; row_column++)
+	*ptr++ = ',';
+    *ptr++ = '\n';
+    row_qid = NULL;
+    return (ptr - buf);
+}
+
+/* The runid and qid a line is about.  Lines with a runid as key (-P)
+   are about all queries */
+static const char *
+line_run_id (const OUT_LINE *line)
+{
+    if (0 == strcmp (line->key_field, "runid"))
+	return (line->key);
+    return (run_id);
+}
+
+static const char *
+line_qid (const OUT_LINE *line)
+{
+    if (0 == strcmp (line->key_field, "runid"))
+	return ("all");
+    return (line->key);
+}
+
+/* ---------------- Formatting of fields -------------- */
+
+/* string, padded with blanks on the right to width (as %-<width>s) */
+static long
+put_padded (char *buf, const char *string, long width)
+{
+    long len = strlen (string);
+
+    (void) memcpy (buf, string, len);
+    if (len < width) {
+	(void) memset (&buf[len], ' ', width - len);
+	len = width;
+    }
+    return (len);
+}
+
+/* value with 4 decimals, padded with blanks on the left to width.
+   Exactly as printf %<width>.4f: the decimal value of the double
+   rounded to the nearest multiple of 0.0001, ties to even.  The scaled
+   value can only round the wrong way very close to a tie, and then the
+   exact difference from the tie is found with fma */
+static long
+put_float (char *buf, double value, long width)
+{
+    char digits[32];
+    double abs_value, scaled, frac;
+    unsigned long long n;
+    long len, i;
+
+    abs_value = fabs (value);
+    if (! (abs_value < 1e11)) {
+	/* NaN, inf, and values too large to scale exactly */
+	len = sprintf (buf, "%*.4f", (int) width, value);
+	return (len);
+    }
+
+    scaled = abs_value * 10000.0;
+    n = (unsigned long long) scaled;
+    frac = scaled - (double) n;
+    if (fabs (frac - 0.5) > scaled * 4e-16) {
+	if (frac > 0.5)
+	    n++;
+    }
+    else {
+	frac = fma (abs_value, 10000.0, -((double) n + 0.5));
+	if (frac > 0.0 || (frac == 0.0 && (n & 1)))
+	    n++;
+    }
+
+    /* Digits, least significant first */
+    len = 0;
+    for (i = 0; i < 4; i++) {
+	digits[len++] = '0' + n % 10;
+	n /= 10;
+    }
+    digits[len++] = '.';
+    do {
+	digits[len++] = '0' + n % 10;
+	n /= 10;
+    } while (n > 0);
+    if (signbit (value))
+	digits[len++] = '-';
+
+    i = 0;
+    while (len + i < width)
+	buf[i++] = ' ';
+    while (len > 0)
+	buf[i++] = digits[--len];
+    return (i);
+}
+
+/* value as printf %ld */
+static long
+put_long (char *buf, long value)
+{
+    char digits[32];
+    unsigned long n;
+    long len = 0, i = 0;
+
+    n = value < 0 ? - (unsigned long) value : (unsigned long) value;
+    do {
+	digits[len++] = '0' + n % 10;
+	n /= 10;
+    } while (n > 0);
+    if (value < 0)
+	buf[i++] = '-';
+    while (len > 0)
+	buf[i++] = digits[--len];
+    return (i);
+}
+
+/* string, escaped for a JSON string (without the quotes) */
+static long
+put_json_string (char *buf, const char *string)
+{
+    const unsigned char *ptr = (const unsigned char *) string;
+    long len = 0;
+
+    for (; *ptr; ptr++) {
+	if (*ptr == '"' || *ptr == '\\') {
+	    buf[len++] = '\\';
+	    buf[len++] = *ptr;
+	}
+	else if (*ptr < 0x20)
+	    len += sprintf (&buf[len], "\\u%04x", *ptr);
+	else
+	    buf[len++] = *ptr;
+    }
+    return (len);
+}
+
+/* Characters that make a csv field be quoted */
+#define CSV_QUOTED ",\"\n\r"
+
+/* string as a csv field, in quotes (doubled within it) if it contains a
+   comma, quote or line break */
+static long
+put_csv_field (char *buf, const char *string)
+{
+    char *ptr = buf;
+
+    if (NULL == strpbrk (string, CSV_QUOTED))
+	return (put_padded (buf, string, 0));
+    *ptr++ = '"';
+    ptr += put_csv_chars (ptr, string);
+    *ptr++ = '"';
+    return (ptr - buf);
+}
+
+/* Measure name of line (with its prefix, and ':' field if field is
+   non-NULL) as a csv field, quoted as by put_csv_field */
+static long
+put_csv_measure (char *buf, const OUT_LINE *line, const char *field)
+{
+    char *ptr = buf;
+    int quote;
+
+    quote = (NULL != strpbrk (line->prefix, CSV_QUOTED) ||
+	     NULL != strpbrk (line->name, CSV_QUOTED) ||
+	     (field != NULL && NULL != strpbrk (field, CSV_QUOTED)));
+    if (quote)
+	*ptr++ = '"';
+    ptr += put_csv_chars (ptr, line->prefix);
+    ptr += put_csv_chars (ptr, line->name);
+    if (field != NULL) {
+	*ptr++ = ':';
+	ptr += put_csv_chars (ptr, field);
+    }
+    if (quote)
+	*ptr++ = '"';
+    return (ptr - buf);
+}
+
+/* string within quotes of a csv field, with its quotes doubled */
+static long
+put_csv_chars (char *buf, const char *string)
+{
+    long len = 0;
+
+    for (; *string; string++) {
+	if (*string == '"')
+	    buf[len++] = '"';
+	buf[len++] = *string;
+    }
+    return (len);
+}
@@ -0,0 +1,198 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Write the per query values of each run evaluated to a 'values_bin' file
+(trec_eval -W), so they can be analysed without parsing the -q output.
+The file is
+     BIN_HEADER
+     int64_t         qids[num_queries]          offsets into strings
+     int64_t         names[num_values]          offsets into strings
+     double          values[num_runs][num_values][num_queries]
+     int64_t         run_ids[num_runs]          offsets into strings
+     char            strings[]                  NULL terminated qids,
+						names and run_ids
+     '\n'
+all in the byte order of the machine that wrote it (checked by the
+byte_order field).  Queries are all those of the rel_info file, in qid
+order, and names are those of the individual measure values, in the order
+printed.  Each (run, value) is one contiguous column of num_queries
+doubles, starting at a fixed offset, so a reader can map the file and use
+any column in place (eg, as an Arrow or numpy array of float64).  A query
+that was not evaluated for a run (no results, even with -c) has the value
+NaN.  Values are those accumulated over queries, so the values of gm_map
+and gm_bpref are logs.  Columns are written as each run is evaluated, so
+only one run need be held in memory; run_ids, only known once a run has
+been evaluated, follow them.
+*/
+
+#define BIN_MAGIC "TRECVAL"
+#define BIN_BYTE_ORDER 0x01020304
+#define BIN_VERSION 1
+
+typedef struct {
+    char magic[8];                  /* BIN_MAGIC */
+    int32_t byte_order;             /* BIN_BYTE_ORDER */
+    int32_t version;                /* BIN_VERSION */
+    int64_t num_queries;
+    int64_t num_values;
+    int64_t num_runs;
+} BIN_HEADER;
+
+/* State of the file being written, between te_put_values_bin_start and
+   te_put_values_bin_end */
+static FILE *values_fp = NULL;
+static const char *values_file_name;
+static char *values_strings = NULL;   /* qids and names, copied since
+					 names may be freed by the
+					 measures after a run */
+static long values_strings_size;
+static long values_num_runs;
+static long values_runs_put;
+static char **values_run_ids = NULL;
+static double *column = NULL;
+static long max_column = 0;
+
+/* Create values_file, and write everything that comes before the values
+   of the num_runs runs to be evaluated against all_rel_info with the
+   values of init_eval.  Return UNDEF if error */
+int
+te_put_values_bin_start (const char *values_file,
+			 const ALL_REL_INFO *all_rel_info,
+			 const TREC_EVAL *init_eval, long num_runs)
+{
+    BIN_HEADER header;
+    int64_t offset;
+    long i, len;
+
+    if (NULL == (values_fp = fopen (values_file, "w"))) {
+	fprintf (stderr, "trec_eval.put_values_bin: Cannot create '%s'\n",
+		 values_file);
+	return (UNDEF);
+    }
+    if (NULL == (values_run_ids = Malloc (num_runs + 1, char *)))
+	return (UNDEF);
+    values_file_name = values_file;
+    values_num_runs = num_runs;
+    values_runs_put = 0;
+    if (NULL == (column = te_chk_and_malloc (column, &max_column,
+					     all_rel_info->num_q_rels + 1,
+					     sizeof (double))))
+	return (UNDEF);
+
+    (void) memset (&header, 0, sizeof (header));
+    (void) memcpy (header.magic, BIN_MAGIC, sizeof (header.magic));
+    header.byte_order = BIN_BYTE_ORDER;
+    header.version = BIN_VERSION;
+    header.num_queries = all_rel_info->num_q_rels;
+    header.num_values = init_eval->num_values;
+    header.num_runs = num_runs;
+    (void) fwrite (&header, sizeof (header), 1, values_fp);
+
+    /* qids, then names.  Their strings come first.  qids may be fields of
+       a mapped file, rather than NULL terminated */
+    values_strings_size = 0;
+    for (i = 0; i < all_rel_info->num_q_rels; i++)
+	values_strings_size += te_field_len (all_rel_info->rel_info[i].qid) + 1;
+    for (i = 0; i < init_eval->num_values; i++)
+	values_strings_size += strlen (init_eval->values[i].name) + 1;
+    if (NULL == (values_strings = Malloc (values_strings_size, char)))
+	return (UNDEF);
+    offset = 0;
+    for (i = 0; i < all_rel_info->num_q_rels; i++) {
+	(void) fwrite (&offset, sizeof (offset), 1, values_fp);
+	len = te_field_len (all_rel_info->rel_info[i].qid);
+	(void) memcpy (&values_strings[offset], all_rel_info->rel_info[i].qid,
+		       len);
+	values_strings[offset + len] = '\0';
+	offset += len + 1;
+    }
+    for (i = 0; i < init_eval->num_values; i++) {
+	(void) fwrite (&offset, sizeof (offset), 1, values_fp);
+	(void) strcpy (&values_strings[offset], init_eval->values[i].name);
+	offset += strlen (init_eval->values[i].name) + 1;
+    }
+    return (1);
+}
+
+/* Write the values of the next run, with NaN for queries not evaluated.
+   Return UNDEF if error */
+int
+te_put_values_bin_run (const RUN_VALUES *run_values)
+{
+    long num_queries = run_values->num_queries;
+    long v, q;
+
+    if (values_runs_put >= values_num_runs) {
+	fprintf (stderr, "trec_eval.put_values_bin: More than %ld runs\n",
+		 values_num_runs);
+	return (UNDEF);
+    }
+    for (v = 0; v < run_values->num_values; v++) {
+	for (q = 0; q < num_queries; q++)
+	    column[q] = run_values->evaluated[q] ?
+		run_values->values[v * num_queries + q] : NAN;
+	(void) fwrite (column, sizeof (double), num_queries, values_fp);
+    }
+    if (NULL == (values_run_ids[values_runs_put] =
+		 Malloc (strlen (run_values->run_id) + 1, char)))
+	return (UNDEF);
+    (void) strcpy (values_run_ids[values_runs_put], run_values->run_id);
+    values_runs_put++;
+    return (1);
+}
+
+/* Write the run_ids and strings, and close the file.  Return UNDEF if
+   error */
+int
+te_put_values_bin_end ()
+{
+    int64_t offset;
+    long i;
+    int status = 1;
+
+    if (values_runs_put != values_num_runs) {
+	fprintf (stderr, "trec_eval.put_values_bin: %ld runs, not %ld\n",
+		 values_runs_put, values_num_runs);
+	status = UNDEF;
+    }
+
+    /* run_ids, whose strings follow those of the names */
+    offset = values_strings_size;
+    for (i = 0; i < values_runs_put; i++) {
+	(void) fwrite (&offset, sizeof (offset), 1, values_fp);
+	offset += strlen (values_run_ids[i]) + 1;
+    }
+    /* Strings, then final newline */
+    (void) fwrite (values_strings, 1, values_strings_size, values_fp);
+    for (i = 0; i < values_runs_put; i++) {
+	(void) fwrite (values_run_ids[i], 1, strlen (values_run_ids[i]) + 1,
+		       values_fp);
+	Free (values_run_ids[i]);
+    }
+    (void) putc ('\n', values_fp);
+
+    if (ferror (values_fp) | fclose (values_fp)) {
+	fprintf (stderr, "trec_eval.put_values_bin: Cannot write '%s'\n",
+		 values_file_name);
+	status = UNDEF;
+    }
+    values_fp = NULL;
+    Free (values_run_ids);
+    values_run_ids = NULL;
+    Free (values_strings);
+    values_strings = NULL;
+    if (max_column > 0) {
+	Free (column);
+	max_column = 0;
+    }
+    return (status);
+}
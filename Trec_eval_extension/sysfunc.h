@@ -13,6 +13,7 @@
 
 #include <unistd.h>
 #include <limits.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -24,6 +25,12 @@
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <getopt.h>
 
@@ -9,10 +9,18 @@ static char *VersionID = VERSIONID;
 static char *help_message = 
 "trec_eval [-h] [-q] [-m measure[.params] [-c] [-n] [-l <num>]\n\
    [-D debug_level] [-N <num>] [-M <num>] [-R rel_format] [-T results_format]\n\
-   rel_info_file  results_file \n\
+   [-j <num>] [-G] [-P <num>] [-B <num>]\n\
+   rel_info_file  results_file [results_file ...] \n\
+trec_eval -S socket_path [options] rel_info_file [rel_info_file ...]\n\
+trec_eval -C binary_file [-T results_format] results_file\n\
+trec_eval -Q binary_file [-R rel_info_format] rel_info_file\n\
  \n\
 Calculate and print various evaluation measures, evaluating the results  \n\
 in results_file against the relevance info in rel_info_file. \n\
+If more than one results_file is given (a directory stands for all the \n\
+files in it), rel_info_file is read once and each results_file evaluated \n\
+against it in turn.  The runid measure is then added, and printed for \n\
+each query as well as in the summary, so output can be split by run. \n\
  \n\
 There are a fair number of options, of which only the lower case options are \n\
 normally ever used.   \n\
@@ -42,6 +50,8 @@ normally ever used.   \n\
        'prefs': Measures not in all_trec that calculate preference measures.\n\
        'twoaspects': Measures not in all_trec that calculate measures that consider two aspects.\n\
        'threeaspects': Measures not in all_trec that calculate measures that consider three aspects.\n\
+       'multiaspect': Measures not in all_trec that calculate measures that consider all aspects\n\
+                   of the rel_info, eg of 'qrels_multiaspect'.\n\
  --complete_rel_info_wanted:\n\
  -c: Average over the complete set of queries in the relevance judgements  \n\
      instead of the queries in the intersection of relevance judgements \n\
@@ -74,12 +84,12 @@ normally ever used.   \n\
      calculated  with the -J flag.  \n\
  --Rel_info_format format:\n\
  -R format: The rel_info file is assumed to be in format 'format'.  Current\n\
-    values for 'format' include 'qrels', 'prefs', 'qrels_prefs', 'qrels_twoaspects', 'qrels_threeaspects'.  Note not\n\
+    values for 'format' include 'qrels', 'prefs', 'qrels_prefs', 'qrels_twoaspects', 'qrels_threeaspects', 'qrels_multiaspect', 'qrels_bin'.  Note not\n\
     all measures can be calculated with all formats.\n\
  --Results_format format:\n\
  -T format: the top results_file is assumed to be in format 'format'. Current\n\
-    values for 'format' include 'trec_results'. Note not all measures can be\n\
-    calculated with all formats.\n\
+    values for 'format' include 'trec_results', 'trec_results_bin'. Note not\n\
+    all measures can be calculated with all formats.\n\
  --Zscore Zmean_file:\n\
  -Z Zmean_file: Instead of printing the raw score for each measure, print\n\
     a Z score instead. The score printed will be the deviation from the mean\n\
@@ -88,6 +98,73 @@ normally ever used.   \n\
     If mean is not in Zmeanfile for a measure and query, -1000000 is printed.\n\
     Zmean_file format is ascii lines of form \n\
        qid  measure_name  mean  std_dev\n\
+ --jobs num:\n\
+ -j <num>: Use up to num threads to parse and sort large input files, and to\n\
+    evaluate queries.  0 means one thread per processor.  Output is the same\n\
+    whatever num is. Default is 1.\n\
+ --Grouped_by_qid:\n\
+ -G: Stream mode.  Each results_file (in 'trec_results' format) has all the\n\
+    lines of each query together, as a run is normally written.  It is read\n\
+    a query at a time, and each query evaluated (and printed, if -q) as soon\n\
+    as its lines have been read, so that only one query is held in memory,\n\
+    however big the file.  Queries are printed in the order of the file.\n\
+    The runid is that of the last line of each query.  Default is off.\n\
+ --Paired_tests num:\n\
+ -P <num>: Compare runs.  The first results_file is the baseline, and each\n\
+    other results_file is compared with it, after all have been evaluated\n\
+    as usual.  For each measure value, the per query differences (the\n\
+    candidate's value minus the baseline's, on the queries evaluated for\n\
+    both) are tested with the paired t-test, the Wilcoxon signed-rank test\n\
+    and a randomization test of num random permutations (sign flips of the\n\
+    differences).  Permutations are done on up to -j threads, giving the\n\
+    same p-values whatever the number of threads.  A line\n\
+       measure  runid  num_queries  mean_diff  t_p  wilcoxon_p  random_p\n\
+    is printed for each candidate runid and measure value, with two-sided\n\
+    p-values.  Note the values of gm_map and gm_bpref are logs.\n\
+ --Bootstrap num:\n\
+ -B <num>: After each summary value that is an average over queries, print\n\
+    95% confidence intervals of it, from num bootstrap resamples of the\n\
+    queries evaluated (all queries with rel_info, if -c), as a line\n\
+       measure_ci95  all  percentile_low  percentile_high  bca_low  bca_high\n\
+    giving the bounds of the percentile and the bias-corrected and\n\
+    accelerated (BCa) intervals.  Resamples are drawn on up to -j threads,\n\
+    giving the same intervals whatever the number of threads.\n\
+ --write_values values_file:\n\
+ -W values_file: Also write the value of each measure for each query of\n\
+    each run to values_file in binary 'values_bin' format (see\n\
+    put_values_bin.c): a table of the qids of rel_info_file, a table of\n\
+    the measure value names, and for each run the column of each value\n\
+    over those queries (NaN where the query was not evaluated), as doubles\n\
+    that can be used in place once the file is mapped.  As for -P, the\n\
+    values of gm_map and gm_bpref are logs.\n\
+ --format output_format:\n\
+ -F output_format: Write measure values in output_format, one of 'text'\n\
+    (the default, as described here), 'tsv' (text without padding),\n\
+    'jsonl' (a JSON object per runid, qid and measure), 'csv' (a record\n\
+    per runid, qid and measure), 'csv_wide' (a row per runid and qid, with\n\
+    a column per measure) or 'binary'.  See the help of each\n\
+    (eg, trec_eval -h -F jsonl).\n\
+ --server socket_path:\n\
+ -S socket_path: Server mode.  Load each rel_info_file and initialize the\n\
+    measures once, then serve evaluation requests on the Unix domain socket\n\
+    socket_path until killed.  Each connection is one request: a line\n\
+       [-q] [rel_info_file] results_file\n\
+    where rel_info_file (default the first one) must be given exactly as on\n\
+    the command line, and a results_file of '-' means the results follow\n\
+    the request line on the connection, up to end of file (shutdown).  The\n\
+    output (as for several results files, tagged by runid) and any error\n\
+    messages are written back on the connection, line by line as they are\n\
+    computed, and the connection closed.  Requests are served one at a time.\n\
+    See trec_eval_client for a client that also measures request latency.\n\
+ --convert binary_file:\n\
+ -C binary_file: Convert mode.  Instead of evaluating, read results_file\n\
+    (in the format given by -T) and write its results to binary_file in\n\
+    'trec_results_bin' format, which can then be evaluated (with\n\
+    -T trec_results_bin) any number of times without being parsed.\n\
+ --convert_rel_info binary_file:\n\
+ -Q binary_file: As -C, for rel_info_file (in the format given by -R, one of\n\
+    'qrels', 'qrels_twoaspects', 'qrels_threeaspects', 'qrels_multiaspect'),\n\
+    written in 'qrels_bin' format (evaluated with -R qrels_bin).\n\
  \n\
  \n\
 Standard evaluation procedure:\n\
@@ -112,13 +189,17 @@ it will not be detected.  Use the -c flag to avoid this behavior. \n\
 #include "sysfunc.h"
 #include "trec_eval.h"
 #include "functions.h"
+#include "trec_format.h"
 
 #ifdef MDEBUG
 #include "mcheck.h"
 #endif /* MDEBUG */
 
 
-static char *usage = "Usage: trec_eval [-h] [-q] {-m measure}* trec_rel_file trec_top_file\n\
+static char *usage = "Usage: trec_eval [-h] [-q] {-m measure}* trec_rel_file trec_top_file {trec_top_file}*\n\
+       trec_eval -S socket_path [-q] {-m measure}* trec_rel_file {trec_rel_file}*\n\
+       trec_eval -C binary_file trec_top_file\n\
+       trec_eval -Q binary_file trec_rel_file\n\
    -h: Give full help information, including other options\n\
    -q: In addition to summary evaluation, give evaluation for each query\n\
    -m: calculate and print measures indicated by 'measure'\n\
@@ -132,13 +213,56 @@ extern long te_num_rel_info_format;
 extern REL_INFO_FILE_FORMAT te_rel_info_format[];
 extern long te_num_results_format;
 extern RESULTS_FILE_FORMAT te_results_format[];
-extern long te_num_form_inter_procs;
-extern RESULTS_FILE_FORMAT te_form_inter_procs[];
+extern long te_num_output_format;
+extern OUTPUT_FORMAT te_output_format[];
+
+/* A rel_info file, loaded and indexed by qid */
+typedef struct {
+    char *file_name;
+    ALL_REL_INFO all_rel_info;
+    QID_INDEX qid_index;
+} REL_INFO_FILE;
+
+/* Everything that stays resident while results files are evaluated in
+   turn (batch and server modes) */
+typedef struct {
+    EPI *epi;
+    REL_INFO_FILE *rel_info_files;
+    long num_rel_info_files;
+    long results_format;            /* Index into te_results_format */
+    long docid_mark;                /* te_docid_mark after rel_info loaded */
+    long stream_flag;               /* Evaluate results a query at a time */
+    RUN_VALUES *run_values;         /* If non-NULL, keep the per query
+				       values of the next run here */
+    ALL_ZSCORES *all_zscores;
+    TREC_EVAL *init_eval;           /* Initialized values of all measures */
+    TREC_EVAL *accum_eval;          /* Space for accumulating one run */
+} EVAL_SETUP;
 
-static int mark_measure (EPI *epi, char *optarg);
 static int trec_eval_help(EPI *epi);
 static void get_debug_level_query (EPI *epi, char *optarg);
 static int cleanup (EPI *epi);
+static int get_results_files (char **args, long num_args, char ***files,
+			      long *num_files);
+static int comp_file_name (const void *ptr1, const void *ptr2);
+static long eval_results_file (EVAL_SETUP *setup, REL_INFO_FILE *rel_info_file,
+			       char *results_file);
+static long eval_results_batch (EVAL_SETUP *setup,
+				REL_INFO_FILE *rel_info_file,
+				char *results_file);
+static long eval_results_stream (EVAL_SETUP *setup,
+				 REL_INFO_FILE *rel_info_file,
+				 char *results_file);
+static int convert_results_file (EPI *epi, long results_format,
+				 char *results_file, char *bin_results_file);
+static int convert_rel_info_file (EPI *epi, char *rel_info_file,
+				  char *bin_rel_info_file);
+static int init_run_values (RUN_VALUES *run_values, long num_queries,
+			    long num_values);
+static void free_run_values (RUN_VALUES *run_values);
+static int serve (EVAL_SETUP *setup, char *socket_path);
+static int serve_request (EVAL_SETUP *setup, int conn);
+static void serve_stop (int sig);
 
 
 int
@@ -146,18 +270,28 @@ main (argc, argv)
 int argc;
 char *argv[];
 {
-    char *trec_results_file;
-    ALL_RESULTS all_results;
-    char *trec_rel_info_file;
-    ALL_REL_INFO all_rel_info;
+    char **trec_results_files = NULL;
+    long num_results_files = 0;
+    REL_INFO_FILE *rel_info_files;
+    long num_rel_info_files;
     char *zscores_file= NULL;
-    char *choice;
+    char *socket_path = NULL;
+    char *convert_file = NULL;
+    char *convert_rel_info = NULL;
+    long num_permutations = 0;
+    char *values_file = NULL;
+    RUN_VALUES *run_values = NULL;
+    RUN_VALUES *kept_run_values = NULL;
+    long num_kept_runs = 0;
     ALL_ZSCORES all_zscores;
+    EVAL_SETUP setup;
 
     EPI epi;              /* Eval parameter info */
+    TREC_EVAL init_eval;
     TREC_EVAL accum_eval;
-    TREC_EVAL q_eval;
-    long i,j,m;
+    long num_queries;
+    long i,m,r,f;
+    int exit_status = 0;
     int c;
     long help_wanted = 0;
     long measure_marked_flag = 0;
@@ -183,10 +317,19 @@ char *argv[];
     epi.max_num_docs_per_topic = MAXLONG;
     epi.rel_info_format = "qrels";
     epi.results_format = "trec_results";
+    epi.output_format = "text";
+    epi.run_id = NULL;
     epi.zscore_flag = 0;
+    epi.num_threads = 1;
+    epi.num_runs = 1;
+    epi.run_values = NULL;
+    epi.bootstrap_resamples = 0;
+    epi.summary_ci = NULL;
     if (NULL == (epi.meas_arg = Malloc (argc+1, MEAS_ARG)))
 	exit (1);
     epi.meas_arg[0].measure_name = NULL;
+    setup.stream_flag = 0;
+    setup.run_values = NULL;
     
     /* Get command line options */
     while (1) {
@@ -207,9 +350,18 @@ char *argv[];
 	    {"Results_format", 1, 0, 'T'},
 	    {"Output_old_results_format", 1, 0, 'o'},
 	    {"Zscore", 1, 0, 'Z'},
+	    {"jobs", 1, 0, 'j'},
+	    {"server", 1, 0, 'S'},
+	    {"convert", 1, 0, 'C'},
+	    {"convert_rel_info", 1, 0, 'Q'},
+	    {"Grouped_by_qid", 0, 0, 'G'},
+	    {"Paired_tests", 1, 0, 'P'},
+	    {"Bootstrap", 1, 0, 'B'},
+	    {"write_values", 1, 0, 'W'},
+	    {"format", 1, 0, 'F'},
 	    {0, 0, 0, 0},
 	};
-	c = getopt_long (argc, argv, "hvqm:cl:nD:JN:M:R:T:oZ:", 
+	c = getopt_long (argc, argv, "hvqm:cl:nD:JN:M:R:T:oZ:j:S:C:Q:GP:B:W:F:", 
 			 long_options, &option_index);
 	if (c == -1)
 	    break;
@@ -225,7 +377,8 @@ char *argv[];
 	    break;
 	case 'm':
 	    /* Mark measure(s) indicated by optarg to be done */
-	    if (UNDEF == mark_measure (&epi, optarg)) {
+	    if (UNDEF == te_mark_measure (&epi, te_trec_measures,
+					  te_num_trec_measures, optarg)) {
 		fprintf (stderr, "trec_eval: illegal measure '%s'\n", optarg);
 		exit (1);
 	    }
@@ -266,6 +419,39 @@ char *argv[];
 	    epi.zscore_flag++;
 	    zscores_file = optarg;
 	    break;
+	case 'j':
+	    epi.num_threads = atol (optarg);
+	    break;
+	case 'S':
+	    socket_path = optarg;
+	    break;
+	case 'C':
+	    convert_file = optarg;
+	    break;
+	case 'Q':
+	    convert_rel_info = optarg;
+	    break;
+	case 'G':
+	    setup.stream_flag++;
+	    break;
+	case 'P':
+	    if (0 >= (num_permutations = atol (optarg))) {
+		fprintf (stderr, "trec_eval: -P needs a number of permutations\n");
+		exit (1);
+	    }
+	    break;
+	case 'B':
+	    if (0 >= (epi.bootstrap_resamples = atol (optarg))) {
+		fprintf (stderr, "trec_eval: -B needs a number of resamples\n");
+		exit (1);
+	    }
+	    break;
+	case 'W':
+	    values_file = optarg;
+	    break;
+	case 'F':
+	    epi.output_format = optarg;
+	    break;
 	case '?':
 	default:
 		(void) fputs (usage,stderr);
@@ -279,58 +465,134 @@ char *argv[];
 	exit (0);
     }
 
-    if (optind + 2 != argc ) {
-        (void) fputs (usage,stderr);
-        exit (1);
+    for (setup.results_format = 0;
+	 setup.results_format < te_num_results_format;
+	 setup.results_format++) {
+	if (0 == strcmp (epi.results_format,
+			 te_results_format[setup.results_format].name))
+	    break;
     }
-
-    trec_rel_info_file = argv[optind++];
-    trec_results_file = argv[optind++];
-
-    /* Find and get qrels and ranked results information for all queries from
-       the input text files */
-    
-    for (i = 0; i < te_num_rel_info_format; i++) {
-	if (0 == strcmp (epi.rel_info_format, te_rel_info_format[i].name)) {
-		choice = te_rel_info_format[i].name;
-		// printf("%s\n", &all_rel_info);
-	    if (UNDEF == te_rel_info_format[i].get_file (&epi,
-							 trec_rel_info_file,
-							 &all_rel_info)) {
-		fprintf (stderr, "trec_eval: Quit in file '%s'\n",
-			 trec_rel_info_file);
-		exit (2);
-	    }
+    if (setup.results_format >= te_num_results_format) {
+	fprintf (stderr, "trec_eval: Illegal retrieval results format '%s'\n",
+		 epi.results_format);
+	exit (2);
+    }
+    for (f = 0; f < te_num_output_format; f++) {
+	if (0 == strcmp (epi.output_format, te_output_format[f].name))
 	    break;
-	}
     }
-    
-    if (i >= te_num_rel_info_format) {
-	fprintf (stderr, "trec_eval: Illegal rel_format '%s'\n",
-		 epi.rel_info_format);
+    if (f >= te_num_output_format) {
+	fprintf (stderr, "trec_eval: Illegal output format '%s'\n",
+		 epi.output_format);
+	exit (2);
+    }
+    if (te_output_format[f].end_row != NULL &&
+	(epi.bootstrap_resamples > 0 || num_permutations > 0)) {
+	fprintf (stderr, "trec_eval: Output format '%s' cannot be used with -B or -P\n",
+		 epi.output_format);
+	exit (2);
+    }
+    if (socket_path != NULL &&
+	(num_permutations > 0 || values_file != NULL)) {
+	fprintf (stderr, "trec_eval: -S cannot be used with -P or -W\n");
+	exit (2);
+    }
+    if (setup.stream_flag &&
+	strcmp (epi.results_format, "trec_results")) {
+	fprintf (stderr, "trec_eval: -G needs results format 'trec_results'\n");
 	exit (2);
     }
 
-    for (i = 0; i < te_num_results_format; i++) {
-	if (0 == strcmp (epi.results_format, te_results_format[i].name)) {
+    if (convert_file != NULL) {
+	/* Convert mode.  The only remaining argument is the results file */
+	if (optind + 1 != argc) {
+	    (void) fputs (usage,stderr);
+	    exit (1);
+	}
+	if (UNDEF == convert_results_file (&epi, setup.results_format,
+					   argv[optind], convert_file))
+	    exit (2);
+	exit (0);
+    }
+    if (convert_rel_info != NULL) {
+	/* The only remaining argument is the rel_info file */
+	if (optind + 1 != argc) {
+	    (void) fputs (usage,stderr);
+	    exit (1);
+	}
+	if (UNDEF == convert_rel_info_file (&epi, argv[optind],
+					    convert_rel_info))
+	    exit (2);
+	exit (0);
+    }
 
-	    if (UNDEF == te_results_format[i].get_file (&epi,
-							trec_results_file,
-							&all_results)) {
-		fprintf (stderr, "trec_eval: Quit in file '%s'\n",
-			 trec_results_file);
-		exit (2);
-	    }
-	    break;
+    if (socket_path != NULL) {
+	/* Server mode.  All remaining arguments are rel_info files.  Any
+	   number of runs may be evaluated */
+	if (optind + 1 > argc ) {
+	    (void) fputs (usage,stderr);
+	    exit (1);
 	}
+	num_rel_info_files = argc - optind;
+	epi.num_runs = MAXLONG;
     }
+    else {
+	if (optind + 2 > argc ) {
+	    (void) fputs (usage,stderr);
+	    exit (1);
+	}
+	num_rel_info_files = 1;
 
-    if (i >= te_num_results_format) {
-	fprintf (stderr, "trec_eval: Illegal retrieval results format '%s'\n",
-		 epi.results_format);
-	exit (2);
+	/* All remaining arguments are results files (or directories of
+	   them) */
+	if (UNDEF == get_results_files (&argv[optind+1], argc - optind - 1,
+					&trec_results_files,
+					&num_results_files))
+	    exit (2);
+	if (num_results_files == 0) {
+	    fprintf (stderr, "trec_eval: No results files given\n");
+	    exit (1);
+	}
+	epi.num_runs = num_results_files;
+	if (num_permutations > 0 && num_results_files < 2) {
+	    fprintf (stderr, "trec_eval: -P needs at least two results files\n");
+	    exit (1);
+	}
     }
 
+    /* Find and get qrels information for all queries from the input text
+       file(s).  They are loaded, sorted and indexed once for all results
+       files */
+    if (NULL == (rel_info_files = Malloc (num_rel_info_files, REL_INFO_FILE)))
+	exit (3);
+    for (r = 0; r < num_rel_info_files; r++) {
+	rel_info_files[r].file_name = argv[optind+r];
+	for (i = 0; i < te_num_rel_info_format; i++) {
+	    if (0 == strcmp (epi.rel_info_format, te_rel_info_format[i].name)) {
+		if (UNDEF == te_rel_info_format[i].get_file
+		    (&epi, rel_info_files[r].file_name,
+		     &rel_info_files[r].all_rel_info)) {
+		    fprintf (stderr, "trec_eval: Quit in file '%s'\n",
+			     rel_info_files[r].file_name);
+		    exit (2);
+		}
+		break;
+	    }
+	}
+    
+	if (i >= te_num_rel_info_format) {
+	    fprintf (stderr, "trec_eval: Illegal rel_format '%s'\n",
+		     epi.rel_info_format);
+	    exit (2);
+	}
+
+	/* Index rel_info by qid */
+	if (UNDEF == te_qid_index_build (&rel_info_files[r].all_rel_info,
+					 &rel_info_files[r].qid_index))
+	    exit (3);
+    }
+    setup.docid_mark = te_docid_mark ();
+
     if (epi.zscore_flag) {
 	if (UNDEF == te_get_zscores (&epi, zscores_file, &all_zscores))
 	    return (UNDEF);
@@ -339,19 +601,28 @@ char *argv[];
     /* Initialize all marked measures (possibly using command line info) */
     if (0 == measure_marked_flag) {
 	/* If no measures designated on command line, first mark "official" */
-	if (UNDEF == mark_measure (&epi, "official")) {
+	if (UNDEF == te_mark_measure (&epi, te_trec_measures,
+				      te_num_trec_measures, "official")) {
 	    fprintf (stderr, "trec_eval: illegal measure 'official'\n");
 	    exit (1);
 	}
     }
+    if (epi.num_runs > 1) {
+	/* Tag the output of each run with its runid */
+	if (UNDEF == te_mark_measure (&epi, te_trec_measures,
+				      te_num_trec_measures, "runid")) {
+	    fprintf (stderr, "trec_eval: illegal measure 'runid'\n");
+	    exit (1);
+	}
+    }
 
-    accum_eval = (TREC_EVAL) {"all", 0, 0, NULL, 0, 0};
+    init_eval = (TREC_EVAL) {"all", 0, 0, NULL, 0, 0};
     for (m = 0; m < te_num_trec_measures; m++) {
 	if (MEASURE_MARKED(te_trec_measures[m])) {
 		// printf("%s\n",te_trec_measures[m]);
 	    if (UNDEF == te_trec_measures[m]->init_meas (&epi,
 							te_trec_measures[m],
-							&accum_eval)) {
+							&init_eval)) {
 		fprintf (stderr, "trec_eval: Cannot initialize measure '%s'\n",
 			 te_trec_measures[m]->name);
 		exit (2);
@@ -359,151 +630,113 @@ char *argv[];
 	}
     }
 
-    /* Reserve space and initialize q_eval to be copy of accum_eval */
-    if (NULL == (q_eval.values = Malloc (accum_eval.num_values,
-					 TREC_EVAL_VALUE)))
+    /* accum_eval is reset to a copy of init_eval for each run */
+    if (NULL == (accum_eval.values = Malloc (init_eval.num_values,
+					     TREC_EVAL_VALUE)))
 	exit (3);
-    (void) memcpy (q_eval.values, accum_eval.values,
-		   accum_eval.num_values * sizeof (TREC_EVAL_VALUE));
-    q_eval.num_values = accum_eval.num_values;
-    q_eval.num_queries = q_eval.num_orig_queries = 0;
-
-
-    /* For each topic which has both qrels and top results information,
-       calculate, possibly print (if query_flag), and accumulate
-       evaluation measures. */
-	
-    for (i = 0; i < all_results.num_q_results; i++) {
-		/* If debugging a particular query, then skip all others */
-		if (epi.debug_query &&
-		    strcmp (epi.debug_query, all_results.results[i].qid))
-		    continue;
-
-			
-		/* Find rel info for this query (skip if no rel info) */
-		for (j = 0; j < all_rel_info.num_q_rels; j++) {
-		    if (0 == strcmp (all_results.results[i].qid,
-				     all_rel_info.rel_info[j].qid))
-			break;
-		}
-		
-		if (j >= all_rel_info.num_q_rels)
-		    continue;
-
-		/* zero out all measures for new query */
-		for (m = 0; m < q_eval.num_values; m++)
-		    q_eval.values[m].value = 0;
-		q_eval.qid = all_results.results[i].qid;
-
-		
-		/*
-			Trivial comparison to compute credibility measures.
-			This will force to pass not just the relevance, but the credibility as well. 
-		*/
-
-		if (strcmp(choice, "qrels_twoaspects") == 0){
-			for (m = 0; m < te_num_trec_measures; m++) {
-			    if (MEASURE_REQUESTED(te_trec_measures[m])) {
-
-				if (UNDEF == te_trec_measures[m]->calc_meas (&epi,
-								    &all_rel_info.rel_cred_info[j],
-								    &all_results.results[i],
-								    te_trec_measures[m],
-								    &q_eval)) {
-				    fprintf (stderr,"trec_eval: Can't calculate measure '%s'\n",
-					     te_trec_measures[m]->name);
-				    exit (4);
-				}
-			    }
-	    	}
-		}else if (strcmp(choice, "qrels_threeaspects") == 0){
-			for (m = 0; m < te_num_trec_measures; m++) {
-			    if (MEASURE_REQUESTED(te_trec_measures[m])) {
-				if (UNDEF == te_trec_measures[m]->calc_meas (&epi,
-								    &all_rel_info.threeaspects_info[j],
-								    &all_results.results[i],
-								    te_trec_measures[m],
-								    &q_eval)) {
-				    fprintf (stderr,"trec_eval: Can't calculate measure '%s'\n",
-					     te_trec_measures[m]->name);
-				    exit (4);
-				}
-			    }
-	    	}
-		}
-		else{
-			for (m = 0; m < te_num_trec_measures; m++) {
-			    if (MEASURE_REQUESTED(te_trec_measures[m])) {
-
-				if (UNDEF == te_trec_measures[m]->calc_meas (&epi,
-								    &all_rel_info.rel_info[j],
-								    &all_results.results[i],
-								    te_trec_measures[m],
-								    &q_eval)) {
-				    fprintf (stderr,"trec_eval: Can't calculate measure '%s'\n",
-					     te_trec_measures[m]->name);
-				    exit (4);
-				}
-			    }
-			}	
-		}
-	
-		/* Convert values to zscores if requested */
-		if (epi.zscore_flag) {
-		    if (UNDEF == te_convert_to_zscore (&all_zscores, &q_eval))
-			return (UNDEF);
-		}
 
-		/* Add this topics value to accumulated values, and possibly print */
-		for (m = 0; m < te_num_trec_measures; m++) {
-		    if (MEASURE_REQUESTED(te_trec_measures[m])) {
-
-			if (UNDEF == te_trec_measures[m]->acc_meas (&epi,
-							   te_trec_measures[m],
-							   &q_eval,
-							   &accum_eval)) {
-			    fprintf(stderr,"trec_eval: Can't accumulate measure '%s'\n",
-				    te_trec_measures[m]->name);
-			    exit (5);
-			}
-			if (epi.query_flag &&
-			    UNDEF == te_trec_measures[m]->print_single_meas (&epi,
-							   te_trec_measures[m],
-							   &q_eval)) {
-			    fprintf(stderr,
-				    "trec_eval: Can't print query measure '%s'\n",
-				    te_trec_measures[m]->name);
-			    exit (6);
-			}
-		    }
-		}
-		accum_eval.num_queries++;
+    setup.epi = &epi;
+    setup.rel_info_files = rel_info_files;
+    setup.num_rel_info_files = num_rel_info_files;
+    setup.all_zscores = &all_zscores;
+    setup.init_eval = &init_eval;
+    setup.accum_eval = &accum_eval;
+
+    if (socket_path != NULL) {
+	/* Only returns on error.  Output is started by each request */
+	(void) serve (&setup, socket_path);
+	exit (11);
     }
 
-    if (accum_eval.num_queries == 0) {
-	fprintf (stderr,
-		"trec_eval: No queries with both results and relevance info\n");
-	exit (7);
+    if (UNDEF == te_output_start (&epi, &init_eval))
+	exit (2);
+
+    if (num_permutations > 0 || values_file != NULL) {
+	/* Keep the values of every query of every run, for comparing, or
+	   of one run at a time, for writing */
+	num_kept_runs = num_permutations > 0 ? num_results_files : 1;
+	if (NULL == (run_values = Malloc (num_kept_runs, RUN_VALUES)))
+	    exit (3);
+	for (r = 0; r < num_kept_runs; r++) {
+	    if (UNDEF == init_run_values (&run_values[r],
+					  rel_info_files[0].all_rel_info.num_q_rels,
+					  init_eval.num_values))
+		exit (3);
+	}
     }
+    if (values_file != NULL &&
+	UNDEF == te_put_values_bin_start (values_file,
+					  &rel_info_files[0].all_rel_info,
+					  &init_eval, num_results_files))
+	exit (2);
 
-    if (epi.average_complete_flag) {
-	/* Want to average over possibly missing queries.  Pass in actual
-	 *  number of queries in num_orig_queries */
-	accum_eval.num_orig_queries = accum_eval.num_queries;
-	accum_eval.num_queries = all_rel_info.num_q_rels;
+    for (r = 0; r < num_results_files; r++) {
+	if (run_values != NULL) {
+	    kept_run_values = &run_values[num_permutations > 0 ? r : 0];
+	    setup.run_values = kept_run_values;
+	}
+	if (UNDEF == (num_queries = eval_results_file (&setup,
+						       &rel_info_files[0],
+						       trec_results_files[r])))
+	    exit (2);
+	if (num_queries == 0) {
+	    if (epi.num_runs == 1) {
+		fprintf (stderr,
+			 "trec_eval: No queries with both results and relevance info\n");
+		exit (7);
+	    }
+	    fprintf (stderr,
+		     "trec_eval: No queries with both results and relevance info in '%s'\n",
+		     trec_results_files[r]);
+	    exit_status = 7;
+	}
+	if (run_values == NULL)
+	    continue;
+	/* A run with no queries evaluated is known by its file name */
+	if (kept_run_values->run_id == NULL) {
+	    if (NULL == (kept_run_values->run_id =
+			 Malloc (strlen (trec_results_files[r]) + 1, char)))
+		exit (3);
+	    (void) strcpy (kept_run_values->run_id, trec_results_files[r]);
+	}
+	if (values_file != NULL &&
+	    UNDEF == te_put_values_bin_run (kept_run_values))
+	    exit (2);
+	if (num_permutations == 0) {
+	    /* Ready for the next run */
+	    Free (kept_run_values->run_id);
+	    kept_run_values->run_id = NULL;
+	    (void) memset (kept_run_values->evaluated, 0,
+			   kept_run_values->num_queries);
+	}
     }
 
-    /* Calculate final averages, and print (if desired) */
-    for (m = 0; m < te_num_trec_measures; m++) {
-	if (MEASURE_REQUESTED(te_trec_measures[m])) {
-	    if (UNDEF == te_trec_measures[m]->calc_avg_meas
-		    (&epi, te_trec_measures[m], &accum_eval) ||
-		UNDEF == te_trec_measures[m]->print_final_and_cleanup_meas 
-		(&epi, te_trec_measures[m],  &accum_eval)) {
-		    fprintf (stderr,"trec_eval: Can't print measure '%s'\n",
-			     te_trec_measures[m]->name);
-		    exit (8);
-		}
+    if (values_file != NULL && UNDEF == te_put_values_bin_end ())
+	exit (2);
+    if (num_permutations > 0 &&
+	UNDEF == te_compare_runs (&epi, &init_eval, run_values,
+				  num_results_files, num_permutations)) {
+	fprintf (stderr, "trec_eval: Quit comparing runs\n");
+	exit (2);
+    }
+    if (run_values != NULL) {
+	for (r = 0; r < num_kept_runs; r++)
+	    free_run_values (&run_values[r]);
+	Free (run_values);
+    }
+
+    if (epi.num_runs > 1) {
+	/* Measure storage was kept for all runs.  Free it now, without
+	   printing anything more */
+	epi.summary_flag = 0;
+	epi.num_runs = 1;
+	for (m = 0; m < te_num_trec_measures; m++) {
+	    if (MEASURE_REQUESTED(te_trec_measures[m]) &&
+		UNDEF == te_trec_measures[m]->print_final_and_cleanup_meas
+		(&epi, te_trec_measures[m], &accum_eval)) {
+		fprintf (stderr,"trec_eval: cleanup failed\n");
+		exit (10);
+	    }
 	}
     }
 
@@ -511,86 +744,517 @@ char *argv[];
 	fprintf (stderr,"trec_eval: cleanup failed\n");
 	exit (10);
     }
-    Free (q_eval.values);
+    for (r = 0; r < num_rel_info_files; r++)
+	(void) te_qid_index_cleanup (&rel_info_files[r].qid_index);
+    Free (rel_info_files);
+    for (r = 0; r < num_results_files; r++)
+	Free (trec_results_files[r]);
+    Free (trec_results_files);
     Free (accum_eval.values);
+    Free (init_eval.values);
     Free (epi.meas_arg);
 
-    exit (0);
+    exit (exit_status);
 }
 
-static int 
-add_meas_arg_info (EPI *epi, char *meas, char *param)
+/* Get results_file, and evaluate it against rel_info_file, printing
+   the values of each query (if query_flag) and the summary values.
+   The run is freed again before returning, leaving only what is in setup.
+   Return the number of queries evaluated, UNDEF if error */
+static long
+eval_results_file (EVAL_SETUP *setup, REL_INFO_FILE *rel_info_file,
+		   char *results_file)
 {
-    long i;
+    EPI *epi = setup->epi;
+    RUN_VALUES run_values;
+    long num_queries;
+
+    epi->run_id = NULL;
+    /* The values of each query are kept for the bootstrap (for this run
+       only, unless setup keeps them for comparing runs) */
+    epi->run_values = setup->run_values;
+    if (epi->run_values == NULL && epi->bootstrap_resamples > 0) {
+	if (UNDEF == init_run_values (&run_values,
+				      rel_info_file->all_rel_info.num_q_rels,
+				      setup->init_eval->num_values))
+	    return (UNDEF);
+	epi->run_values = &run_values;
+    }
 
-    /* Guaranteed space since malloc'd argc+1 entries and can't be more
-       than one entry per command line argument */
+    if (setup->stream_flag)
+	num_queries = eval_results_stream (setup, rel_info_file, results_file);
+    else
+	num_queries = eval_results_batch (setup, rel_info_file, results_file);
 
-    /* Find non-NULL entry */
-    i = 0;
-    while (epi->meas_arg[i].measure_name) i++;
-    
-    epi->meas_arg[i].measure_name = meas;
-    epi->meas_arg[i].parameters = param;
-
-    /* Ensure measure_name exists, has non_NULL parameter and mark it 
-       to be calculated */
-    if (*param == '\0') {
-	fprintf (stderr, "trec_eval: improper measure in parameter '%s'\n",
-		 epi->meas_arg[i].measure_name);
+    if (epi->run_values == &run_values)
+	free_run_values (&run_values);
+    epi->run_values = NULL;
+    epi->run_id = NULL;
+    return (num_queries);
+}
+
+/* Batch mode.  Get all of results_file, and evaluate it query by query.
+   Return the number of queries evaluated, UNDEF if error */
+static long
+eval_results_batch (EVAL_SETUP *setup, REL_INFO_FILE *rel_info_file,
+		    char *results_file)
+{
+    EPI *epi = setup->epi;
+    ALL_RESULTS all_results;
+    long num_queries;
+
+    /* Get ranked results information for all queries of this run */
+    if (UNDEF == te_results_format[setup->results_format].get_file
+	(epi, results_file, &all_results)) {
+	fprintf (stderr, "trec_eval: Quit in file '%s'\n", results_file);
+	(void) te_results_format[setup->results_format].cleanup ();
+	(void) te_docid_release (setup->docid_mark);
 	return (UNDEF);
     }
 
-    epi->meas_arg[i+1].measure_name = NULL;
+    /* Map the docnos of rel_info and results to docids, so that they
+       can be merged by comparing docids */
+    if (UNDEF == te_docid_assign (epi->num_threads)) {
+	fprintf (stderr, "trec_eval: Quit assigning docids\n");
+	return (UNDEF);
+    }
+
+    *setup->accum_eval = (TREC_EVAL) {"all", 0, 0, setup->accum_eval->values,
+				      setup->init_eval->num_values,
+				      setup->init_eval->num_values};
+    (void) memcpy (setup->accum_eval->values, setup->init_eval->values,
+		   setup->init_eval->num_values * sizeof (TREC_EVAL_VALUE));
+    num_queries = te_eval_run (epi, te_trec_measures, te_num_trec_measures,
+			       &rel_info_file->all_rel_info,
+			       &rel_info_file->qid_index,
+			       setup->all_zscores, &all_results,
+			       setup->accum_eval, NULL);
+
+    /* Free this run before getting the next.  The per query pools of
+       the form_* procedures are keyed by qid, so must be reset too */
+    if (UNDEF == te_results_format[setup->results_format].cleanup () ||
+	UNDEF == te_docid_release (setup->docid_mark) ||
+	UNDEF == te_cleanup_form_procs ()) {
+	fprintf (stderr,"trec_eval: cleanup failed\n");
+	return (UNDEF);
+    }
+    return (num_queries);
+}
+
+/* Stream mode.  As eval_results_batch, but results_file is read a query
+   at a time (see te_get_trec_results_query), and each query evaluated
+   as soon as it has been read.  The lines of each query must be together
+   in results_file.
+   Return the number of queries evaluated, UNDEF if error */
+static long
+eval_results_stream (EVAL_SETUP *setup, REL_INFO_FILE *rel_info_file,
+		     char *results_file)
+{
+    EPI *epi = setup->epi;
+    TREC_EVAL *accum_eval = setup->accum_eval;
+    TREC_EVAL q_eval;
+    RESULTS *results;
+    char *seen = NULL;
+    long rel_index;
+    long num_queries = UNDEF;
+    int ret;
+
+    /* Space for the values of a query, and a flag for each query with
+       rel_info to detect a query whose lines are not together */
+    q_eval.num_values = q_eval.max_num_values = setup->init_eval->num_values;
+    if (NULL == (q_eval.values = Malloc (q_eval.num_values + 1,
+					 TREC_EVAL_VALUE)) ||
+	NULL == (seen = Malloc (rel_info_file->all_rel_info.num_q_rels + 1,
+				char)))
+	goto done;
+    (void) memcpy (q_eval.values, setup->init_eval->values,
+		   q_eval.num_values * sizeof (TREC_EVAL_VALUE));
+    (void) memset (seen, 0, rel_info_file->all_rel_info.num_q_rels + 1);
+
+    *accum_eval = (TREC_EVAL) {"all", 0, 0, accum_eval->values,
+			       setup->init_eval->num_values,
+			       setup->init_eval->num_values};
+    (void) memcpy (accum_eval->values, setup->init_eval->values,
+		   setup->init_eval->num_values * sizeof (TREC_EVAL_VALUE));
+
+    /* The docids of rel_info are assigned once, those of each query as
+       it is read */
+    if (UNDEF == te_docid_assign_resident (epi->num_threads)) {
+	fprintf (stderr, "trec_eval: Quit assigning docids\n");
+	goto done;
+    }
+
+    while (1 == (ret = te_get_trec_results_query (epi, results_file,
+						  &results))) {
+	/* If debugging a particular query, then skip all others */
+	if (epi->debug_query && strcmp (epi->debug_query, results->qid))
+	    continue;
+	/* Find rel info for this query (skip if no rel info) */
+	if (0 > (rel_index = te_qid_index_find (&rel_info_file->qid_index,
+						results->qid)))
+	    continue;
+	if (seen[rel_index]) {
+	    fprintf (stderr,
+		     "trec_eval: Lines of query '%s' are not together\n",
+		     results->qid);
+	    ret = UNDEF;
+	    break;
+	}
+	seen[rel_index] = 1;
+	if (UNDEF == te_eval_query (epi, te_trec_measures,
+				    te_num_trec_measures,
+				    &rel_info_file->all_rel_info, rel_index,
+				    setup->all_zscores, results, &q_eval,
+				    accum_eval)) {
+	    ret = UNDEF;
+	    break;
+	}
+    }
+    if (ret == UNDEF) {
+	fprintf (stderr, "trec_eval: Quit in file '%s'\n", results_file);
+	goto done;
+    }
+
+    num_queries = accum_eval->num_queries;
+    if (num_queries > 0 &&
+	UNDEF == te_eval_summary (epi, te_trec_measures, te_num_trec_measures,
+				  &rel_info_file->all_rel_info, accum_eval))
+	num_queries = UNDEF;
+
+ done:
+    /* Free this run before getting the next, as eval_results_batch */
+    if (UNDEF == te_get_trec_results_query_cleanup () ||
+	UNDEF == te_docid_release (setup->docid_mark) ||
+	UNDEF == te_cleanup_form_procs ()) {
+	fprintf (stderr,"trec_eval: cleanup failed\n");
+	num_queries = UNDEF;
+    }
+    if (q_eval.values != NULL)
+	Free (q_eval.values);
+    if (seen != NULL)
+	Free (seen);
+    return (num_queries);
+}
+
+/* Reserve space in run_values for num_values values of num_queries
+   queries, none of them evaluated yet.  Return UNDEF if error */
+static int
+init_run_values (RUN_VALUES *run_values, long num_queries, long num_values)
+{
+    run_values->run_id = NULL;
+    run_values->num_queries = num_queries;
+    run_values->num_values = num_values;
+    if (NULL == (run_values->values = Malloc (num_queries * num_values + 1,
+					      double)) ||
+	NULL == (run_values->evaluated = Malloc (num_queries + 1, char)))
+	return (UNDEF);
+    (void) memset (run_values->evaluated, 0, num_queries + 1);
+    return (1);
+}
+
+static void
+free_run_values (RUN_VALUES *run_values)
+{
+    if (run_values->run_id != NULL)
+	Free (run_values->run_id);
+    Free (run_values->values);
+    Free (run_values->evaluated);
+}
+
+/* Convert mode.  Get results_file, and write it to bin_results_file in
+   trec_results_bin format.  Return UNDEF if error */
+static int
+convert_results_file (EPI *epi, long results_format, char *results_file,
+		      char *bin_results_file)
+{
+    ALL_RESULTS all_results;
+
+    if (UNDEF == te_results_format[results_format].get_file
+	(epi, results_file, &all_results)) {
+	fprintf (stderr, "trec_eval: Quit in file '%s'\n", results_file);
+	return (UNDEF);
+    }
+    if (UNDEF == te_docid_assign (epi->num_threads)) {
+	fprintf (stderr, "trec_eval: Quit assigning docids\n");
+	return (UNDEF);
+    }
+    if (UNDEF == te_put_trec_results_bin (&all_results, bin_results_file)) {
+	fprintf (stderr, "trec_eval: Quit writing file '%s'\n",
+		 bin_results_file);
+	return (UNDEF);
+    }
+    if (UNDEF == te_results_format[results_format].cleanup () ||
+	UNDEF == te_docid_cleanup ()) {
+	fprintf (stderr,"trec_eval: cleanup failed\n");
+	return (UNDEF);
+    }
     return (1);
 }
 
+/* Convert mode.  Get rel_info_file, and write it to bin_rel_info_file in
+   qrels_bin format.  Return UNDEF if error */
 static int
-mark_single_measure (char *optarg)
+convert_rel_info_file (EPI *epi, char *rel_info_file, char *bin_rel_info_file)
 {
+    ALL_REL_INFO all_rel_info;
     long i;
 
-    for (i = 0; i < te_num_trec_measures; i++) {
-	if (0 == strcmp (optarg, te_trec_measures[i]->name)) {
-	    te_trec_measures[i]->eval_index = -2;
+    for (i = 0; i < te_num_rel_info_format; i++) {
+	if (0 == strcmp (epi->rel_info_format, te_rel_info_format[i].name))
 	    break;
-	}
     }
-    if (i >= te_num_trec_measures)
+    if (i >= te_num_rel_info_format) {
+	fprintf (stderr, "trec_eval: Illegal rel_format '%s'\n",
+		 epi->rel_info_format);
+	return (UNDEF);
+    }
+    if (UNDEF == te_rel_info_format[i].get_file (epi, rel_info_file,
+						 &all_rel_info)) {
+	fprintf (stderr, "trec_eval: Quit in file '%s'\n", rel_info_file);
+	return (UNDEF);
+    }
+    if (UNDEF == te_docid_assign (epi->num_threads)) {
+	fprintf (stderr, "trec_eval: Quit assigning docids\n");
+	return (UNDEF);
+    }
+    if (UNDEF == te_put_qrels_bin (&all_rel_info, bin_rel_info_file)) {
+	fprintf (stderr, "trec_eval: Quit writing file '%s'\n",
+		 bin_rel_info_file);
 	return (UNDEF);
+    }
+    if (UNDEF == te_rel_info_format[i].cleanup () ||
+	UNDEF == te_docid_cleanup ()) {
+	fprintf (stderr,"trec_eval: cleanup failed\n");
+	return (UNDEF);
+    }
     return (1);
 }
 
+/* Server mode.  Serve requests on Unix domain socket socket_path, one
+   connection at a time, until killed.  Return UNDEF if the socket cannot
+   be set up or accept fails */
+static char *serve_socket_path = NULL;
+
 static int
-mark_measure (EPI *epi, char *optarg)
+serve (EVAL_SETUP *setup, char *socket_path)
 {
-    long i;
+    struct sockaddr_un addr;
+    struct stat statbuf;
+    int sock, conn;
+    int saved_fd[3];
+    int fd;
+
+    if (strlen (socket_path) >= sizeof (addr.sun_path)) {
+	fprintf (stderr, "trec_eval: Socket path '%s' too long\n",
+		 socket_path);
+	return (UNDEF);
+    }
+    /* Remove a stale socket left by an earlier server (never any other
+       kind of file) */
+    if (0 == stat (socket_path, &statbuf) && S_ISSOCK (statbuf.st_mode))
+	(void) unlink (socket_path);
+
+    (void) memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    (void) strcpy (addr.sun_path, socket_path);
+    if (-1 == (sock = socket (AF_UNIX, SOCK_STREAM, 0)) ||
+	-1 == bind (sock, (struct sockaddr *) &addr, sizeof (addr)) ||
+	-1 == listen (sock, 64)) {
+	fprintf (stderr, "trec_eval: Cannot serve on socket '%s'\n",
+		 socket_path);
+	return (UNDEF);
+    }
+    serve_socket_path = socket_path;
+    (void) signal (SIGINT, serve_stop);
+    (void) signal (SIGTERM, serve_stop);
+    /* A client that goes away early must not kill the server */
+    (void) signal (SIGPIPE, SIG_IGN);
+
+    /* Each request's output goes back on its connection as each line is
+       printed.  Keep the server's own stdin, stdout, stderr to restore */
+    (void) setvbuf (stdout, NULL, _IOLBF, 0);
+    for (fd = 0; fd < 3; fd++) {
+	if (-1 == (saved_fd[fd] = dup (fd)))
+	    return (UNDEF);
+    }
+
+    while (1) {
+	if (-1 == (conn = accept (sock, NULL, NULL))) {
+	    if (errno == EINTR || errno == ECONNABORTED)
+		continue;
+	    fprintf (stderr, "trec_eval: Cannot accept on socket '%s'\n",
+		     socket_path);
+	    return (UNDEF);
+	}
+	(void) fflush (stdout);
+	(void) fflush (stderr);
+	for (fd = 0; fd < 3; fd++)
+	    (void) dup2 (conn, fd);
+	(void) serve_request (setup, conn);
+	(void) te_output_flush ();
+	(void) fflush (stdout);
+	(void) fflush (stderr);
+	clearerr (stdout);
+	clearerr (stderr);
+	for (fd = 0; fd < 3; fd++)
+	    (void) dup2 (saved_fd[fd], fd);
+	(void) close (conn);
+    }
+}
+
+/* Read and evaluate one request from conn (which is also standard input,
+   output and error while serving it).  Request is a single line
+       [-q] [rel_info_file] results_file
+   Return UNDEF if request was bad or could not be evaluated */
+#define MAX_REQUEST_WORDS 4
+static int
+serve_request (EVAL_SETUP *setup, int conn)
+{
+    char request[PATH_MAX + 64];
+    char *words[MAX_REQUEST_WORDS];
+    long num_words, len, i;
+    long query_flag = 0;
+    long saved_query_flag;
+    REL_INFO_FILE *rel_info_file;
     char *ptr;
-    
-    ptr = optarg;
-    while (*ptr && *ptr != '.') ptr++;
-    if (*ptr == '.') {
-	*ptr++ = '\0';
-	if (UNDEF == add_meas_arg_info (epi, optarg, ptr))
+    long num_queries;
+
+    /* Read request line a byte at a time, so that any results following
+       it are left unread for te_get_trec_results */
+    for (len = 0; len < (long) sizeof (request) - 1; len++) {
+	if (1 != read (conn, &request[len], 1) || request[len] == '\n')
+	    break;
+    }
+    request[len] = '\0';
+
+    num_words = 0;
+    ptr = request;
+    while (1) {
+	while (*ptr && isspace ((unsigned char) *ptr))
+	    *ptr++ = '\0';
+	if (*ptr == '\0')
+	    break;
+	if (num_words >= MAX_REQUEST_WORDS) {
+	    num_words = 0;
+	    break;
+	}
+	words[num_words++] = ptr;
+	while (*ptr && ! isspace ((unsigned char) *ptr))
+	    ptr++;
+    }
+    i = 0;
+    if (num_words > 0 && 0 == strcmp (words[0], "-q")) {
+	query_flag = 1;
+	i++;
+    }
+    if (num_words - i == 1)
+	rel_info_file = &setup->rel_info_files[0];
+    else if (num_words - i == 2) {
+	rel_info_file = NULL;
+	for (len = 0; len < setup->num_rel_info_files; len++) {
+	    if (0 == strcmp (words[i], setup->rel_info_files[len].file_name))
+		rel_info_file = &setup->rel_info_files[len];
+	}
+	if (rel_info_file == NULL) {
+	    fprintf (stderr, "trec_eval: Unknown rel_info_file '%s'\n",
+		     words[i]);
 	    return (UNDEF);
+	}
+	i++;
+    }
+    else {
+	fprintf (stderr, "trec_eval: Illegal request.  Want '[-q] [rel_info_file] results_file'\n");
+	return (UNDEF);
+    }
+
+    /* Each response starts with any header of the output format */
+    if (UNDEF == te_output_start (setup->epi, setup->init_eval))
+	return (UNDEF);
+    saved_query_flag = setup->epi->query_flag;
+    setup->epi->query_flag |= query_flag;
+    num_queries = eval_results_file (setup, rel_info_file, words[i]);
+    setup->epi->query_flag = saved_query_flag;
+    if (num_queries == UNDEF)
+	return (UNDEF);
+    if (num_queries == 0) {
+	fprintf (stderr,
+		 "trec_eval: No queries with both results and relevance info\n");
+	return (UNDEF);
     }
+    return (1);
+}
+
+static void
+serve_stop (int sig)
+{
+    if (serve_socket_path != NULL)
+	(void) unlink (serve_socket_path);
+    _exit (0);
+}
+
+/* Expand the num_args results file arguments in args into a malloc'd
+   list of malloc'd file names.  A directory argument stands for all the
+   regular files within it (except hidden ones), in name order */
+static int
+get_results_files (char **args, long num_args, char ***files,
+		   long *num_files)
+{
+    long max_num_files = 0;
+    long i, first;
+    struct stat statbuf;
+    DIR *dir;
+    struct dirent *dirent;
+    char *path;
+
+    *files = NULL;
+    *num_files = 0;
+    for (i = 0; i < num_args; i++) {
+	if (0 != stat (args[i], &statbuf) || ! S_ISDIR (statbuf.st_mode)) {
+	    /* Not a directory.  Errors are reported when getting file */
+	    if (NULL == (*files = te_chk_and_realloc (*files, &max_num_files,
+						      *num_files + 1,
+						      sizeof (char *))) ||
+		NULL == ((*files)[*num_files] = Malloc (strlen (args[i]) + 1,
+							char)))
+		return (UNDEF);
+	    (void) strcpy ((*files)[(*num_files)++], args[i]);
+	    continue;
+	}
 
-    for (i = 0; i < te_num_trec_measure_nicknames; i++) {
-	if (0 == strcmp (optarg, te_trec_measure_nicknames[i].name)) {
-	    /* Have found nickname.  Mark all real names it refers to */
-	    char **name = te_trec_measure_nicknames[i].name_list;
-	    
-	    while (*name) {
-		if (UNDEF == mark_single_measure (*name))
-		    return (UNDEF);
-		name++;
+	if (NULL == (dir = opendir (args[i]))) {
+	    fprintf (stderr, "trec_eval: Cannot read directory '%s'\n",
+		     args[i]);
+	    return (UNDEF);
+	}
+	first = *num_files;
+	while (NULL != (dirent = readdir (dir))) {
+	    if (dirent->d_name[0] == '.')
+		continue;
+	    if (NULL == (path = Malloc (strlen (args[i]) +
+					strlen (dirent->d_name) + 2, char)))
+		return (UNDEF);
+	    (void) sprintf (path, "%s/%s", args[i], dirent->d_name);
+	    if (0 != stat (path, &statbuf) || ! S_ISREG (statbuf.st_mode)) {
+		Free (path);
+		continue;
 	    }
-	    return (1);
+	    if (NULL == (*files = te_chk_and_realloc (*files, &max_num_files,
+						      *num_files + 1,
+						      sizeof (char *))))
+		return (UNDEF);
+	    (*files)[(*num_files)++] = path;
 	}
+	(void) closedir (dir);
+	qsort ((char *) &(*files)[first], (int) (*num_files - first),
+	       sizeof (char *), comp_file_name);
     }
+    return (1);
+}
 
-    /* optarg did not match any nickname, mark measure directly */
-    return (mark_single_measure (optarg));
+static int
+comp_file_name (const void *ptr1, const void *ptr2)
+{
+    return (strcmp (*(char * const *) ptr1, *(char * const *) ptr2));
 }
 
 static int
@@ -618,6 +1282,14 @@ trec_eval_help(EPI *epi)
 	printf ("%s\n-----------------------\n",
 		te_rel_info_format[f].explanation);
 
+    for (f = 0; f < te_num_output_format; f++) {
+	if (0 == strcmp (te_output_format[f].name, epi->output_format))
+	    break;
+    }
+    if (f < te_num_output_format)
+	printf ("%s\n-----------------------\n",
+		te_output_format[f].explanation);
+
     printf ("Individual measure documentation for requested measures\n");
 
     for (m = 0; m < te_num_trec_measures; m++) {
@@ -668,13 +1340,17 @@ cleanup (EPI *epi)
 	    break;
 	}
     }
-    for (i = 0; i < te_num_form_inter_procs; i++) {
-	if (UNDEF == te_form_inter_procs[i].cleanup ())
-	    return (UNDEF);
-    }
+    if (UNDEF == te_cleanup_form_procs ())
+	return (UNDEF);
     if (epi->zscore_flag) {
 	if (UNDEF == te_get_zscores_cleanup())
 	    return (UNDEF);
     }
+    if (UNDEF == te_docid_cleanup ())
+	return (UNDEF);
+    if (UNDEF == te_bootstrap_cleanup ())
+	return (UNDEF);
+    if (UNDEF == te_output_cleanup ())
+	return (UNDEF);
     return (1);
 }
@@ -17,6 +17,20 @@ typedef struct {
 	char *parameters;
 } MEAS_ARG;
     
+/* The per query values of all measures for one run, kept for the
+   bootstrap confidence intervals of its summary values, or for comparing
+   runs after all have been evaluated.  Queries are those of rel_info, in
+   rel_info (qid index) order */
+typedef struct {
+    char *run_id;                   /* Malloc'd copy of the run's runid */
+    long num_queries;               /* Number of queries of rel_info */
+    long num_values;                /* Number of individual measures */
+    double *values;                 /* Value v of query q is
+				       values[v * num_queries + q] */
+    char *evaluated;                /* evaluated[q] set if query q has been
+				       evaluated for this run */
+} RUN_VALUES;
+
 typedef struct {
     long query_flag;              /* 0. If set, evaluation output will be
                                      printed for each query, in addition
@@ -45,10 +59,34 @@ typedef struct {
     char *results_format;         /* "trec_results"  format of input results*/
     long zscore_flag;             /* 0. If set, output Z score for measure
 				     instead of raw score */
+    char *output_format;          /* "text", format of the output of
+				     measure values (see output.c) */
+    const char *run_id;           /* NULL. Set while the values of a query
+				     are printed: the runid of its results
+				     (of the last query, for the summary) */
     /* List of command line arguments giving individual measure parameters.
        meas_arg is NULL if there are no such arguments.  
        If arguments, final list member contains a NULL measure_name */
     MEAS_ARG *meas_arg;
+    long num_threads;             /* 1. Max number of threads to use for
+				     loading input and evaluating queries.
+				     0 means one per cpu */
+    long num_runs;                /* 1. Number of results files evaluated
+				     against rel_info (MAXLONG in server
+				     mode).  If more than 1
+				     (batch or server mode), runid is printed for
+				     each query too, and measure storage
+				     is kept for all runs rather than
+				     freed after printing */
+    RUN_VALUES *run_values;       /* NULL. If non-NULL, the values of each
+				     query evaluated are also kept here */
+    long bootstrap_resamples;     /* 0. If set, summary values are printed
+				     with bootstrap confidence intervals
+				     from this many resamples of the queries
+				     of run_values (see bootstrap.c) */
+    const double *summary_ci;     /* NULL. Set while the summary is printed
+				     if bootstrap_resamples: the confidence
+				     interval bounds of each value */
 } EPI;
 
 
@@ -116,30 +154,20 @@ typedef struct {
 } REL_INFO;
 
 
-typedef struct {
-    char *qid;                      /* query id */
-    char *rel_format;               /* format of rel_info data.  Eg, "qrels" */
-    void *q_rel_info;               /* relevance info for this qid */
-    void *q_cred_info;
-} REL_CRED_INFO;
-
-typedef struct {
-    char *qid;                      /* query id */
-    char *rel_format;               /* format of rel_info data.  Eg, "qrels" */
-    void *q_rel_info;               /* relevance info for this qid */
-    void *q_cred_info;              /* SECOND ASPECT info for this qid */
-    void *q_third_info;             /* THIRD ASPECT info for this qid */
-} THREE_ASPECT_INFO;
-
-
 typedef struct {                    /* Overall relevance judgements */
     long num_q_rels;                /* Number of REL_INFO queries */
     long max_num_q_rels;            /* Num queries space reserved for */
     REL_INFO *rel_info;             /* Array of REL_INFO queries */
-    REL_CRED_INFO *rel_cred_info;   /* Array of CRED_INFO queries */ 
-    THREE_ASPECT_INFO *threeaspects_info; /* Array of THREE_ASPECT_INFO queries */ 
 } ALL_REL_INFO;
 
+/* Hash index from qid to its position in ALL_REL_INFO.rel_info.
+   See utility_qid.c */
+typedef struct {
+    long hash_size;                 /* Power of 2 */
+    long *table;                    /* Index into rel_info, or -1 */
+    const REL_INFO *rel_info;
+} QID_INDEX;
+
 /* Measure characteristics (how to print them, average them). */
 /* List of measures is in measures.c */
 typedef struct trec_meas {
@@ -178,6 +206,11 @@ typedef struct trec_meas {
 	-2 indicates measure to be calculated, but has not yet been initialized.
         Set in init_meas */
     long eval_index;
+    /* 1 if calc_meas keeps state for print_single_meas or
+       print_final_and_cleanup_meas (eg, relstring), and so must be run on
+       the main thread in query order.  Default 0: calc_meas may be run for
+       different queries in parallel */
+    long serial_calc_flag;
 } TREC_MEAS;
 
 /* Mapping of a nickname to a group of measures that it applies to.
@@ -204,6 +237,46 @@ typedef struct {
 		      ALL_RESULTS *all_results);
     int (* cleanup) ();
 } RESULTS_FILE_FORMAT;
+
+/* Lines of output of measure values, and the formats they can be written
+   in.  List of formats is in output.c */
+#define OUT_FLOAT 0                 /* Value printed with 4 decimals */
+#define OUT_LONG 1                  /* Value printed as integer */
+#define OUT_STRING 2                /* String printed as is */
+#define OUT_QUOTED 3                /* String printed in quotes, if the
+				       format has no other way of
+				       delimiting it */
+typedef struct {
+    const char *field;              /* Name of the value, for formats that
+				       name each value */
+    long type;                      /* OUT_FLOAT, OUT_LONG, ... */
+    double value;                   /* OUT_FLOAT or OUT_LONG value */
+    const char *string;             /* OUT_STRING or OUT_QUOTED value */
+} OUT_VALUE;
+#define MAX_OUT_VALUES 8
+typedef struct {
+    const char *prefix;             /* "Z" for zscores, else "" */
+    const char *name;               /* Measure value name */
+    const char *key_field;          /* What key is ("qid" or "runid") */
+    const char *key;                /* qid, "all", or eg runid */
+    long num_values;
+    OUT_VALUE values[MAX_OUT_VALUES];
+} OUT_LINE;
+typedef struct {
+    char *name;
+    char *explanation;
+    int (* start) (const EPI *epi, const TREC_EVAL *init_eval);
+				    /* NULL, or set up the output of runs
+				       with the values of init_eval (eg, a
+				       header line) */
+    long (* put_line) (const OUT_LINE *line, char *buf);
+				    /* Write line to buf (which has room),
+				       returning its length */
+    long (* end_row) (char *buf);   /* NULL, or end the row the lines
+				       since the last flush were written to,
+				       returning its length */
+} OUTPUT_FORMAT;
+
 /* FORM_INTER_PROCS is not used except for clean up and eventually
    documentation */
 typedef struct {
@@ -236,6 +309,24 @@ typedef struct {
 
 #define MISSING_ZSCORE_VALUE -1000000
 
+/* Entire input file held in memory, either mapped or read.
+   See utility_file.c */
+typedef struct {
+    char *buf;                      /* file contents. buf[size-1] is '\n' */
+    long size;                      /* Number of bytes in buf */
+    long mapped;                    /* 1 if buf is mmap'd from the file, 0 if
+				       malloc'd */
+} INPUT_BUF;
+
+/* State of a stream of random numbers.  See utility_random.c */
+typedef struct {
+    uint64_t s[4];
+} TE_RNG;
+
+/* True if (unsigned) char c ends a field within an INPUT_BUF */
+#define END_FIELD(c) ((c) <= ' ' && ((c) == '\0' || (c) == ' ' || \
+				      ((c) >= '\t' && (c) <= '\r')))
+
 /* Macros for marking measures to be calculated in this invocation */
 #define MARK_MEASURE(x)  x->eval_index = -2;
 #define MEASURE_MARKED(x) (-2 == x->eval_index)
@@ -0,0 +1,247 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+
+/* Client for trec_eval server mode (trec_eval -S).  Sends one results
+   file to the server to be evaluated, and copies the evaluation back to
+   standard output.  With -n, sends the same request num times and reports
+   the latency of the requests on standard error, as a benchmark of the
+   server. */
+
+static char *usage = "Usage: trec_eval_client [-n num] socket_path [-q] [rel_info_file] results_file\n\
+   Ask the trec_eval server listening on socket_path (see trec_eval -S)\n\
+   to evaluate results_file ('-' for standard input) against\n\
+   rel_info_file (default the server's first rel_info_file), and print\n\
+   the evaluation.\n\
+   -q: In addition to summary evaluation, give evaluation for each query\n\
+   -n num: Send the request num times, and print to standard error the\n\
+       min, median, 90th and 99th percentile, max and mean latency\n\
+       over the num requests, in milliseconds.\n";
+
+/* How long to keep retrying connect, while a server starts up */
+#define CONNECT_TIMEOUT_MS 5000
+
+static int read_input (char *file_name, char **buf_ptr, long *size_ptr);
+static int connect_server (char *socket_path);
+static int write_all (int fd, char *buf, long size);
+static int send_request (char *socket_path, char *request, char *results,
+			 long results_size, FILE *out);
+static int comp_double ();
+static double elapsed_ms (struct timeval *start);
+
+int
+main (int argc, char *argv[])
+{
+    long num_requests = 1;
+    char *socket_path;
+    char request[PATH_MAX + 64];
+    char *results;
+    long results_size;
+    double *latency;
+    double total;
+    struct timeval start;
+    FILE *null_out;
+    long i;
+    int c;
+
+    while (-1 != (c = getopt (argc, argv, "+n:"))) {
+	switch (c) {
+	case 'n':
+	    num_requests = atol (optarg);
+	    break;
+	default:
+	    (void) fputs (usage, stderr);
+	    exit (1);
+	}
+    }
+    if (optind + 2 > argc || argc - optind > 4 || num_requests <= 0) {
+	(void) fputs (usage, stderr);
+	exit (1);
+    }
+    socket_path = argv[optind++];
+    (void) signal (SIGPIPE, SIG_IGN);
+
+    /* The results are always sent on the connection, so the server need
+       not be able to see the client's files.  The request line is the
+       remaining arguments, with '-' in place of the results_file */
+    if (UNDEF == read_input (argv[argc-1], &results, &results_size)) {
+	fprintf (stderr, "trec_eval_client: Cannot read '%s'\n", argv[argc-1]);
+	exit (2);
+    }
+    request[0] = '\0';
+    for (i = optind; i < argc - 1; i++) {
+	if (strlen (request) + strlen (argv[i]) + 4 >= sizeof (request)) {
+	    (void) fputs (usage, stderr);
+	    exit (1);
+	}
+	(void) strcat (request, argv[i]);
+	(void) strcat (request, " ");
+    }
+    (void) strcat (request, "-\n");
+
+    if (NULL == (latency = Malloc (num_requests, double)) ||
+	NULL == (null_out = fopen ("/dev/null", "w")))
+	exit (3);
+
+    /* Only the first evaluation is printed */
+    for (i = 0; i < num_requests; i++) {
+	(void) gettimeofday (&start, NULL);
+	if (UNDEF == send_request (socket_path, request, results, results_size,
+				   i == 0 ? stdout : null_out)) {
+	    fprintf (stderr, "trec_eval_client: Request to '%s' failed\n",
+		     socket_path);
+	    exit (4);
+	}
+	latency[i] = elapsed_ms (&start);
+    }
+
+    if (num_requests > 1) {
+	total = 0.0;
+	for (i = 0; i < num_requests; i++)
+	    total += latency[i];
+	qsort ((char *) latency, (int) num_requests, sizeof (double),
+	       comp_double);
+	fprintf (stderr, "requests %ld  latency ms: min %.3f  median %.3f  p90 %.3f  p99 %.3f  max %.3f  mean %.3f\n",
+		 num_requests, latency[0],
+		 latency[num_requests / 2],
+		 latency[(long) (0.90 * (num_requests - 1))],
+		 latency[(long) (0.99 * (num_requests - 1))],
+		 latency[num_requests - 1],
+		 total / num_requests);
+    }
+
+    Free (latency);
+    Free (results);
+    (void) fclose (null_out);
+    exit (0);
+}
+
+/* Read all of file_name ('-' for standard input) into malloc'd *buf_ptr */
+static int
+read_input (char *file_name, char **buf_ptr, long *size_ptr)
+{
+    long size = 0;
+    long max_size = 65536;
+    ssize_t ret;
+    char *buf, *new_buf;
+    int fd;
+
+    if (0 == strcmp (file_name, "-"))
+	fd = 0;
+    else if (-1 == (fd = open (file_name, 0)))
+	return (UNDEF);
+    if (NULL == (buf = malloc ((size_t) max_size)))
+	return (UNDEF);
+    while (1) {
+	if (size == max_size) {
+	    max_size *= 2;
+	    if (NULL == (new_buf = realloc (buf, (size_t) max_size))) {
+		Free (buf);
+		return (UNDEF);
+	    }
+	    buf = new_buf;
+	}
+	if (0 > (ret = read (fd, buf + size, (size_t) (max_size - size)))) {
+	    Free (buf);
+	    return (UNDEF);
+	}
+	if (ret == 0)
+	    break;
+	size += ret;
+    }
+    if (fd != 0)
+	(void) close (fd);
+    *buf_ptr = buf;
+    *size_ptr = size;
+    return (1);
+}
+
+/* Connect to the server, retrying while it may still be starting up */
+static int
+connect_server (char *socket_path)
+{
+    struct sockaddr_un addr;
+    struct timeval start;
+    int sock;
+
+    if (strlen (socket_path) >= sizeof (addr.sun_path))
+	return (UNDEF);
+    (void) memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    (void) strcpy (addr.sun_path, socket_path);
+
+    (void) gettimeofday (&start, NULL);
+    while (1) {
+	if (-1 == (sock = socket (AF_UNIX, SOCK_STREAM, 0)))
+	    return (UNDEF);
+	if (0 == connect (sock, (struct sockaddr *) &addr, sizeof (addr)))
+	    return (sock);
+	(void) close (sock);
+	if ((errno != ENOENT && errno != ECONNREFUSED) ||
+	    elapsed_ms (&start) > CONNECT_TIMEOUT_MS)
+	    return (UNDEF);
+	(void) usleep (10000);
+    }
+}
+
+static int
+write_all (int fd, char *buf, long size)
+{
+    ssize_t ret;
+
+    while (size > 0) {
+	if (0 >= (ret = write (fd, buf, (size_t) size)))
+	    return (UNDEF);
+	buf += ret;
+	size -= ret;
+    }
+    return (1);
+}
+
+/* Send request line and results, and copy the response to out */
+static int
+send_request (char *socket_path, char *request, char *results,
+	      long results_size, FILE *out)
+{
+    char buf[65536];
+    ssize_t ret;
+    int sock;
+
+    if (UNDEF == (sock = connect_server (socket_path)))
+	return (UNDEF);
+    /* If the server rejects the request it may close the connection
+       before reading all the results; its error message is still read */
+    if (UNDEF != write_all (sock, request, (long) strlen (request)) &&
+	UNDEF != write_all (sock, results, results_size))
+	(void) shutdown (sock, SHUT_WR);
+    while (0 < (ret = read (sock, buf, sizeof (buf))))
+	(void) fwrite (buf, 1, (size_t) ret, out);
+    (void) fflush (out);
+    if (-1 == close (sock) || ret < 0)
+	return (UNDEF);
+    return (1);
+}
+
+static int
+comp_double (double *ptr1, double *ptr2)
+{
+    if (*ptr1 < *ptr2)
+	return (-1);
+    return (*ptr1 > *ptr2);
+}
+
+static double
+elapsed_ms (struct timeval *start)
+{
+    struct timeval now;
+
+    (void) gettimeofday (&now, NULL);
+    return ((now.tv_sec - start->tv_sec) * 1000.0 +
+	    (now.tv_usec - start->tv_usec) / 1000.0);
+}
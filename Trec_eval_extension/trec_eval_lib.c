@@ -0,0 +1,501 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "trec_format.h"
+#include "functions.h"
+#include "trec_eval_lib.h"
+
+/* libtrec_eval.  See trec_eval_lib.h for the interface.
+   A context has its own copy of every TREC_MEAS (and of its default
+   PARAMS), so the measures marked and the parameters given for one
+   context do not affect any other, nor the measures of trec_eval itself.
+   Qrels are kept in the same format-specific structures the "qrels" rel
+   format builds from a file (trec_format.h), and each run in those of
+   the "trec_results" format, so that te_eval_run (eval_run.c) evaluates
+   them exactly as trec_eval would.
+*/
+
+extern long te_num_trec_measures;
+extern TREC_MEAS *te_trec_measures[];
+
+struct te_context {
+    EPI epi;
+    TREC_MEAS *meas;                /* Copies of te_trec_measures */
+    TREC_MEAS **meas_ptrs;          /* Pointers to meas, in same order */
+    PARAMS *meas_params;            /* Copies of default params of meas */
+    char **meas_names;              /* Copies of measure arguments */
+    long num_meas_names;
+    TREC_EVAL init_eval;            /* Initialized values of all measures */
+    TREC_EVAL accum_eval;           /* Summary values of last evaluation */
+
+    /* Qrels */
+    ALL_REL_INFO all_rel_info;
+    QID_INDEX qid_index;
+    TEXT_QRELS_INFO *text_qrels_info;
+    TEXT_QRELS *text_qrels;
+    long num_text_qrels;
+    char *qrels_string_pool;        /* qids and docnos of qrels */
+
+    /* Last evaluation */
+    TREC_EVAL *q_evals;
+    long max_num_q_evals;
+    TREC_EVAL_VALUE *q_values;      /* num_values values per q_eval */
+    long max_num_q_values;
+    char *results_qid_pool;         /* qids of q_evals */
+    long max_results_qid_pool;
+};
+
+/* Line of qrels or results, in the form te_sort_lines_qid_docno expects */
+typedef struct {
+    char *qid;
+    char *docno;
+    long index;                     /* Index in input array */
+} LIB_LINE;
+
+/* Evaluations (and create/destroy, which run the measures' init and
+   cleanup procedures) are serialized */
+static pthread_mutex_t lib_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static LIB_LINE *sort_lines (const void *array, long num, size_t elem_size,
+			     long num_threads);
+static int free_qrels (TE_CONTEXT *context);
+
+TE_CONTEXT *
+te_lib_create (char **measures, long num_measures)
+{
+    TE_CONTEXT *context;
+    long m;
+
+    if (NULL == (context = calloc (1, sizeof (TE_CONTEXT))))
+	return (NULL);
+    (void) pthread_mutex_lock (&lib_lock);
+
+    /* trec_eval defaults, but nothing is ever printed.  Measures keep their
+       storage between evaluations, as for several runs of trec_eval */
+    context->epi.query_flag = 0;
+    context->epi.average_complete_flag = 0;
+    context->epi.judged_docs_only_flag = 0;
+    context->epi.summary_flag = 0;
+    context->epi.relation_flag = 1;
+    context->epi.debug_level = 0;
+    context->epi.debug_query = NULL;
+    context->epi.num_docs_in_coll = 0;
+    context->epi.relevance_level = 1;
+    context->epi.max_num_docs_per_topic = MAXLONG;
+    context->epi.rel_info_format = "qrels";
+    context->epi.results_format = "trec_results";
+    context->epi.output_format = "text";
+    context->epi.run_id = NULL;
+    context->epi.zscore_flag = 0;
+    context->epi.num_threads = 1;
+    context->epi.num_runs = MAXLONG;
+    context->epi.run_values = NULL;
+    context->epi.bootstrap_resamples = 0;
+    context->epi.summary_ci = NULL;
+
+    if (NULL == (context->meas = Malloc (te_num_trec_measures, TREC_MEAS)) ||
+	NULL == (context->meas_ptrs = Malloc (te_num_trec_measures,
+					      TREC_MEAS *)) ||
+	NULL == (context->meas_params = Malloc (te_num_trec_measures,
+						PARAMS)) ||
+	NULL == (context->meas_names = Malloc (num_measures + 1, char *)) ||
+	NULL == (context->epi.meas_arg = Malloc (num_measures + 2, MEAS_ARG)))
+	goto error;
+    context->epi.meas_arg[0].measure_name = NULL;
+    for (m = 0; m < te_num_trec_measures; m++) {
+	context->meas[m] = *te_trec_measures[m];
+	context->meas[m].eval_index = -1;
+	if (te_trec_measures[m]->meas_params != NULL) {
+	    context->meas_params[m] = *te_trec_measures[m]->meas_params;
+	    context->meas[m].meas_params = &context->meas_params[m];
+	}
+	context->meas_ptrs[m] = &context->meas[m];
+    }
+
+    /* Mark requested measures.  The arguments are modified, and referred
+       to by epi.meas_arg, so are copied */
+    for (m = 0; m < num_measures || (m == 0 && num_measures == 0); m++) {
+	char *name = num_measures == 0 ? "official" : measures[m];
+	if (NULL == (context->meas_names[m] = Malloc (strlen (name) + 1,
+						      char)))
+	    goto error;
+	context->num_meas_names++;
+	(void) strcpy (context->meas_names[m], name);
+	if (UNDEF == te_mark_measure (&context->epi, context->meas_ptrs,
+				      te_num_trec_measures,
+				      context->meas_names[m])) {
+	    fprintf (stderr, "trec_eval.lib: illegal measure '%s'\n", name);
+	    goto error;
+	}
+    }
+
+    context->init_eval = (TREC_EVAL) {"all", 0, 0, NULL, 0, 0};
+    for (m = 0; m < te_num_trec_measures; m++) {
+	if (MEASURE_MARKED(context->meas_ptrs[m])) {
+	    if (UNDEF == context->meas[m].init_meas (&context->epi,
+						     context->meas_ptrs[m],
+						     &context->init_eval)) {
+		fprintf (stderr,
+			 "trec_eval.lib: Cannot initialize measure '%s'\n",
+			 context->meas[m].name);
+		goto error;
+	    }
+	}
+    }
+    /* No qrels yet */
+    if (UNDEF == te_qid_index_build (&context->all_rel_info,
+				     &context->qid_index))
+	goto error;
+
+    context->accum_eval = context->init_eval;
+    if (NULL == (context->accum_eval.values =
+		 Malloc (MAX (context->init_eval.num_values, 1),
+			 TREC_EVAL_VALUE)))
+	goto error;
+    (void) memcpy (context->accum_eval.values, context->init_eval.values,
+		   context->init_eval.num_values * sizeof (TREC_EVAL_VALUE));
+
+    (void) pthread_mutex_unlock (&lib_lock);
+    return (context);
+
+ error:
+    (void) pthread_mutex_unlock (&lib_lock);
+    te_lib_destroy (context);
+    return (NULL);
+}
+
+EPI *
+te_lib_epi (TE_CONTEXT *context)
+{
+    return (&context->epi);
+}
+
+int
+te_lib_set_qrels (TE_CONTEXT *context, const TE_QREL *qrels, long num_qrels)
+{
+    LIB_LINE *lines;
+    long i, num_qid, pool_size;
+    char *pool_ptr;
+    char *current_qid;
+    REL_INFO *rel_info_ptr;
+    TEXT_QRELS_INFO *text_info_ptr;
+
+    if (UNDEF == free_qrels (context))
+	return (UNDEF);
+    if (num_qrels <= 0)
+	return (te_qid_index_build (&context->all_rel_info,
+				    &context->qid_index));
+
+    /* Sort all lines by qid, then docno */
+    if (NULL == (lines = sort_lines (qrels, num_qrels, sizeof (TE_QREL),
+				     context->epi.num_threads)))
+	return (UNDEF);
+
+    /* Count number of qid, and space needed for copies of qids and
+       docnos */
+    num_qid = 1;
+    pool_size = te_field_len (lines[0].qid) + 1;
+    for (i = 0; i < num_qrels; i++) {
+	if (i > 0 && te_field_cmp (lines[i-1].qid, lines[i].qid)) {
+	    num_qid++;
+	    pool_size += te_field_len (lines[i].qid) + 1;
+	}
+	pool_size += te_field_len (lines[i].docno) + 1;
+    }
+
+    if (NULL == (context->all_rel_info.rel_info = Malloc (num_qid,
+							  REL_INFO)) ||
+	NULL == (context->text_qrels_info = Malloc (num_qid,
+						    TEXT_QRELS_INFO)) ||
+	NULL == (context->text_qrels = Malloc (num_qrels, TEXT_QRELS)) ||
+	NULL == (context->qrels_string_pool = Malloc (pool_size, char)))
+	return (UNDEF);
+
+    rel_info_ptr = context->all_rel_info.rel_info;
+    text_info_ptr = context->text_qrels_info;
+    pool_ptr = context->qrels_string_pool;
+    current_qid = NULL;
+    for (i = 0; i < num_qrels; i++) {
+	if (current_qid == NULL || te_field_cmp (current_qid, lines[i].qid)) {
+	    /* New query.  End old query and start new one */
+	    if (current_qid != NULL) {
+		text_info_ptr->num_text_qrels =
+		    &context->text_qrels[i] - text_info_ptr->text_qrels;
+		text_info_ptr++;
+		rel_info_ptr++;
+	    }
+	    current_qid = te_field_copy (lines[i].qid, &pool_ptr);
+	    text_info_ptr->text_qrels = &context->text_qrels[i];
+	    text_info_ptr->max_num_text_qrels = 0;
+	    text_info_ptr->num_rel_levels = 0;
+	    text_info_ptr->rel_levels = NULL;
+	    *rel_info_ptr = (REL_INFO) {current_qid, "qrels", text_info_ptr};
+	}
+	context->text_qrels[i].docno = te_field_copy (lines[i].docno,
+						      &pool_ptr);
+	context->text_qrels[i].rel = qrels[lines[i].index].rel;
+    }
+    /* End last qid */
+    text_info_ptr->num_text_qrels =
+	&context->text_qrels[num_qrels] - text_info_ptr->text_qrels;
+    context->all_rel_info.num_q_rels = num_qid;
+    context->num_text_qrels = num_qrels;
+    Free (lines);
+
+    return (te_qid_index_build (&context->all_rel_info, &context->qid_index));
+}
+
+long
+te_lib_eval (TE_CONTEXT *context, const TE_RESULT *results, long num_results,
+	     TREC_EVAL **summary, TREC_EVAL **q_evals)
+{
+    LIB_LINE *lines = NULL;
+    ALL_RESULTS all_results;
+    RESULTS *q_results = NULL;
+    TEXT_RESULTS_INFO *text_info = NULL;
+    TEXT_RESULTS *text_results = NULL;
+    long num_values = context->init_eval.num_values;
+    long num_qid, pool_size;
+    long docid_mark;
+    char *pool_ptr;
+    char *current_qid;
+    long i;
+    long num_queries = UNDEF;
+
+    (void) pthread_mutex_lock (&lib_lock);
+    docid_mark = te_docid_mark ();
+
+    /* Build the trec_results format structures for the run, exactly as
+       te_get_trec_results would, except that docnos are not copied */
+    num_qid = 0;
+    pool_size = 0;
+    if (num_results > 0) {
+	if (NULL == (lines = sort_lines (results, num_results,
+					 sizeof (TE_RESULT),
+					 context->epi.num_threads)))
+	    goto done;
+	num_qid = 1;
+	pool_size = te_field_len (lines[0].qid) + 1;
+	for (i = 1; i < num_results; i++) {
+	    if (te_field_cmp (lines[i-1].qid, lines[i].qid)) {
+		num_qid++;
+		pool_size += te_field_len (lines[i].qid) + 1;
+	    }
+	}
+    }
+    if (NULL == (q_results = Malloc (MAX (num_qid, 1), RESULTS)) ||
+	NULL == (text_info = Malloc (MAX (num_qid, 1), TEXT_RESULTS_INFO)) ||
+	NULL == (text_results = Malloc (MAX (num_results, 1), TEXT_RESULTS)) ||
+	NULL == (context->results_qid_pool =
+		 te_chk_and_malloc (context->results_qid_pool,
+				    &context->max_results_qid_pool,
+				    MAX (pool_size, 1), sizeof (char))) ||
+	NULL == (context->q_evals =
+		 te_chk_and_malloc (context->q_evals,
+				    &context->max_num_q_evals,
+				    MAX (num_qid, 1), sizeof (TREC_EVAL))) ||
+	NULL == (context->q_values =
+		 te_chk_and_malloc (context->q_values,
+				    &context->max_num_q_values,
+				    MAX (num_qid * num_values, 1),
+				    sizeof (TREC_EVAL_VALUE))))
+	goto done;
+
+    pool_ptr = context->results_qid_pool;
+    current_qid = NULL;
+    num_qid = 0;
+    for (i = 0; i < num_results; i++) {
+	if (current_qid == NULL || te_field_cmp (current_qid, lines[i].qid)) {
+	    if (current_qid != NULL) {
+		text_info[num_qid-1].num_text_results =
+		    &text_results[i] - text_info[num_qid-1].text_results;
+		te_results_file_pos (&text_info[num_qid-1]);
+	    }
+	    current_qid = te_field_copy (lines[i].qid, &pool_ptr);
+	    text_info[num_qid].text_results = &text_results[i];
+	    text_info[num_qid].max_num_text_results = 0;
+	    q_results[num_qid] = (RESULTS) {current_qid, "libtrec_eval",
+					    "trec_results", &text_info[num_qid]};
+	    num_qid++;
+	}
+	text_results[i].docno = lines[i].docno;
+	text_results[i].sim = results[lines[i].index].sim;
+	text_results[i].file_pos = lines[i].index;
+    }
+    if (num_qid > 0) {
+	text_info[num_qid-1].num_text_results =
+	    &text_results[num_results] - text_info[num_qid-1].text_results;
+	te_results_file_pos (&text_info[num_qid-1]);
+    }
+    all_results.num_q_results = num_qid;
+    all_results.max_num_q_results = num_qid;
+    all_results.results = q_results;
+
+    /* Map the docnos of qrels and results to docids */
+    if ((context->num_text_qrels > 0 &&
+	 UNDEF == te_docid_register (context->text_qrels,
+				     context->num_text_qrels,
+				     sizeof (TEXT_QRELS),
+				     offsetof (TEXT_QRELS, docno),
+				     offsetof (TEXT_QRELS, docid))) ||
+	UNDEF == te_docid_register (text_results, num_results,
+				    sizeof (TEXT_RESULTS),
+				    offsetof (TEXT_RESULTS, docno),
+				    offsetof (TEXT_RESULTS, docid)) ||
+	UNDEF == te_docid_assign (context->epi.num_threads))
+	goto done;
+
+    for (i = 0; i < num_qid; i++)
+	context->q_evals[i].values = &context->q_values[i * num_values];
+    context->accum_eval = (TREC_EVAL) {"all", 0, 0,
+				       context->accum_eval.values,
+				       num_values, num_values};
+    (void) memcpy (context->accum_eval.values, context->init_eval.values,
+		   num_values * sizeof (TREC_EVAL_VALUE));
+    num_queries = 0;
+    if (num_qid > 0)
+	num_queries = te_eval_run (&context->epi, context->meas_ptrs,
+				   te_num_trec_measures,
+				   &context->all_rel_info,
+				   &context->qid_index, NULL, &all_results,
+				   &context->accum_eval, context->q_evals);
+
+ done:
+    /* The per query pools of the form_* procedures are keyed by qid, so
+       must not survive into another evaluation */
+    if (UNDEF == te_docid_release (docid_mark) ||
+	UNDEF == te_cleanup_form_procs ())
+	num_queries = UNDEF;
+    (void) pthread_mutex_unlock (&lib_lock);
+    if (lines != NULL)
+	Free (lines);
+    if (q_results != NULL)
+	Free (q_results);
+    if (text_info != NULL)
+	Free (text_info);
+    if (text_results != NULL)
+	Free (text_results);
+
+    *summary = &context->accum_eval;
+    *q_evals = context->q_evals;
+    return (num_queries);
+}
+
+int
+te_lib_value (const TREC_EVAL *eval, const char *name, double *value)
+{
+    long i;
+
+    for (i = 0; i < eval->num_values; i++) {
+	if (0 == strcmp (eval->values[i].name, name)) {
+	    *value = eval->values[i].value;
+	    return (1);
+	}
+    }
+    return (UNDEF);
+}
+
+void
+te_lib_destroy (TE_CONTEXT *context)
+{
+    long m;
+
+    if (context == NULL)
+	return;
+    (void) pthread_mutex_lock (&lib_lock);
+
+    /* Free measure storage (names and params) without printing */
+    context->epi.summary_flag = 0;
+    context->epi.num_runs = 1;
+    if (context->accum_eval.values != NULL) {
+	for (m = 0; m < te_num_trec_measures; m++) {
+	    if (MEASURE_REQUESTED(context->meas_ptrs[m]))
+		(void) context->meas[m].print_final_and_cleanup_meas
+		    (&context->epi, context->meas_ptrs[m],
+		     &context->accum_eval);
+	}
+    }
+    (void) pthread_mutex_unlock (&lib_lock);
+
+    (void) free_qrels (context);
+    for (m = 0; m < context->num_meas_names; m++)
+	Free (context->meas_names[m]);
+    if (context->meas_names != NULL)
+	Free (context->meas_names);
+    if (context->epi.meas_arg != NULL)
+	Free (context->epi.meas_arg);
+    if (context->meas != NULL)
+	Free (context->meas);
+    if (context->meas_ptrs != NULL)
+	Free (context->meas_ptrs);
+    if (context->meas_params != NULL)
+	Free (context->meas_params);
+    if (context->init_eval.values != NULL)
+	Free (context->init_eval.values);
+    if (context->accum_eval.values != NULL)
+	Free (context->accum_eval.values);
+    if (context->q_evals != NULL)
+	Free (context->q_evals);
+    if (context->q_values != NULL)
+	Free (context->q_values);
+    if (context->results_qid_pool != NULL)
+	Free (context->results_qid_pool);
+    Free (context);
+}
+
+/* Return malloc'd lines giving the qid, docno and index of each of the
+   num elements of array (whose first members are char *qid, char *docno),
+   sorted by qid, then docno */
+static LIB_LINE *
+sort_lines (const void *array, long num, size_t elem_size, long num_threads)
+{
+    LIB_LINE *lines;
+    long i;
+
+    if (NULL == (lines = Malloc (num, LIB_LINE)))
+	return (NULL);
+    for (i = 0; i < num; i++) {
+	lines[i].qid = ((char **) ((char *) array + i * elem_size))[0];
+	lines[i].docno = ((char **) ((char *) array + i * elem_size))[1];
+	lines[i].index = i;
+    }
+    if (UNDEF == te_sort_lines_qid_docno (lines, num, sizeof (LIB_LINE),
+					  num_threads)) {
+	Free (lines);
+	return (NULL);
+    }
+    return (lines);
+}
+
+static int
+free_qrels (TE_CONTEXT *context)
+{
+    if (UNDEF == te_qid_index_cleanup (&context->qid_index))
+	return (UNDEF);
+    if (context->all_rel_info.rel_info != NULL) {
+	Free (context->all_rel_info.rel_info);
+	context->all_rel_info.rel_info = NULL;
+    }
+    if (context->text_qrels_info != NULL) {
+	Free (context->text_qrels_info);
+	context->text_qrels_info = NULL;
+    }
+    if (context->text_qrels != NULL) {
+	Free (context->text_qrels);
+	context->text_qrels = NULL;
+    }
+    if (context->qrels_string_pool != NULL) {
+	Free (context->qrels_string_pool);
+	context->qrels_string_pool = NULL;
+    }
+    context->all_rel_info.num_q_rels = 0;
+    context->num_text_qrels = 0;
+    return (1);
+}
@@ -0,0 +1,91 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+#ifndef TRECEVALLIBH
+#define TRECEVALLIBH
+
+#include "common.h"
+#include "trec_eval.h"
+
+/* libtrec_eval: calculate trec_eval measures from within another program,
+   with qrels and results held in memory rather than in files, and the
+   values returned rather than printed.  Build with 'make libtrec_eval.a'
+   or 'make libtrec_eval.so'.  See trec_eval_lib_test.c for an example.
+
+   A context holds a set of measures (as given to trec_eval -m) and a set
+   of qrels.  Once created, any number of runs may be evaluated against
+   it, each giving the same values trec_eval would give for that run:
+
+       TE_CONTEXT *context;
+       TREC_EVAL *summary, *q_evals;
+       char *measures[] = {"map", "ndcg_cut.10,20"};
+       long num_q;
+       double map;
+
+       context = te_lib_create (measures, 2);
+       te_lib_set_qrels (context, qrels, num_qrels);
+       num_q = te_lib_eval (context, results, num_results, &summary, &q_evals);
+       te_lib_value (summary, "map", &map);
+       ...
+       te_lib_destroy (context);
+
+   Each context is independent, and contexts may be used from different
+   threads.  Evaluations are serialized by a lock within the library (the
+   docid mapping of utility_docid.c and the measures' query caches are
+   process state); a single evaluation uses up to epi->num_threads
+   threads.  Return values follow trec_eval: UNDEF on error, with a
+   message on stderr. */
+
+/* One judgement of a qrels file: qid iter docno rel */
+typedef struct {
+    char *qid;
+    char *docno;
+    long rel;
+} TE_QREL;
+
+/* One retrieved document of a results file: qid iter docno rank sim runid.
+   As with trec_eval, rank is taken from sim (ties broken by docno) */
+typedef struct {
+    char *qid;
+    char *docno;
+    float sim;
+} TE_RESULT;
+
+typedef struct te_context TE_CONTEXT;
+
+/* Create a context calculating the num_measures measures (each as for
+   trec_eval -m, eg "P.5,10" or "all_trec"; "official" if num_measures
+   is 0).  Return NULL if error */
+TE_CONTEXT *te_lib_create (char **measures, long num_measures);
+
+/* Evaluation parameters of context, initially trec_eval's defaults.
+   relevance_level, average_complete_flag, judged_docs_only_flag,
+   num_docs_in_coll, max_num_docs_per_topic and num_threads may be
+   changed between evaluations (the other fields must not be) */
+EPI *te_lib_epi (TE_CONTEXT *context);
+
+/* Set the qrels of context (in any order), replacing any earlier ones.
+   The strings are copied */
+int te_lib_set_qrels (TE_CONTEXT *context, const TE_QREL *qrels,
+		      long num_qrels);
+
+/* Evaluate the num_results results (in any order) against the qrels of
+   context.  *summary is set to the summary values over all queries, and
+   *q_evals to an array of the values of each query evaluated, in qid
+   order.  Both are owned by context, and valid until its next
+   te_lib_eval or te_lib_destroy.  The strings of results are not kept.
+   Return the number of queries evaluated (the length of *q_evals), UNDEF
+   if error */
+long te_lib_eval (TE_CONTEXT *context, const TE_RESULT *results,
+		  long num_results, TREC_EVAL **summary, TREC_EVAL **q_evals);
+
+/* Find the value of the measure with full name name (eg "P_10") in eval.
+   Return UNDEF if eval has no such measure */
+int te_lib_value (const TREC_EVAL *eval, const char *name, double *value);
+
+void te_lib_destroy (TE_CONTEXT *context);
+
+#endif /* TRECEVALLIBH */
@@ -0,0 +1,174 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval_lib.h"
+
+/* Example and test of libtrec_eval.  Reads a qrels file and a results
+   file into memory, evaluates the results with the library, and prints
+   all values (of each query if -q, then the summary).
+   The run is evaluated twice with separate contexts, the second context
+   created before the first is used, to check that contexts with
+   different measures do not interfere. */
+
+static char *usage = "Usage: trec_eval_lib_test [-q] {-m measure}* qrels_file results_file\n";
+
+static int read_qrels (char *file_name, TE_QREL **qrels, long *num_qrels);
+static int read_results (char *file_name, TE_RESULT **results,
+			 long *num_results);
+static void print_eval (const TREC_EVAL *eval);
+
+int
+main (int argc, char *argv[])
+{
+    char **measures;
+    long num_measures = 0;
+    long query_flag = 0;
+    TE_QREL *qrels;
+    long num_qrels;
+    TE_RESULT *results;
+    long num_results;
+    TE_CONTEXT *context, *other_context;
+    TREC_EVAL *summary, *q_evals;
+    char *other_measures[] = {"P.7", "map"};
+    long num_q;
+    double value;
+    long i;
+    int c;
+
+    if (NULL == (measures = Malloc (argc, char *)))
+	exit (3);
+    while (-1 != (c = getopt (argc, argv, "qm:"))) {
+	switch (c) {
+	case 'q':
+	    query_flag = 1;
+	    break;
+	case 'm':
+	    measures[num_measures++] = optarg;
+	    break;
+	default:
+	    (void) fputs (usage, stderr);
+	    exit (1);
+	}
+    }
+    if (optind + 2 != argc) {
+	(void) fputs (usage, stderr);
+	exit (1);
+    }
+    if (UNDEF == read_qrels (argv[optind], &qrels, &num_qrels) ||
+	UNDEF == read_results (argv[optind+1], &results, &num_results)) {
+	fprintf (stderr, "trec_eval_lib_test: Cannot read input\n");
+	exit (2);
+    }
+
+    if (NULL == (context = te_lib_create (measures, num_measures)) ||
+	NULL == (other_context = te_lib_create (other_measures, 2)) ||
+	UNDEF == te_lib_set_qrels (context, qrels, num_qrels) ||
+	UNDEF == te_lib_set_qrels (other_context, qrels, num_qrels))
+	exit (3);
+
+    if (UNDEF == (num_q = te_lib_eval (context, results, num_results,
+				       &summary, &q_evals)))
+	exit (4);
+    if (query_flag) {
+	for (i = 0; i < num_q; i++)
+	    print_eval (&q_evals[i]);
+    }
+    print_eval (summary);
+
+    /* Other context: P_7 is not in the default P cutoffs */
+    if (UNDEF == te_lib_eval (other_context, results, num_results,
+			      &summary, &q_evals) ||
+	UNDEF == te_lib_value (summary, "P_7", &value))
+	exit (4);
+    printf ("%-22s\t%s\t%6.4f\n", "P_7", summary->qid, value);
+
+    te_lib_destroy (context);
+    te_lib_destroy (other_context);
+    for (i = 0; i < num_qrels; i++) {
+	Free (qrels[i].qid);
+	Free (qrels[i].docno);
+    }
+    for (i = 0; i < num_results; i++) {
+	Free (results[i].qid);
+	Free (results[i].docno);
+    }
+    Free (qrels);
+    Free (results);
+    Free (measures);
+    exit (0);
+}
+
+static void
+print_eval (const TREC_EVAL *eval)
+{
+    long i;
+
+    for (i = 0; i < eval->num_values; i++)
+	printf ("%-22s\t%s\t%6.4f\n", eval->values[i].name, eval->qid,
+		eval->values[i].value);
+}
+
+/* Read lines "qid iter docno rel" */
+static int
+read_qrels (char *file_name, TE_QREL **qrels, long *num_qrels)
+{
+    FILE *fd;
+    char qid[256], iter[256], docno[256];
+    long rel;
+    long max_num_qrels = 0;
+
+    *qrels = NULL;
+    *num_qrels = 0;
+    if (NULL == (fd = fopen (file_name, "r")))
+	return (UNDEF);
+    while (4 == fscanf (fd, "%255s %255s %255s %ld", qid, iter, docno,
+			&rel)) {
+	if (*num_qrels == max_num_qrels) {
+	    max_num_qrels = 2 * max_num_qrels + INIT_NUM_RELS;
+	    if (NULL == (*qrels = Realloc (*qrels, max_num_qrels, TE_QREL)))
+		return (UNDEF);
+	}
+	if (NULL == ((*qrels)[*num_qrels].qid = strdup (qid)) ||
+	    NULL == ((*qrels)[*num_qrels].docno = strdup (docno)))
+	    return (UNDEF);
+	(*qrels)[(*num_qrels)++].rel = rel;
+    }
+    (void) fclose (fd);
+    return (1);
+}
+
+/* Read lines "qid iter docno rank sim runid" */
+static int
+read_results (char *file_name, TE_RESULT **results, long *num_results)
+{
+    FILE *fd;
+    char qid[256], iter[256], docno[256], rank[256], run_id[256];
+    float sim;
+    long max_num_results = 0;
+
+    *results = NULL;
+    *num_results = 0;
+    if (NULL == (fd = fopen (file_name, "r")))
+	return (UNDEF);
+    while (6 == fscanf (fd, "%255s %255s %255s %255s %f %255s", qid, iter,
+			docno, rank, &sim, run_id)) {
+	if (*num_results == max_num_results) {
+	    max_num_results = 2 * max_num_results + INIT_NUM_RESULTS;
+	    if (NULL == (*results = Realloc (*results, max_num_results,
+					     TE_RESULT)))
+		return (UNDEF);
+	}
+	if (NULL == ((*results)[*num_results].qid = strdup (qid)) ||
+	    NULL == ((*results)[*num_results].docno = strdup (docno)))
+	    return (UNDEF);
+	(*results)[(*num_results)++].sim = sim;
+    }
+    (void) fclose (fd);
+    return (1);
+}
@@ -12,7 +12,14 @@
 /* trec_results - pointed to by results->q_results */
 typedef struct {                    /* For each retrieved document result */
     char *docno;                       /* document id */
+    int docid;                         /* dense id of docno (in docno
+					  order), see utility_docid.c */
     float sim;                         /* score */
+    long file_pos;                     /* position (from 1) of the result
+					  among the lines of its query in
+					  the input, 0 if those lines were
+					  not all together (see
+					  te_results_file_pos) */
 } TEXT_RESULTS;
 
 typedef struct {                    /* For each query in retrieved results */
@@ -24,6 +31,8 @@ typedef struct {                    /* For each query in retrieved results */
 /* qrels pointed to by rel_info->q_rel_info */
 typedef struct {                    /* For each relevance judgement */
     char *docno;                       /* document id */
+    int docid;                         /* dense id of docno (in docno
+					  order), see utility_docid.c */
     long rel;                          /* document judgement */
 } TEXT_QRELS;
 
@@ -33,6 +42,11 @@ typedef struct {                    /* For each query in rel judgments */
 					  Private, unused */
     TEXT_QRELS *text_qrels;            /* Array of judged TEXT_QRELS.
 					  Kept sorted by docno */
+    long num_rel_levels;               /* Number of rel_levels counted in
+					  rel_levels, 0 if not counted */
+    int *rel_levels;                   /* Number of docs judged at each
+					  rel_level, if counted by the
+					  rel_info format (eg, qrels_bin) */
 } TEXT_QRELS_INFO;
 
 typedef struct {                    /* For each jg in query */
@@ -47,38 +61,34 @@ typedef struct {                    /* For each query in rel judgments */
 } TEXT_QRELS_JG_INFO;
 
 
-/*ADDED BY LUCAS*/
-typedef struct {                    /* For each relevance judgement */
-    char *docno;                       /* document id */
-    long rel;                          /* document judgement of relevance*/
-    long cred;                        /* document judgement of credibility */
-} TEXT_QRELS_CRED;
-
-typedef struct {                    /* For each query in rel judgments */
-    long num_text_qrels;               /* number of judged documents */
-    long max_num_text_qrels;           /* Num docs space reserved for 
-            Private, unused */
-    TEXT_QRELS_CRED *text_qrels_cred;            /* Array of judged TEXT_QRELS.
-            Kept sorted by docno */
-} TEXT_QRELS_CRED_INFO;
+/* qrels_multiaspect pointed to by rel_info->q_rel_info (also used for
+   qrels_twoaspects and qrels_threeaspects, see get_qrels_multiaspect.c) */
+#define MAX_QRELS_ASPECTS 8
 
-
-typedef struct {                    /* For each relevance judgement */
+typedef struct {                    /* For each judged document */
     char *docno;                       /* document id */
-    long rel;                          /* document judgement of relevance*/
-    long cred;
-    long third;                        /* document judgement of credibility */
-} TEXT_QRELS_THREE;
+    int docid;                         /* dense id of docno (in docno
+					  order), see utility_docid.c */
+} TEXT_QRELS_MULTI;
 
 typedef struct {                    /* For each query in rel judgments */
     long num_text_qrels;               /* number of judged documents */
-    long max_num_text_qrels;           /* Num docs space reserved for 
-            Private, unused */
-    TEXT_QRELS_THREE *text_qrels_three;            /* Array of judged TEXT_QRELS.
-            Kept sorted by docno */
-} TEXT_QRELS_THREE_INFO;
-
-
+    long num_aspects;                  /* number of judgements of each doc */
+    TEXT_QRELS_MULTI *text_qrels;      /* Array of judged docs.
+					  Kept sorted by docno */
+    short *rels;                       /* Judgements, a column per aspect:
+					  judgement of aspect a of
+					  text_qrels[i] is
+					  rels[a * num_text_qrels + i] */
+    long num_rel_levels;               /* Number of rel_levels counted in
+					  rel_levels, 0 if not counted */
+    int *rel_levels;                   /* Number of docs judged at each
+					  rel_level, if counted by the
+					  rel_info format (eg, qrels_bin):
+					  count of rel_level l of aspect a
+					  is rel_levels[a * num_rel_levels
+					  + l] */
+} TEXT_QRELS_MULTI_INFO;
 
 /* prefs pointed to by rel_info->q_rel_info */
 typedef struct {                 /* For each line in rel prefs judgments */
@@ -86,6 +96,7 @@ typedef struct {                 /* For each line in rel prefs judgments */
     char *jsg;                      /* Judgment subgroup id */          
     float rel_level;                /* Relevance level of this docno */
     char *docno;                    /* docno */
+    int docid;                      /* dense id of docno */
 } TEXT_PREFS;
 
 typedef struct {                    /* For each query in rel judgements */
@@ -130,6 +141,111 @@ typedef struct {
 			      length of list is rank_rel->num_ret */
 } RES_RELS;
 
+/* Statistics of the ranking of RES_RELS (of the first aspect) that the
+   standard measures (map, P, bpref, iprec_at_recall, ...) are calculated
+   from, gathered in a single pass down results_rel_list (see
+   form_rank_stats.c).  Prefix arrays give the values at any cutoff */
+typedef struct {
+    long *rel_ret;         /* rel_ret[i] is the number of relevant docs in
+			      the top i docs (0 <= i <= num_ret) */
+    double *prec_sum;      /* prec_sum[i] is the sum of the precisions at
+			      the relevant docs in the top i docs */
+    double *int_prec;      /* int_prec[r] (1 <= r <= num_rel_ret) is the
+			      interpolated precision at the r'th relevant
+			      doc retrieved: the max precision at its rank
+			      or below.  int_prec[0] is that of the first
+			      relevant doc (num_rel_ret/num_ret if none) */
+    long first_rel;        /* Rank (from 1) of the first relevant doc,
+			      0 if none retrieved */
+    double bpref_sum;      /* Sums over judged relevant docs of bpref, */
+    double infap_sum;      /* infAP and binG terms, not yet averaged */
+    double bin_g_sum;      /* over num_rel */
+} RANK_STATS;
+
+/* Per-query evaluation frame: the retrieved docs of a query sorted and
+   merged with its judgements once, for all the measures evaluating the
+   query.  RES_RELS (of each aspect) and the ideal orderings of the
+   multi-aspect measures are all derived from it.  Used for qrels (one
+   aspect) and qrels_multiaspect (up to MAX_QRELS_ASPECTS aspects, eg
+   rel and cred of qrels_twoaspects); see form_frame.c */
+
+typedef struct {
+    char *docno;
+    int docid;
+    float sim;
+    long rank;             /* Rank (from 1) among all retrieved docs, by
+			      decreasing sim with ties broken by docno
+			      (see num_ranked of EVAL_FRAME) */
+} FRAME_DOC;
+
+typedef struct {
+    long num_aspects;      /* Number of judgement aspects of rel_info */
+
+    long num_docs;         /* Number of retrieved docs (before -M) */
+    FRAME_DOC *docs;       /* Retrieved docs, in docno order */
+    long *ranked;          /* ranked[i] is the index in docs of the doc
+			      with rank i+1 */
+    long num_ranked;       /* Docs in rank order in ranked (and with their
+			      rank in docs): the top max_num_docs_per_topic
+			      until all are set by te_form_frame_rank_all.
+			      The rest are in no particular order */
+    long *rels[MAX_QRELS_ASPECTS];
+                           /* rels[a][i] is the judgement of aspect a of
+			      docs[i]: value in the qrels, RELVALUE_NONPOOL
+			      or RELVALUE_UNJUDGED */
+
+    long num_qrels;        /* Number of judged docs */
+    long *qrels_rels[MAX_QRELS_ASPECTS];
+                           /* Judgement of aspect a of each judged doc
+			      (as given, possibly negative), in docno order */
+
+    RES_RELS res_rels[MAX_QRELS_ASPECTS];
+                           /* Ranked judgements of aspect a, among the
+			      top max_num_docs_per_topic docs */
+
+    long num_ideal;        /* Number of docs in ideal orderings.  The
+			      multi-aspect measures take the first
+			      max_num_docs_per_topic docs in docno order
+			      (not rank order) */
+    long *ideal_pos[MAX_QRELS_ASPECTS];
+                           /* ideal_pos[a][i] (i < num_ideal) is the
+			      position (from 0) of docs[i] in the ideal
+			      ordering of aspect a: by decreasing judgement
+			      (unjudged as 0), ties broken by rank.
+			      NULL until set (for all aspects) by
+			      te_form_frame_ideal */
+
+    RANK_STATS *rank_stats;
+                           /* Statistics of res_rels[0].  NULL until set
+			      by te_form_rank_stats */
+} EVAL_FRAME;
+
+/* Gains of the rel_levels of a query for the nDCG family of measures,
+   with the rank discounts they are summed with; see form_gains.c */
+typedef struct {
+    long rel_level;
+    long num_at_level;     /* Number of judged docs at rel_level */
+    double gain;
+} REL_GAIN;
+
+typedef struct {
+    REL_GAIN *rel_gains;   /* Every judged rel_level and every rel_level
+			      given a gain as parameter, sorted by
+			      increasing gain.  The ideal ranking takes
+			      them from the last */
+    long num_gains;
+    long total_num_at_levels;
+    double *level_gains;   /* level_gains[rel - min_level] is the gain of
+			      rel_level rel, for min_level <= rel <
+			      min_level + num_level_gains (the rel_levels
+			      that can be retrieved); 0.0 for other rel */
+    long min_level;
+    long num_level_gains;
+    const double *discount;/* discount[i] = log2 (i+2), the discount of
+			      rank i+1, for every retrieved or ideal rank
+			      of the query (see te_form_frame_discount) */
+} GAINS;
+
 /* If Judgments group info is included (qrels_jg), then return multiple jgs */
 typedef struct {
     char *qid;
@@ -280,6 +396,42 @@ typedef struct {
    input format RESULTS to an intermediate form appropriate to the two
    input formats that can be more directly used by several measures */
 
+/* Positions of trec_results within their query in the input */
+void te_results_file_pos (TEXT_RESULTS_INFO *text_results_info);
+/* trec_results read one query at a time (see get_trec_results.c) */
+int te_get_trec_results_query (EPI *epi, char *text_results_file,
+			       RESULTS **results);
+int te_get_trec_results_query_cleanup ();
+/* trec_results to a trec_results_bin file (see get_trec_results_bin.c) */
+int te_put_trec_results_bin (const ALL_RESULTS *all_results,
+			     const char *bin_results_file);
+/* qrels or qrels_multiaspect to a qrels_bin file (see get_qrels_bin.c) */
+int te_put_qrels_bin (const ALL_REL_INFO *all_rel_info,
+		      const char *bin_qrels_file);
+
+/* trec_results and qrels (of num_aspects aspects) to EVAL_FRAME */
+int te_form_frame (const EPI *epi, const REL_INFO *rel_info,
+		   const RESULTS *results, long num_aspects,
+		   EVAL_FRAME **frame);
+int te_form_frame_rank_all (EVAL_FRAME *frame);
+int te_form_frame_ideal (EVAL_FRAME *frame);
+int te_form_frame_weights (const TREC_MEAS *tm, const EVAL_FRAME *frame,
+			   double *weights);
+int te_form_frame_discount (long num, const double **discount);
+
+/* RES_RELS and rel_level=gain parameters to GAINS */
+int te_form_gains (const RES_RELS *res_rels, const PARAMS *params,
+		   GAINS *gains);
+double te_gains_gain (const GAINS *gains, long rel_level);
+double te_gains_dcg (const GAINS *gains, const long *rel_list,
+		     long start, long end);
+double te_gains_ideal_dcg (const GAINS *gains, long start, long end);
+
+/* trec_results and qrels to RANK_STATS of RES_RELS */
+int te_form_rank_stats (const EPI *epi, const REL_INFO *rel_info,
+			const RESULTS *results, RES_RELS *res_rels,
+			RANK_STATS *rank_stats);
+
 /* trec_results and qrels to RES_RELS */
 int te_form_res_rels (const EPI *epi, const REL_INFO *rel_info,
                       const RESULTS *results, RES_RELS *res_rels);
@@ -0,0 +1,427 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Utility procedures to map every docno of the input files to a dense
+   integer docid, so that merging results with rel_info, duplicate checks
+   and sorts by docno compare integers instead of strings.
+
+   Each loader registers its array(s) of per document records with
+   te_docid_register, giving the offsets of the docno (a field, see
+   te_field_cmp) and of the int docid within each record.  Once all input
+   has been loaded, te_docid_assign sorts all registered docnos (with the
+   radix sort of te_sort_lines_qid_docno) and stores each docid.  Docids are assigned in docno order (0 for the
+   lexicographically smallest docno), so comparing docids gives exactly
+   the same result as comparing the docnos themselves, and docno order
+   tie-breaks are unchanged.
+
+   When a run is evaluated one query at a time as it is read (trec_eval
+   -G), the docids of the arrays registered so far (rel_info) are instead
+   assigned once by te_docid_assign_resident, spread out over the range
+   of int: the k'th distinct docno gets docid (k+1) * stride.  Each query
+   of the run is then given docids by te_docid_assign_group: the docid of
+   the same resident docno if there is one, otherwise a docid in the gap
+   between the resident docnos it falls between, so that docids still
+   compare as the docnos do.  A gap has room for stride-1 docnos of a
+   query; if a query needs more, docids are assigned densely to rel_info
+   and that query together (as te_docid_assign would), and spread out
+   again for the next query.
+*/
+
+typedef struct {
+    char *array;
+    long num;
+    size_t elem_size;
+    size_t docno_offset;
+    size_t docid_offset;
+} DOCID_ARRAY;
+
+/* One registered docno, in the form te_sort_lines_qid_docno expects */
+typedef struct {
+    char *qid;                  /* Always "" */
+    char *docno;
+    int *docid_ptr;             /* Where to store docid of docno */
+} DOCID_SLOT;
+
+static int sort_slots (long num_threads, DOCID_SLOT **slots_ptr,
+		       long *num_slots_ptr);
+static long find_resident (const char *docno, long low);
+static uint64_t docno_key (const char *docno);
+
+/* static pools of memory, allocated here and never changed.  */
+static DOCID_ARRAY *docid_arrays = NULL;
+static long num_docid_arrays = 0;
+static long max_num_docid_arrays = 0;
+static long num_docids = 0;
+
+/* Distinct resident docnos in docno order, and the spacing of their
+   docids (see te_docid_assign_resident) */
+static char **resident_docnos = NULL;
+static long max_resident_docnos = 0;
+static long num_resident_docnos = 0;
+/* Length of the prefix common to all resident docnos, and the next 8
+   bytes of each docno as an integer (so that most comparisons while
+   searching them are of integers) */
+static long resident_prefix_len = 0;
+static uint64_t *resident_keys = NULL;
+static long max_resident_keys = 0;
+static long resident_stride = 0;
+static long resident_dense = 0;     /* Resident docids currently dense */
+static DOCID_SLOT *group_slots = NULL;
+static long max_group_slots = 0;
+
+int
+te_docid_register (void *array, long num, size_t elem_size,
+		   size_t docno_offset, size_t docid_offset)
+{
+    if (NULL == (docid_arrays = te_chk_and_realloc (docid_arrays,
+						    &max_num_docid_arrays,
+						    num_docid_arrays + 1,
+						    sizeof (DOCID_ARRAY))))
+	return (UNDEF);
+    docid_arrays[num_docid_arrays++] =
+	(DOCID_ARRAY) {(char *) array, num, elem_size, docno_offset,
+		       docid_offset};
+    return (1);
+}
+
+int
+te_docid_assign (long num_threads)
+{
+    DOCID_SLOT *slots;
+    long num_slots;
+    long i;
+    long docid;
+
+    num_docids = 0;
+    if (UNDEF == sort_slots (num_threads, &slots, &num_slots))
+	return (UNDEF);
+    if (num_slots == 0)
+	return (1);
+
+    /* Number distinct docnos consecutively */
+    docid = 0;
+    *slots[0].docid_ptr = 0;
+    for (i = 1; i < num_slots; i++) {
+	if (te_field_cmp (slots[i-1].docno, slots[i].docno)) {
+	    if (++docid > INT_MAX) {
+		fprintf (stderr, "trec_eval.docid: Too many docnos\n");
+		return (UNDEF);
+	    }
+	}
+	*slots[i].docid_ptr = docid;
+    }
+    num_docids = docid + 1;
+
+    Free (slots);
+    return (1);
+}
+
+/* Gather every registered docno into a malloc'd array of slots, and
+   sort them all by docno.  *slots_ptr is not allocated if there are none */
+static int
+sort_slots (long num_threads, DOCID_SLOT **slots_ptr, long *num_slots_ptr)
+{
+    DOCID_SLOT *slots;
+    DOCID_SLOT *slot_ptr;
+    long num_slots;
+    DOCID_ARRAY *arr;
+    char *ptr, *end;
+    long a;
+
+    num_slots = 0;
+    for (a = 0; a < num_docid_arrays; a++)
+	num_slots += docid_arrays[a].num;
+    *slots_ptr = NULL;
+    *num_slots_ptr = num_slots;
+    if (num_slots == 0)
+	return (1);
+
+    if (NULL == (slots = Malloc (num_slots, DOCID_SLOT)))
+	return (UNDEF);
+    slot_ptr = slots;
+    for (a = 0; a < num_docid_arrays; a++) {
+	arr = &docid_arrays[a];
+	end = arr->array + arr->num * arr->elem_size;
+	for (ptr = arr->array; ptr < end; ptr += arr->elem_size) {
+	    slot_ptr->qid = "";
+	    slot_ptr->docno = *(char **) (ptr + arr->docno_offset);
+	    slot_ptr->docid_ptr = (int *) (ptr + arr->docid_offset);
+	    slot_ptr++;
+	}
+    }
+    if (UNDEF == te_sort_lines_qid_docno (slots, num_slots,
+					  sizeof (DOCID_SLOT), num_threads))
+	return (UNDEF);
+    *slots_ptr = slots;
+    return (1);
+}
+
+/* Assign the docids of all arrays registered so far, spread out so that
+   te_docid_assign_group can fit the docnos of a query in between */
+int
+te_docid_assign_resident (long num_threads)
+{
+    DOCID_SLOT *slots;
+    long num_slots;
+    long i, k;
+
+    num_resident_docnos = 0;
+    resident_dense = 0;
+    if (UNDEF == sort_slots (num_threads, &slots, &num_slots))
+	return (UNDEF);
+
+    /* Keep each distinct docno once */
+    if (NULL == (resident_docnos =
+		 te_chk_and_malloc (resident_docnos, &max_resident_docnos,
+				    num_slots + 1, sizeof (char *))))
+	return (UNDEF);
+    for (i = 0; i < num_slots; i++) {
+	if (i == 0 || te_field_cmp (slots[i-1].docno, slots[i].docno))
+	    resident_docnos[num_resident_docnos++] = slots[i].docno;
+    }
+    if (num_resident_docnos >= INT_MAX) {
+	fprintf (stderr, "trec_eval.docid: Too many docnos\n");
+	return (UNDEF);
+    }
+    num_docids = num_resident_docnos;
+
+    resident_prefix_len = 0;
+    if (num_resident_docnos > 0) {
+	/* Docnos are sorted, so a prefix of the first and last is common */
+	while (resident_docnos[0][resident_prefix_len] ==
+	       resident_docnos[num_resident_docnos-1][resident_prefix_len] &&
+	       ! END_FIELD ((unsigned char)
+			    resident_docnos[0][resident_prefix_len]))
+	    resident_prefix_len++;
+    }
+    if (NULL == (resident_keys =
+		 te_chk_and_malloc (resident_keys, &max_resident_keys,
+				    num_resident_docnos + 1,
+				    sizeof (uint64_t))))
+	return (UNDEF);
+    for (k = 0; k < num_resident_docnos; k++)
+	resident_keys[k] = docno_key (resident_docnos[k]);
+
+    /* Gap k (before the k'th docno, k = 0..num_resident_docnos) holds
+       docids k * stride + 1 to (k+1) * stride - 1 */
+    resident_stride = INT_MAX / (num_resident_docnos + 1);
+    k = -1;
+    for (i = 0; i < num_slots; i++) {
+	if (i == 0 || te_field_cmp (slots[i-1].docno, slots[i].docno))
+	    k++;
+	*slots[i].docid_ptr = (int) ((k + 1) * resident_stride);
+    }
+    if (slots != NULL)
+	Free (slots);
+    return (1);
+}
+
+/* Assign docids to the num records of array (see te_docid_register),
+   consistent with the resident docids of te_docid_assign_resident.
+   The docids are valid until the next call */
+int
+te_docid_assign_group (void *array, long num, size_t elem_size,
+		       size_t docno_offset, size_t docid_offset,
+		       long num_threads)
+{
+    char *ptr;
+    long i, k, gap, num_in_gap;
+    long docid = 0;
+    int sorted;
+
+    if (resident_dense &&
+	UNDEF == te_docid_assign_resident (num_threads))
+	return (UNDEF);
+    if (num == 0)
+	return (1);
+
+    if (NULL == (group_slots = te_chk_and_malloc (group_slots,
+						  &max_group_slots, num,
+						  sizeof (DOCID_SLOT))))
+	return (UNDEF);
+    ptr = (char *) array;
+    sorted = 1;
+    for (i = 0; i < num; i++) {
+	group_slots[i].qid = "";
+	group_slots[i].docno = *(char **) (ptr + docno_offset);
+	group_slots[i].docid_ptr = (int *) (ptr + docid_offset);
+	if (i > 0 &&
+	    te_field_cmp (group_slots[i-1].docno, group_slots[i].docno) > 0)
+	    sorted = 0;
+	ptr += elem_size;
+    }
+    /* Records are normally already in docno order */
+    if (! sorted &&
+	UNDEF == te_sort_lines_qid_docno (group_slots, num,
+					  sizeof (DOCID_SLOT), num_threads))
+	return (UNDEF);
+
+    k = 0;
+    gap = -1;
+    num_in_gap = 0;
+    for (i = 0; i < num; i++) {
+	if (i == 0 ||
+	    te_field_cmp (group_slots[i-1].docno, group_slots[i].docno)) {
+	    k = find_resident (group_slots[i].docno, k);
+	    if (k < num_resident_docnos &&
+		0 == te_field_cmp (resident_docnos[k], group_slots[i].docno))
+		docid = (k + 1) * resident_stride;
+	    else {
+		if (k != gap) {
+		    gap = k;
+		    num_in_gap = 0;
+		}
+		if (++num_in_gap >= resident_stride)
+		    break;
+		docid = k * resident_stride + num_in_gap;
+	    }
+	}
+	*group_slots[i].docid_ptr = (int) docid;
+    }
+    if (i >= num)
+	return (1);
+
+    /* Gap full.  Number rel_info and this query densely instead */
+    if (UNDEF == te_docid_register (array, num, elem_size, docno_offset,
+				    docid_offset) ||
+	UNDEF == te_docid_assign (num_threads) ||
+	UNDEF == te_docid_release (num_docid_arrays - 1))
+	return (UNDEF);
+    resident_dense = 1;
+    return (1);
+}
+
+/* Index of the first resident docno at or after low that is not less
+   than docno (num_resident_docnos if none) */
+static long
+find_resident (const char *docno, long low)
+{
+    long high = num_resident_docnos;
+    long mid, i, step;
+    uint64_t key;
+
+    if (low >= high)
+	return (low);
+
+    /* A docno without the common prefix is before or after all of them */
+    for (i = 0; i < resident_prefix_len; i++) {
+	if (docno[i] != resident_docnos[0][i])
+	    return (te_field_cmp (docno, resident_docnos[0]) < 0 ?
+		    low : num_resident_docnos);
+    }
+
+    /* Find the docnos with the same key, then compare those in full.
+       Docnos are looked up in increasing order, so the first search
+       gallops forward from low */
+    key = docno_key (docno);
+    for (step = 1; low + step < high && resident_keys[low + step] < key;
+	 step *= 2)
+	;
+    if (low + step < high)
+	high = low + step + 1;
+    low += step / 2;
+    while (low < high) {
+	mid = low + (high - low) / 2;
+	if (resident_keys[mid] < key)
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    high = num_resident_docnos;
+    for (i = low; i < high; ) {
+	mid = i + (high - i) / 2;
+	if (resident_keys[mid] <= key)
+	    i = mid + 1;
+	else
+	    high = mid;
+    }
+    while (low < high) {
+	mid = low + (high - low) / 2;
+	if (te_field_cmp (resident_docnos[mid], docno) < 0)
+	    low = mid + 1;
+	else
+	    high = mid;
+    }
+    return (low);
+}
+
+/* The 8 bytes of docno after the common resident prefix, big-endian
+   (bytes past the end of docno are 0), so keys compare as docnos do */
+static uint64_t
+docno_key (const char *docno)
+{
+    const unsigned char *ptr =
+	(const unsigned char *) docno + resident_prefix_len;
+    uint64_t key = 0;
+    long i;
+
+    for (i = 0; i < 8; i++) {
+	key <<= 8;
+	if (! END_FIELD (*ptr))
+	    key |= *ptr++;
+    }
+    return (key);
+}
+
+/* Mark the arrays registered so far.  te_docid_release (mark) later
+   forgets all arrays registered after the mark (eg, those of a results
+   file that has been evaluated and freed), so that rel_info need only be
+   loaded once when evaluating several results files in turn.  Docids of
+   the remaining arrays are reassigned by the next te_docid_assign */
+long
+te_docid_mark ()
+{
+    return (num_docid_arrays);
+}
+
+int
+te_docid_release (long mark)
+{
+    if (mark < 0 || mark > num_docid_arrays)
+	return (UNDEF);
+    num_docid_arrays = mark;
+    return (1);
+}
+
+/* Number of distinct docnos after te_docid_assign */
+long
+te_num_docids ()
+{
+    return (num_docids);
+}
+
+int
+te_docid_cleanup ()
+{
+    if (max_num_docid_arrays > 0) {
+	Free (docid_arrays);
+	docid_arrays = NULL;
+	max_num_docid_arrays = 0;
+    }
+    num_docid_arrays = 0;
+    num_docids = 0;
+    if (max_resident_docnos > 0) {
+	Free (resident_docnos);
+	max_resident_docnos = 0;
+    }
+    num_resident_docnos = 0;
+    resident_dense = 0;
+    if (max_resident_keys > 0) {
+	Free (resident_keys);
+	max_resident_keys = 0;
+    }
+    if (max_group_slots > 0) {
+	Free (group_slots);
+	max_group_slots = 0;
+    }
+    return (1);
+}
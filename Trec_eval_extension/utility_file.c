@@ -0,0 +1,253 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Utility procedures for getting an entire input file into memory.
+   te_map_file maps the file read-only into memory (MAP_POPULATE plus a
+   sequential access hint), so that loaders can parse it in place without
+   copying it; the file pages stay shared with the page cache.  If the file
+   cannot be mapped (eg, it is a pipe), or does not end in a newline, the
+   file is instead read into a malloc'd buffer and a final newline appended.
+   A file_name of "-" means standard input, which is read until end of
+   file (it may be a pipe or socket).
+   In either case input_buf->buf[input_buf->size-1] is '\n' on return, so
+   parsers can scan a line without checking for end of buffer.
+   The buffer must be treated as read-only by callers: fields within it are
+   whitespace terminated, not NULL terminated.  See te_field_cmp.
+   Return 1 if the file was mapped, 0 if read, UNDEF if error.
+*/
+
+static int read_file (int fd, long size, INPUT_BUF *input_buf);
+static int read_stream (int fd, INPUT_BUF *input_buf);
+
+int
+te_map_file (const char *file_name, INPUT_BUF *input_buf)
+{
+    int fd;
+    off_t size;
+    char *buf;
+    char last;
+
+    input_buf->buf = NULL;
+    input_buf->size = 0;
+    input_buf->mapped = 0;
+
+    if (0 == strcmp (file_name, "-")) {
+	if (UNDEF == read_stream (0, input_buf))
+	    return (UNDEF);
+	return (0);
+    }
+
+    if (-1 == (fd = open (file_name, 0)) ||
+	0 >= (size = lseek (fd, (off_t) 0, 2)) ||
+	-1 == lseek (fd, (off_t) size - 1, 0) ||
+	1 != read (fd, &last, 1) ||
+	-1 == lseek (fd, (off_t) 0, 0)) {
+	if (fd != -1)
+	    (void) close (fd);
+	return (UNDEF);
+    }
+
+    if (last == '\n') {
+	buf = mmap (NULL, (size_t) size, PROT_READ,
+#ifdef MAP_POPULATE
+		    MAP_PRIVATE | MAP_POPULATE,
+#else
+		    MAP_PRIVATE,
+#endif
+		    fd, (off_t) 0);
+	if (buf != MAP_FAILED) {
+	    (void) madvise (buf, (size_t) size, MADV_SEQUENTIAL);
+	    (void) close (fd);
+	    input_buf->buf = buf;
+	    input_buf->size = size;
+	    input_buf->mapped = 1;
+	    return (1);
+	}
+    }
+
+    /* Fallback.  Read entire file into malloc'd buffer */
+    if (UNDEF == read_file (fd, (long) size, input_buf)) {
+	(void) close (fd);
+	return (UNDEF);
+    }
+    if (-1 == close (fd))
+	return (UNDEF);
+    return (0);
+}
+
+static int
+read_file (int fd, long size, INPUT_BUF *input_buf)
+{
+    long num_read;
+    ssize_t ret;
+    char *buf;
+
+    if (NULL == (buf = malloc ((size_t) size+2)))
+	return (UNDEF);
+    for (num_read = 0; num_read < size; num_read += ret) {
+	if (0 >= (ret = read (fd, buf + num_read, (size_t) (size - num_read)))) {
+	    Free (buf);
+	    return (UNDEF);
+	}
+    }
+    /* Append ending newline if not present, Append NULL terminator */
+    if (buf[size-1] != '\n') {
+	buf[size] = '\n';
+	size++;
+    }
+    buf[size] = '\0';
+
+    input_buf->buf = buf;
+    input_buf->size = size;
+    input_buf->mapped = 0;
+    return (1);
+}
+
+/* Read fd until end of file into a malloc'd buffer, growing as needed */
+static int
+read_stream (int fd, INPUT_BUF *input_buf)
+{
+    long size = 0;
+    long max_size = 65536;
+    ssize_t ret;
+    char *buf, *new_buf;
+
+    if (NULL == (buf = malloc ((size_t) max_size)))
+	return (UNDEF);
+    while (1) {
+	/* Always read at least one byte, leaving room for the newline and
+	   NULL terminator (a read of 0 bytes would look like end of file) */
+	if (max_size - size <= 2) {
+	    max_size *= 2;
+	    if (NULL == (new_buf = realloc (buf, (size_t) max_size))) {
+		Free (buf);
+		return (UNDEF);
+	    }
+	    buf = new_buf;
+	}
+	if (0 > (ret = read (fd, buf + size, (size_t) (max_size - size - 2)))) {
+	    Free (buf);
+	    return (UNDEF);
+	}
+	if (ret == 0)
+	    break;
+	size += ret;
+    }
+    if (size == 0) {
+	Free (buf);
+	return (UNDEF);
+    }
+    /* Append ending newline if not present, Append NULL terminator */
+    if (buf[size-1] != '\n') {
+	buf[size] = '\n';
+	size++;
+    }
+    buf[size] = '\0';
+
+    input_buf->buf = buf;
+    input_buf->size = size;
+    input_buf->mapped = 0;
+    return (1);
+}
+
+int
+te_unmap_file (INPUT_BUF *input_buf)
+{
+    if (input_buf->buf != NULL) {
+	if (input_buf->mapped) {
+	    if (-1 == munmap (input_buf->buf, (size_t) input_buf->size))
+		return (UNDEF);
+	}
+	else
+	    Free (input_buf->buf);
+    }
+    input_buf->buf = NULL;
+    input_buf->size = 0;
+    input_buf->mapped = 0;
+    return (1);
+}
+
+/* Count the lines in input_buf (every line, including the last, ends
+   in '\n') */
+long
+te_count_lines (const INPUT_BUF *input_buf)
+{
+    const char *ptr = input_buf->buf;
+    const char *end = input_buf->buf + input_buf->size;
+    long num_lines = 0;
+
+    while (ptr < end && NULL != (ptr = memchr (ptr, '\n', end - ptr))) {
+	num_lines++;
+	ptr++;
+    }
+    return (num_lines);
+}
+
+/* Fields within an input buffer are views: they start at a char *, and
+   end at the first whitespace or NULL character.  te_field_cmp compares
+   two such fields exactly as strcmp would compare them if they had been
+   NULL terminated in place, so NULL terminated strings may be freely
+   compared with fields.  END_FIELD is in trec_eval.h */
+
+int
+te_field_cmp (const char *field1, const char *field2)
+{
+    const unsigned char *ptr1 = (const unsigned char *) field1;
+    const unsigned char *ptr2 = (const unsigned char *) field2;
+
+    while (1) {
+	if (END_FIELD (*ptr1))
+	    return (END_FIELD (*ptr2) ? 0 : -1);
+	if (END_FIELD (*ptr2))
+	    return (1);
+	if (*ptr1 != *ptr2)
+	    return ((int) *ptr1 - (int) *ptr2);
+	ptr1++; ptr2++;
+    }
+}
+
+long
+te_field_len (const char *field)
+{
+    const unsigned char *ptr = (const unsigned char *) field;
+    while (! END_FIELD (*ptr))
+	ptr++;
+    return ((long) (ptr - (const unsigned char *) field));
+}
+
+/* FNV-1a hash of field (non-negative) */
+long
+te_field_hash (const char *field)
+{
+    const unsigned char *ptr = (const unsigned char *) field;
+    unsigned long hash = 2166136261UL;
+
+    while (! END_FIELD (*ptr)) {
+	hash = (hash ^ *ptr) * 16777619UL;
+	ptr++;
+    }
+    return ((long) (hash & LONG_MAX));
+}
+
+/* Copy field into *pool_ptr as a NULL terminated string, advancing
+   *pool_ptr past it.  Return the copied string */
+char *
+te_field_copy (const char *field, char **pool_ptr)
+{
+    char *str = *pool_ptr;
+    long len = te_field_len (field);
+
+    (void) memcpy (str, field, len);
+    str[len] = '\0';
+    *pool_ptr += len + 1;
+    return (str);
+}
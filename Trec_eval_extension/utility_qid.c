@@ -0,0 +1,71 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Utility procedures for finding the rel_info of a query by qid.
+   te_qid_index_build hashes the qids of all_rel_info->rel_info once after
+   loading; te_qid_index_find then returns the index j of a qid in
+   rel_info in O(1), or -1 if the qid has no rel_info.
+*/
+
+int
+te_qid_index_build (const ALL_REL_INFO *all_rel_info, QID_INDEX *qid_index)
+{
+    long i, h;
+
+    qid_index->rel_info = all_rel_info->rel_info;
+    qid_index->hash_size = 16;
+    while (qid_index->hash_size < 2 * all_rel_info->num_q_rels)
+	qid_index->hash_size *= 2;
+    if (NULL == (qid_index->table = Malloc (qid_index->hash_size, long)))
+	return (UNDEF);
+    for (h = 0; h < qid_index->hash_size; h++)
+	qid_index->table[h] = -1;
+
+    for (i = 0; i < all_rel_info->num_q_rels; i++) {
+	h = te_field_hash (all_rel_info->rel_info[i].qid) &
+	    (qid_index->hash_size - 1);
+	while (qid_index->table[h] >= 0) {
+	    if (0 == strcmp (all_rel_info->rel_info[qid_index->table[h]].qid,
+			     all_rel_info->rel_info[i].qid))
+		/* Duplicate qid; first occurrence wins, as in a linear scan */
+		break;
+	    h = (h + 1) & (qid_index->hash_size - 1);
+	}
+	if (qid_index->table[h] < 0)
+	    qid_index->table[h] = i;
+    }
+    return (1);
+}
+
+long
+te_qid_index_find (const QID_INDEX *qid_index, const char *qid)
+{
+    long h = te_field_hash (qid) & (qid_index->hash_size - 1);
+
+    while (qid_index->table[h] >= 0) {
+	if (0 == strcmp (qid_index->rel_info[qid_index->table[h]].qid, qid))
+	    return (qid_index->table[h]);
+	h = (h + 1) & (qid_index->hash_size - 1);
+    }
+    return (-1);
+}
+
+int
+te_qid_index_cleanup (QID_INDEX *qid_index)
+{
+    if (qid_index->table != NULL) {
+	Free (qid_index->table);
+	qid_index->table = NULL;
+    }
+    qid_index->hash_size = 0;
+    return (1);
+}
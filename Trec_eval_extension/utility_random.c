@@ -0,0 +1,60 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Reproducible streams of random numbers, for the resampling procedures
+   (randomization tests, bootstrap).  Work is split into fixed blocks,
+   each drawing from its own stream seeded by the block number, so that
+   results do not depend on how blocks are shared among threads.
+   Numbers are xoshiro256**, with the state of a stream initialized by
+   splitmix64 from the seed and stream number.
+*/
+
+#define ROTL(x,k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+void
+te_rng_seed (TE_RNG *rng, uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed ^ (stream * 0xd1342543de82ef95ULL);
+    uint64_t z;
+    long i;
+
+    for (i = 0; i < 4; i++) {
+	z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t
+te_rng_next (TE_RNG *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = ROTL (s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL (s[3], 45);
+    return (result);
+}
+
+/* Return a random number in 0 .. n-1 */
+long
+te_rng_below (TE_RNG *rng, long n)
+{
+    return ((long) (((unsigned __int128) te_rng_next (rng) *
+		     (uint64_t) n) >> 64));
+}
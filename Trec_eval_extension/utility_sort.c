@@ -0,0 +1,428 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Utility procedure to sort the input lines of a file by qid, then docno.
+   Each line is an element of size line_size whose first two members are
+       char *qid;
+       char *docno;
+   where qid and docno are fields (NULL or whitespace terminated, see
+   te_field_cmp).  The resulting order is the same as a qsort of the lines
+   comparing qid and then docno with te_field_cmp, except that lines with
+   equal qid and docno keep their input order.
+
+   Rather than an O(N log N) qsort with string comparisons, qids are
+   interned in a hash table and the lines distributed into one bucket per
+   qid in a single linear pass (nearly always, consecutive lines have the
+   same qid, so the hash table is rarely consulted).  Each bucket is then
+   sorted by docno with an MSD radix sort on the docno bytes.  Buckets are
+   independent, and are sorted on up to num_threads threads.
+*/
+
+/* Partitions of fewer lines than this are insertion sorted */
+#define INSERTION_SORT_SIZE 24
+/* Fewer total lines than this are sorted on the calling thread */
+#define MIN_PARALLEL_LINES 65536
+
+typedef struct {
+    char *qid;
+    char *docno;
+} LINE_KEY;
+
+typedef struct {
+    char *qid;                  /* qid field of first line with this qid */
+    long num_lines;             /* Number of lines with this qid */
+    long start;                 /* Index of first line of bucket, once
+				   buckets are sorted */
+} QID_BUCKET;
+
+typedef struct {
+    char *lines;
+    char *tmp;                  /* Scratch space parallel to lines */
+    unsigned char *key_bytes;   /* Scratch byte per line */
+    size_t line_size;
+    QID_BUCKET *buckets;        /* Buckets first_bucket to last_bucket-1 */
+    long first_bucket;          /* are sorted by this task */
+    long last_bucket;
+} SORT_TASK;
+
+#define KEY(lines,i,line_size) ((LINE_KEY *) ((lines) + (i) * (line_size)))
+/* Byte of docno at depth, with end of field (any terminator) as 0 */
+#define KEY_BYTE(docno,depth) \
+    (END_FIELD ((unsigned char) (docno)[depth]) ? \
+     0 : (unsigned char) (docno)[depth])
+
+static int comp_bucket_qid ();
+static void *sort_buckets (void *arg);
+static void radix_sort (char *lines, char *tmp, unsigned char *key_bytes,
+			long num_lines, size_t line_size, long depth);
+static long common_prefix (char *lines, long num_lines, size_t line_size,
+			   long depth);
+static void insertion_sort (char *lines, char *hold, long num_lines,
+			    size_t line_size, long depth);
+
+int
+te_sort_lines_qid_docno (void *lines_arg, long num_lines, size_t line_size,
+			 long num_threads)
+{
+    char *lines = (char *) lines_arg;
+    char *tmp;
+    unsigned char *key_bytes;
+    long *hash_table;
+    long hash_size;
+    QID_BUCKET *buckets = NULL;
+    long max_num_buckets = 0;
+    long num_buckets = 0;
+    long *line_bucket;
+    SORT_TASK *tasks;
+    long num_tasks;
+    long i, h, b, t;
+    char *prev_qid;
+    long prev_bucket;
+    long num_so_far;
+
+    if (num_lines <= 1)
+	return (1);
+
+    /* Lines all of one qid (eg, those of a single query) form a single
+       bucket, sorted directly */
+    for (i = 1; i < num_lines; i++) {
+	if (te_field_cmp (KEY (lines, i-1, line_size)->qid,
+			  KEY (lines, i, line_size)->qid))
+	    break;
+    }
+    if (i >= num_lines) {
+	if (NULL == (tmp = Malloc (num_lines * line_size, char)) ||
+	    NULL == (key_bytes = Malloc (num_lines, unsigned char)))
+	    return (UNDEF);
+	radix_sort (lines, tmp, key_bytes, num_lines, line_size, 0);
+	Free (tmp);
+	Free (key_bytes);
+	return (1);
+    }
+
+    /* line_bucket[i] is the bucket of line i (index into buckets) */
+    hash_size = 1024;
+    if (NULL == (line_bucket = Malloc (num_lines, long)) ||
+	NULL == (hash_table = Malloc (hash_size, long)))
+	return (UNDEF);
+    for (h = 0; h < hash_size; h++)
+	hash_table[h] = -1;
+
+    /* Intern qids, counting lines of each */
+    prev_qid = NULL;
+    prev_bucket = -1;
+    for (i = 0; i < num_lines; i++) {
+	char *qid = KEY (lines, i, line_size)->qid;
+	if (prev_qid == NULL || te_field_cmp (prev_qid, qid)) {
+	    h = te_field_hash (qid) & (hash_size - 1);
+	    while (hash_table[h] >= 0 &&
+		   te_field_cmp (buckets[hash_table[h]].qid, qid))
+		h = (h + 1) & (hash_size - 1);
+	    if (hash_table[h] < 0) {
+		/* New qid */
+		if (NULL == (buckets = te_chk_and_realloc (buckets,
+							   &max_num_buckets,
+							   num_buckets + 1,
+							   sizeof (QID_BUCKET))))
+		    return (UNDEF);
+		buckets[num_buckets] = (QID_BUCKET) {qid, 0, 0};
+		hash_table[h] = num_buckets++;
+		if (2 * num_buckets > hash_size) {
+		    /* Double and rehash */
+		    Free (hash_table);
+		    hash_size *= 2;
+		    if (NULL == (hash_table = Malloc (hash_size, long)))
+			return (UNDEF);
+		    for (h = 0; h < hash_size; h++)
+			hash_table[h] = -1;
+		    for (b = 0; b < num_buckets; b++) {
+			h = te_field_hash (buckets[b].qid) & (hash_size - 1);
+			while (hash_table[h] >= 0)
+			    h = (h + 1) & (hash_size - 1);
+			hash_table[h] = b;
+		    }
+		}
+		prev_bucket = num_buckets - 1;
+	    }
+	    else
+		prev_bucket = hash_table[h];
+	    prev_qid = qid;
+	}
+	line_bucket[i] = prev_bucket;
+	buckets[prev_bucket].num_lines++;
+    }
+    Free (hash_table);
+
+    /* Order buckets by qid (carrying the interned index along in start
+       while sorting), and find where each bucket will start */
+    {
+	long *new_index;
+	long *next;
+	if (NULL == (new_index = Malloc (num_buckets, long)) ||
+	    NULL == (next = Malloc (num_buckets, long)))
+	    return (UNDEF);
+	for (b = 0; b < num_buckets; b++)
+	    buckets[b].start = b;
+	qsort ((char *) buckets, (int) num_buckets, sizeof (QID_BUCKET),
+	       comp_bucket_qid);
+	for (b = 0; b < num_buckets; b++)
+	    new_index[buckets[b].start] = b;
+	num_so_far = 0;
+	for (b = 0; b < num_buckets; b++) {
+	    buckets[b].start = num_so_far;
+	    next[b] = num_so_far;
+	    num_so_far += buckets[b].num_lines;
+	}
+
+	/* Distribute lines into buckets (stable) */
+	if (NULL == (tmp = Malloc (num_lines * line_size, char)))
+	    return (UNDEF);
+	for (i = 0; i < num_lines; i++) {
+	    b = new_index[line_bucket[i]];
+	    (void) memcpy (tmp + next[b] * line_size,
+			   lines + i * line_size, line_size);
+	    next[b]++;
+	}
+	(void) memcpy (lines, tmp, num_lines * line_size);
+	Free (new_index);
+	Free (next);
+    }
+    Free (line_bucket);
+
+    /* Sort each bucket by docno.  Split buckets into contiguous ranges
+       of roughly equal numbers of lines, one range per task */
+    num_tasks = te_num_threads (num_threads);
+    if (num_lines < MIN_PARALLEL_LINES)
+	num_tasks = 1;
+    if (num_tasks > num_buckets)
+	num_tasks = num_buckets;
+    if (NULL == (tasks = Malloc (num_tasks, SORT_TASK)) ||
+	NULL == (key_bytes = Malloc (num_lines, unsigned char)))
+	return (UNDEF);
+    b = 0;
+    for (t = 0; t < num_tasks; t++) {
+	tasks[t] = (SORT_TASK) {lines, tmp, key_bytes, line_size, buckets,
+				b, b};
+	while (b < num_buckets &&
+	       (t == num_tasks - 1 ||
+		buckets[b].start < num_lines / num_tasks * (t + 1)))
+	    b++;
+	tasks[t].last_bucket = b;
+    }
+    if (UNDEF == te_run_parallel (num_tasks, sort_buckets, tasks,
+				  sizeof (SORT_TASK)))
+	return (UNDEF);
+
+    Free (tasks);
+    Free (key_bytes);
+    Free (tmp);
+    Free (buckets);
+    return (1);
+}
+
+static void *
+sort_buckets (void *arg)
+{
+    SORT_TASK *task = (SORT_TASK *) arg;
+    long b;
+    long start;
+
+    for (b = task->first_bucket; b < task->last_bucket; b++) {
+	start = task->buckets[b].start;
+	radix_sort (task->lines + start * task->line_size,
+		    task->tmp + start * task->line_size,
+		    task->key_bytes + start,
+		    task->buckets[b].num_lines, task->line_size, 0);
+    }
+    return (NULL);
+}
+
+/* Sort num_lines lines by docno, given all docnos are equal for the first
+   depth bytes.  tmp is scratch space of the same size as lines, key_bytes
+   holds the byte at depth of each line between counting and distributing
+   (so each docno is only dereferenced once per pass) */
+static void
+radix_sort (char *lines, char *tmp, unsigned char *key_bytes, long num_lines,
+	    size_t line_size, long depth)
+{
+    long count[256];
+    long next[256];
+    long i, c;
+
+    while (num_lines >= INSERTION_SORT_SIZE) {
+	/* Skip over any prefix common to all docnos (eg, a collection
+	   name) in one pass rather than one counting pass per byte */
+	depth += common_prefix (lines, num_lines, line_size, depth);
+
+	(void) memset (count, 0, sizeof (count));
+	for (i = 0; i < num_lines; i++) {
+	    key_bytes[i] = KEY_BYTE (KEY (lines, i, line_size)->docno, depth);
+	    count[key_bytes[i]]++;
+	}
+
+	c = key_bytes[0];
+	if (count[c] == num_lines) {
+	    /* Common prefix byte.  All docnos equal if it is the end */
+	    if (c == 0)
+		return;
+	    depth++;
+	    continue;
+	}
+
+	next[0] = 0;
+	for (c = 1; c < 256; c++)
+	    next[c] = next[c-1] + count[c-1];
+	for (i = 0; i < num_lines; i++) {
+	    c = key_bytes[i];
+	    (void) memcpy (tmp + next[c] * line_size,
+			   lines + i * line_size, line_size);
+	    next[c]++;
+	}
+	(void) memcpy (lines, tmp, num_lines * line_size);
+
+	/* Docnos that ended (c == 0) are all equal and sort first */
+	for (c = 1; c < 256; c++) {
+	    if (count[c] > 1)
+		radix_sort (lines + (next[c] - count[c]) * line_size,
+			    tmp + (next[c] - count[c]) * line_size,
+			    key_bytes + (next[c] - count[c]),
+			    count[c], line_size, depth + 1);
+	}
+	return;
+    }
+    insertion_sort (lines, tmp, num_lines, line_size, depth);
+}
+
+/* Length of the prefix common to all docnos beyond depth */
+static long
+common_prefix (char *lines, long num_lines, size_t line_size, long depth)
+{
+    const char *first = KEY (lines, 0, line_size)->docno + depth;
+    const char *docno;
+    long len = te_field_len (first);
+    long i, j;
+
+    for (i = 1; i < num_lines && len > 0; i++) {
+	docno = KEY (lines, i, line_size)->docno + depth;
+	for (j = 0; j < len && docno[j] == first[j]; j++)
+	    ;
+	len = j;
+    }
+    return (len);
+}
+
+/* Stable insertion sort of lines by docno, starting comparison at depth.
+   hold is scratch space for one line */
+static void
+insertion_sort (char *lines, char *hold, long num_lines, size_t line_size,
+		long depth)
+{
+    long i, j;
+
+    for (i = 1; i < num_lines; i++) {
+	j = i;
+	while (j > 0 &&
+	       te_field_cmp (KEY (lines, j-1, line_size)->docno + depth,
+			     KEY (lines, i, line_size)->docno + depth) > 0)
+	    j--;
+	if (j < i) {
+	    (void) memcpy (hold, lines + i * line_size, line_size);
+	    (void) memmove (lines + (j+1) * line_size, lines + j * line_size,
+			    (i - j) * line_size);
+	    (void) memcpy (lines + j * line_size, hold, line_size);
+	}
+    }
+}
+
+static int
+comp_bucket_qid (QID_BUCKET *ptr1, QID_BUCKET *ptr2)
+{
+    return (te_field_cmp (ptr1->qid, ptr2->qid));
+}
+
+/* Utility procedure to sort only the top of an array: afterwards the
+   first num_top of the num_elems elements of base (each of size
+   elem_size) are the num_top least by compar, in order; the rest are in
+   no particular order.  If compar is a total order the top is the same
+   as after a qsort of the whole array.
+   Used when evaluating only the top docs of a ranking (-M): the array is
+   partitioned as in quickselect, going on into only the partition
+   holding the num_top'th element, and then just the top is qsorted.
+*/
+
+#define ELEM(i) (base + (i) * elem_size)
+
+static void swap_elems (char *elem1, char *elem2, size_t elem_size);
+
+void
+te_sort_top (void *base_arg, long num_elems, size_t elem_size, long num_top,
+	     int (*compar) ())
+{
+    char *base = (char *) base_arg;
+    long lo, hi, mid, i, j;
+
+    if (num_top < num_elems) {
+	/* Partition base[lo..hi-1], which holds the num_top'th element */
+	lo = 0;
+	hi = num_elems;
+	while (hi - lo > 2) {
+	    /* Median of three as pivot, moved to base[lo] */
+	    mid = lo + (hi - lo) / 2;
+	    if (compar (ELEM (mid), ELEM (lo)) < 0)
+		swap_elems (ELEM (mid), ELEM (lo), elem_size);
+	    if (compar (ELEM (hi-1), ELEM (mid)) < 0) {
+		swap_elems (ELEM (hi-1), ELEM (mid), elem_size);
+		if (compar (ELEM (mid), ELEM (lo)) < 0)
+		    swap_elems (ELEM (mid), ELEM (lo), elem_size);
+	    }
+	    swap_elems (ELEM (mid), ELEM (lo), elem_size);
+
+	    i = lo;
+	    j = hi;
+	    while (1) {
+		while (++i < hi - 1 && compar (ELEM (i), ELEM (lo)) < 0)
+		    ;
+		while (compar (ELEM (lo), ELEM (--j)) < 0)
+		    ;
+		if (i >= j)
+		    break;
+		swap_elems (ELEM (i), ELEM (j), elem_size);
+	    }
+	    swap_elems (ELEM (lo), ELEM (j), elem_size);
+
+	    /* base[lo..j-1] <= base[j] <= base[j+1..hi-1] */
+	    if (j == num_top || j == num_top - 1)
+		break;
+	    if (j > num_top)
+		hi = j;
+	    else
+		lo = j + 1;
+	}
+	if (hi - lo == 2 && compar (ELEM (lo+1), ELEM (lo)) < 0)
+	    swap_elems (ELEM (lo+1), ELEM (lo), elem_size);
+	num_elems = num_top;
+    }
+    qsort (base, (size_t) num_elems, elem_size, compar);
+}
+
+static void
+swap_elems (char *elem1, char *elem2, size_t elem_size)
+{
+    char hold;
+    size_t k;
+
+    for (k = 0; k < elem_size; k++) {
+	hold = elem1[k];
+	elem1[k] = elem2[k];
+	elem2[k] = hold;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+   Copyright (c) 2008 - Chris Buckley.
+
+   Permission is granted for use and modification of this file for
+   research, non-commercial purposes.
+*/
+
+#include "common.h"
+#include "sysfunc.h"
+#include "trec_eval.h"
+#include "functions.h"
+
+/* Utility procedure for running independent tasks in parallel.
+   Run proc on each of the num_tasks argument objects in args (each of size
+   arg_size), one thread per task, and wait for all of them to finish.
+   Task 0 is run on the calling thread, so with num_tasks == 1 no thread
+   is created at all.  proc returns UNDEF (cast to void *) on error.
+   Return UNDEF if a thread could not be created or any task failed.
+*/
+
+int
+te_run_parallel (long num_tasks, void *(*proc) (void *), void *args,
+		 size_t arg_size)
+{
+    pthread_t *threads;
+    long i;
+    long num_started;
+    int ret = 1;
+    void *thread_ret;
+
+    if (num_tasks <= 0)
+	return (1);
+    if (num_tasks == 1)
+	return ((long) proc (args) == UNDEF ? UNDEF : 1);
+
+    if (NULL == (threads = Malloc (num_tasks, pthread_t)))
+	return (UNDEF);
+    for (num_started = 1; num_started < num_tasks; num_started++) {
+	if (pthread_create (&threads[num_started], NULL, proc,
+			    (char *) args + num_started * arg_size)) {
+	    ret = UNDEF;
+	    break;
+	}
+    }
+    if (ret != UNDEF && (long) proc (args) == UNDEF)
+	ret = UNDEF;
+    for (i = 1; i < num_started; i++) {
+	if (pthread_join (threads[i], &thread_ret) ||
+	    (long) thread_ret == UNDEF)
+	    ret = UNDEF;
+    }
+    Free (threads);
+    return (ret);
+}
+
+/* Number of threads to use given the -j command line value.
+   0 (or negative) means one per online processor */
+long
+te_num_threads (long requested)
+{
+    long num;
+    if (requested > 0)
+	return (requested);
+    num = sysconf (_SC_NPROCESSORS_ONLN);
+    return (num > 0 ? num : 1);
+}